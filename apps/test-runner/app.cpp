@@ -1,11 +1,20 @@
+#include <cstring>
 #include "gft/log.hpp"
 #include "gft/test.hpp"
 
 using namespace liong;
 
 int main(int argc, char** argv) {
+  // Benchmarks are skipped unless `--bench` is given.
+  bool should_run_benches = false;
+  for (int i = 1; i < argc; ++i) {
+    if (std::strcmp(argv[i], "--bench") == 0) {
+      should_run_benches = true;
+    }
+  }
+
   try {
-    test::TestRegistry::run_all();
+    test::TestRegistry::run_all(should_run_benches);
   } catch (const std::exception& e) {
     L_ERROR("application threw an exception");
     L_ERROR(e.what());
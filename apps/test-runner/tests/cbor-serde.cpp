@@ -0,0 +1,195 @@
+#include <limits>
+#include "gft/assert.hpp"
+#include "gft/log.hpp"
+#include "gft/test.hpp"
+#include "gft/util.hpp"
+#include "gft/cbor-serde.hpp"
+
+using namespace liong;
+
+namespace {
+
+enum class TestCborEnum {
+  _123 = 123,
+};
+
+struct TestCborInner {
+  std::string name;
+  std::vector<float> weights;
+
+  L_JSON_SERDE_FIELDS(name, weights);
+};
+
+struct TestCborStructure {
+  uint32_t a;
+  bool b;
+  std::string c;
+  std::pair<std::string, int32_t> d;
+  std::unique_ptr<uint8_t> e;
+  std::map<uint64_t, std::string> f;
+  std::unordered_map<std::string, int32_t> g;
+  std::vector<int32_t> h;
+  std::array<int16_t, 3> i;
+  std::uint16_t j[3];
+  TestCborEnum k;
+  std::optional<int64_t> l;
+  int64_t m;
+  std::vector<TestCborInner> n;
+  std::vector<bool> o;
+  double p;
+
+  L_JSON_SERDE_FIELDS(a, b, c, d, e, f, g, h, i, j, k, l, m, n, o, p);
+};
+
+// Same field as `TestCborInner` after a typed array unknown to it.
+struct TestCborTypedArrayOuter {
+  std::vector<float> v;
+  std::string name;
+
+  L_JSON_SERDE_FIELDS(v, name);
+};
+
+std::vector<uint8_t> to_cbor(const TestCborStructure& x) {
+  stream::WriteStream out;
+  cbor::serialize(x, out);
+  return out.take();
+}
+
+} // namespace
+
+L_TEST(CborSerdeRoundTrip) {
+  TestCborStructure ts1 {};
+  ts1.a = 123;
+  ts1.b = true;
+  ts1.c = "123";
+  ts1.d = std::make_pair<std::string, int32_t>("12", -3);
+  ts1.e = std::make_unique<uint8_t>(123);
+  ts1.f[12] = "3";
+  ts1.g["1"] = 23;
+  ts1.h = { 1, -2, 3 };
+  ts1.i = { 1, 2, 3 };
+  ts1.j[0] = 1;
+  ts1.j[1] = 2;
+  ts1.j[2] = 3;
+  ts1.k = TestCborEnum::_123;
+  ts1.l = std::nullopt;
+  ts1.m = -123123123123123123;
+  ts1.n.resize(2);
+  ts1.n[1].name = "inner";
+  ts1.n[1].weights = { 0.5f, -1.0f };
+  ts1.o = { true, false, true };
+  ts1.p = 0.1;
+
+  std::vector<uint8_t> data = to_cbor(ts1);
+  stream::ReadStream in(data.data(), data.size());
+  TestCborStructure ts2 {};
+  ts2.l = 1;
+  cbor::deserialize(in, ts2);
+  L_ASSERT(in.ate());
+  L_ASSERT(to_cbor(ts2) == data);
+  L_ASSERT(ts2.d.second == -3);
+  L_ASSERT(*ts2.e == 123);
+  L_ASSERT(ts2.g.at("1") == 23);
+  L_ASSERT(!ts2.l.has_value());
+  L_ASSERT(ts2.m == ts1.m);
+  L_ASSERT(ts2.n[1].weights == ts1.n[1].weights);
+  L_ASSERT(ts2.o == ts1.o);
+  L_ASSERT(ts2.p == ts1.p);
+
+  // Truncated data is rejected rather than read out of bounds.
+  for (size_t size = 0; size < data.size(); ++size) {
+    stream::ReadStream in2(data.data(), size);
+    bool has_thrown = false;
+    try {
+      cbor::deserialize(in2, ts2);
+    } catch (const cbor::CborException&) {
+      has_thrown = true;
+    }
+    L_ASSERT(has_thrown);
+  }
+}
+
+L_TEST(CborEncoding) {
+  stream::WriteStream out;
+  cbor::CborWriter w(out);
+  w.write_int(10);
+  w.write_int(-1);
+  w.write_int(500);
+  w.write_text("a");
+  w.write_bool(false);
+  w.write_null();
+  std::vector<uint8_t> data = out.take();
+  std::vector<uint8_t> expected {
+    0x0A, 0x20, 0x19, 0x01, 0xF4, 0x61, 'a', 0xF4, 0xF6,
+  };
+  L_ASSERT(data == expected);
+
+  // Half-precision numbers (1.5 and -infinity) from other encoders.
+  uint8_t halfs[] = { 0xF9, 0x3E, 0x00, 0xF9, 0xFC, 0x00 };
+  stream::ReadStream in(halfs, sizeof(halfs));
+  cbor::CborReader r(in);
+  L_ASSERT(r.read_double() == 1.5);
+  L_ASSERT(r.read_double() == -std::numeric_limits<double>::infinity());
+
+  // Unknown fields are skipped.
+  stream::WriteStream out2;
+  cbor::CborWriter w2(out2);
+  w2.write_map_head(2);
+  w2.write_text("unknown");
+  w2.write_array_head(2);
+  w2.write_map_head(1);
+  w2.write_int(1);
+  w2.write_text("x");
+  w2.write_double(1.0);
+  w2.write_text("name");
+  w2.write_text("y");
+  std::vector<uint8_t> data2 = out2.take();
+  stream::ReadStream in2(data2.data(), data2.size());
+  TestCborInner inner {};
+  cbor::deserialize(in2, inner);
+  L_ASSERT(inner.name == "y");
+
+  // Tagged typed arrays are skipped as well, even when the tag number is
+  // larger than the rest of the data.
+  TestCborTypedArrayOuter outer {};
+  outer.v = { 1.0f, 2.0f };
+  outer.name = "z";
+  stream::WriteStream out3;
+  cbor::serialize(outer, out3);
+  std::vector<uint8_t> data3 = out3.take();
+  stream::ReadStream in3(data3.data(), data3.size());
+  TestCborInner inner2 {};
+  cbor::deserialize(in3, inner2);
+  L_ASSERT(inner2.name == "z");
+  L_ASSERT(inner2.weights.empty());
+}
+
+L_BENCH(CborSerdeCheckpointThroughput) {
+  TestCborInner x1 {};
+  x1.name = "checkpoint";
+  x1.weights.resize(4 * 1024 * 1024);
+  for (size_t i = 0; i < x1.weights.size(); ++i) {
+    x1.weights[i] = (float)i * 0.25f;
+  }
+
+  std::vector<uint8_t> data;
+  double ser_us = test::bench_us(5, [&]() {
+    stream::WriteStream out;
+    cbor::serialize(x1, out);
+    data = out.take();
+  });
+  TestCborInner x2 {};
+  double de_us = test::bench_us(5, [&]() {
+    stream::ReadStream in(data.data(), data.size());
+    cbor::deserialize(in, x2);
+  });
+  L_ASSERT(x2.weights == x1.weights);
+
+  std::string json_lit;
+  double json_ser_us = test::bench_us(1, [&]() {
+    json_lit = json::print(json::serialize(x1));
+  });
+  L_INFO("4M floats: cbor ", data.size(), " bytes, serialize ", ser_us,
+    "us, deserialize ", de_us, "us; json ", json_lit.size(),
+    " bytes, serialize ", json_ser_us, "us");
+}
@@ -0,0 +1,269 @@
+#include <cstring>
+#include <limits>
+#include "gft/assert.hpp"
+#include "gft/log.hpp"
+#include "gft/test.hpp"
+#include "gft/util.hpp"
+#include "gft/deflate.hpp"
+
+using namespace liong;
+
+namespace {
+
+// 1024 pseudo-random words, 12 in a line.
+std::string make_deflate_test_text() {
+  const char* words[] = {
+    "graphi", "tensor", "kernel", "buffer", "image", "queue", "memory",
+    "shader", "vertex", "pixel", "render", "frame", "device", "layout",
+    "stream", "zip",
+  };
+  uint32_t x = 12345;
+  std::string out;
+  for (size_t i = 0; i < 1024; ++i) {
+    x = (x * 1103515245 + 12345) & 0x7FFFFFFF;
+    out += words[(x >> 16) % 16];
+    out += i % 12 == 11 ? '\n' : ' ';
+  }
+  return out;
+}
+
+// `make_deflate_test_text` compressed by zlib at level 9 in dynamic Huffman
+// blocks.
+const std::vector<uint8_t> DYNAMIC_DEFLATE_DATA {
+    0x75, 0x99, 0x51, 0x76, 0xDB, 0x40, 0x08, 0x45, 0xFF, 0x59, 0x85, 0xB6, 0xE6, 0xD6, 0x4A, 0xE2,
+    0xD3, 0x38, 0x49, 0x15, 0x3B, 0x27, 0xE9, 0xEA, 0x5B, 0x99, 0x3B, 0x11, 0x57, 0xA6, 0x1F, 0xAD,
+    0x2A, 0x8B, 0x61, 0x80, 0x81, 0xC7, 0x63, 0x7A, 0x9C, 0x3F, 0x4E, 0x3F, 0xE7, 0xE9, 0x74, 0x3E,
+    0x3C, 0xCE, 0xD3, 0xEF, 0xEB, 0x7C, 0x9D, 0xA7, 0x65, 0x7E, 0x39, 0xCE, 0xCB, 0xF4, 0xE7, 0xF4,
+    0x36, 0x3D, 0x1F, 0xBE, 0x5E, 0xAF, 0x97, 0xF1, 0xE0, 0x03, 0x8F, 0x14, 0x3E, 0xE6, 0xFA, 0x87,
+    0xE5, 0x70, 0x9E, 0xE3, 0xFD, 0xB2, 0xCC, 0x87, 0xF3, 0x6D, 0xE5, 0x8F, 0xEB, 0xC3, 0xC3, 0x3F,
+    0xA1, 0xC7, 0xE5, 0xF0, 0xF6, 0x74, 0x9A, 0xDE, 0x4E, 0x9F, 0xF3, 0xF3, 0x90, 0x45, 0x1B, 0x9F,
+    0x56, 0xE1, 0xFC, 0xBC, 0xFE, 0x2B, 0x7F, 0x0C, 0x44, 0xD2, 0xAA, 0x63, 0x35, 0x91, 0x2F, 0xBF,
+    0xE6, 0xE5, 0xE5, 0xDF, 0x92, 0xDB, 0xB6, 0xD3, 0x79, 0x3E, 0xBF, 0x2E, 0x5F, 0xD3, 0xC7, 0xBC,
+    0x5C, 0xE6, 0xCF, 0xB1, 0x33, 0x56, 0xA6, 0x60, 0xAC, 0xBA, 0xD7, 0x3F, 0x58, 0xF8, 0xFE, 0x74,
+    0x58, 0x3F, 0xB2, 0x22, 0xB7, 0xBF, 0xCC, 0x2F, 0xEF, 0xAF, 0xCB, 0x90, 0xC8, 0xDF, 0xB0, 0x31,
+    0xB7, 0x49, 0xE9, 0x48, 0xBF, 0xE5, 0x7D, 0x0A, 0x4B, 0xCD, 0xBA, 0x19, 0x76, 0xF1, 0xC0, 0xE4,
+    0x2D, 0x46, 0xA1, 0xD5, 0xA9, 0x10, 0xF7, 0x72, 0xC3, 0xF4, 0x18, 0x23, 0xF1, 0x47, 0x91, 0x4C,
+    0x81, 0x74, 0x38, 0xAC, 0x9F, 0x4D, 0xCB, 0x51, 0xA0, 0x80, 0x1D, 0xBA, 0xA0, 0x2A, 0x02, 0xB1,
+    0x3F, 0x94, 0xA1, 0x92, 0xD8, 0xA1, 0x40, 0x7A, 0xF8, 0x84, 0x25, 0xC8, 0xA7, 0xF2, 0xE1, 0xAC,
+    0x12, 0x02, 0x93, 0x72, 0x71, 0xFE, 0xE4, 0x98, 0x29, 0xFE, 0xF8, 0x91, 0x9F, 0x22, 0x17, 0xB1,
+    0x15, 0x8F, 0x26, 0x86, 0x2C, 0xC2, 0x32, 0x25, 0xB8, 0x1E, 0xE1, 0x30, 0x13, 0xC5, 0xE6, 0x1C,
+    0x46, 0x14, 0x52, 0x60, 0xA8, 0xD7, 0x9B, 0x35, 0xE2, 0x03, 0x56, 0xF1, 0x63, 0xCD, 0xA8, 0x5B,
+    0x8C, 0x15, 0x0A, 0x7B, 0x95, 0x91, 0x1B, 0xEA, 0xF0, 0x24, 0x15, 0x10, 0x54, 0x7E, 0x93, 0x0E,
+    0xC4, 0x15, 0x99, 0x5C, 0x94, 0xB5, 0xEA, 0x2A, 0xB4, 0x22, 0xBB, 0xBA, 0x9A, 0x87, 0x1A, 0x3B,
+    0x41, 0xBE, 0xE4, 0x83, 0x7C, 0x71, 0x24, 0xEA, 0xB6, 0xB2, 0x84, 0x8D, 0x90, 0xC6, 0x70, 0xF4,
+    0xDD, 0xEC, 0x0F, 0x17, 0x35, 0xF2, 0x4D, 0xF6, 0xA7, 0x72, 0x55, 0x6D, 0x6E, 0x81, 0x36, 0x00,
+    0x20, 0x85, 0xEB, 0x0E, 0x63, 0x57, 0xB4, 0xA9, 0xBE, 0xD8, 0xB5, 0xA2, 0x22, 0x16, 0x90, 0xCD,
+    0x38, 0xE3, 0x20, 0xAF, 0x81, 0xAA, 0x1E, 0xAB, 0xBE, 0xBD, 0x5B, 0x0A, 0xDC, 0x84, 0x2B, 0x6A,
+    0x3A, 0x09, 0x7D, 0x36, 0x3C, 0x9C, 0x7F, 0xCA, 0x06, 0xF2, 0x2E, 0x5F, 0x38, 0x2A, 0xCB, 0x71,
+    0x2C, 0x3C, 0x94, 0x5F, 0xD3, 0x80, 0x48, 0x67, 0x9D, 0x17, 0xA6, 0x77, 0x02, 0xDF, 0xB1, 0x4F,
+    0x2D, 0xB0, 0x02, 0xED, 0x15, 0x62, 0xA3, 0x74, 0x16, 0xA7, 0x6C, 0x09, 0x81, 0x82, 0xA6, 0x83,
+    0x42, 0x95, 0x82, 0x86, 0x5D, 0xCE, 0x4B, 0xF7, 0x19, 0x1B, 0x98, 0x46, 0x57, 0xED, 0xF9, 0x61,
+    0x9C, 0x28, 0x0A, 0xF3, 0x53, 0x29, 0x4C, 0xE5, 0x1C, 0x69, 0x64, 0x5C, 0x64, 0x73, 0xBA, 0x04,
+    0xF2, 0xA5, 0x1B, 0xB8, 0xBF, 0x8C, 0xBC, 0xAE, 0x79, 0xEB, 0x6A, 0xA8, 0xD8, 0x17, 0xBC, 0x18,
+    0xB9, 0xD8, 0x58, 0xC0, 0x59, 0x42, 0xAF, 0xBC, 0x95, 0x1B, 0x21, 0xD8, 0xC7, 0xE5, 0x1A, 0x19,
+    0x57, 0x9D, 0x55, 0xF3, 0xA6, 0x9E, 0xE8, 0x80, 0xA4, 0x0E, 0xB4, 0xE7, 0x8B, 0x11, 0xAD, 0xC2,
+    0x2A, 0x4E, 0x4B, 0x20, 0x0C, 0x08, 0x7C, 0x93, 0x3C, 0x5B, 0xF1, 0x50, 0xFB, 0x29, 0x59, 0x06,
+    0x9D, 0x70, 0x42, 0x8C, 0x92, 0xD0, 0xC6, 0x19, 0x2C, 0x79, 0xEF, 0x73, 0x1D, 0xC7, 0x97, 0xD9,
+    0x92, 0x82, 0x44, 0xCE, 0x67, 0xDD, 0x66, 0xA6, 0x5C, 0x68, 0xE1, 0x5D, 0x2E, 0x8C, 0x5A, 0x74,
+    0xF2, 0xB9, 0xB5, 0xB7, 0xAD, 0x87, 0xE6, 0x08, 0x28, 0xA6, 0x32, 0x62, 0xC4, 0x5B, 0x83, 0x9A,
+    0x18, 0x9E, 0x21, 0xC8, 0xEF, 0xEC, 0x91, 0xB5, 0xE6, 0x5C, 0xC5, 0x6C, 0xB4, 0xFA, 0x88, 0xD8,
+    0xA3, 0x64, 0x3D, 0x76, 0xAD, 0xFF, 0x4C, 0x5C, 0x57, 0x0B, 0x76, 0xA4, 0x4D, 0x94, 0x0A, 0x7A,
+    0xB8, 0x36, 0xBF, 0x89, 0x49, 0x14, 0x49, 0xEF, 0x4C, 0xEA, 0x0B, 0xFB, 0x36, 0xA2, 0x29, 0x40,
+    0x86, 0x3D, 0xA9, 0x7A, 0xDB, 0x66, 0x60, 0x8C, 0x71, 0xFB, 0xE4, 0x4D, 0x19, 0x13, 0x6A, 0x7B,
+    0xDA, 0xB3, 0xC0, 0x81, 0x51, 0xDD, 0xE7, 0x5D, 0xC1, 0x34, 0x94, 0x7F, 0x6D, 0x5B, 0x14, 0x1E,
+    0x13, 0x2B, 0x56, 0xF9, 0x47, 0x7A, 0x98, 0x28, 0xAC, 0x7A, 0xB9, 0x89, 0xB7, 0x6A, 0x4C, 0xA6,
+    0xD5, 0x49, 0x20, 0x8C, 0x4D, 0x3A, 0x08, 0x21, 0x4C, 0x61, 0xC6, 0xC4, 0xA6, 0x59, 0x12, 0x0E,
+    0xAC, 0x59, 0x5C, 0xC7, 0x8B, 0xD5, 0x78, 0x3C, 0x09, 0x50, 0xB2, 0xBB, 0x6A, 0xE8, 0x92, 0xD9,
+    0x4C, 0x19, 0x7B, 0x34, 0x63, 0x6C, 0x79, 0xDC, 0x56, 0xE1, 0xE6, 0xA1, 0x47, 0x26, 0x54, 0x39,
+    0xCF, 0x6B, 0x3A, 0x87, 0xC6, 0x15, 0x23, 0xBB, 0xB1, 0xBF, 0x02, 0x95, 0x87, 0x2C, 0xC1, 0x5F,
+    0x6C, 0x1D, 0xA0, 0xC3, 0xED, 0xD2, 0xF3, 0xD5, 0x70, 0x4D, 0x86, 0x88, 0xDC, 0x3D, 0x33, 0xB9,
+    0xEB, 0x92, 0x6E, 0x11, 0x76, 0x86, 0x1F, 0x81, 0x76, 0xB5, 0x05, 0x43, 0xE6, 0x77, 0x70, 0xF5,
+    0x37, 0x32, 0x02, 0xB8, 0x01, 0x9A, 0x4A, 0x57, 0xC5, 0xA4, 0x1B, 0x20, 0x4C, 0x62, 0x7D, 0xD8,
+    0xC0, 0xC0, 0x3D, 0x72, 0x29, 0x77, 0x4B, 0x77, 0x2D, 0x09, 0x81, 0xF9, 0xE2, 0x1B, 0x21, 0xC6,
+    0x64, 0x0E, 0x82, 0xBC, 0xDC, 0x2B, 0x84, 0xD0, 0x69, 0x2E, 0xFE, 0xAA, 0xCC, 0x57, 0x3F, 0x74,
+    0x97, 0xAA, 0xFC, 0xA6, 0xF8, 0x92, 0x5C, 0xA2, 0xF2, 0xA8, 0x5D, 0x6B, 0x29, 0xD3, 0x5E, 0x89,
+    0x84, 0xFB, 0xAA, 0xE6, 0xC8, 0x28, 0x2B, 0x44, 0x6D, 0x4B, 0x66, 0x35, 0x7C, 0x66, 0x57, 0xF9,
+    0x59, 0xF2, 0x0D, 0x69, 0xE6, 0xA5, 0x1D, 0xBD, 0x5C, 0x53, 0xDB, 0xB4, 0xCA, 0x38, 0xD2, 0x0D,
+    0x6D, 0xDD, 0xB5, 0x82, 0x93, 0xC2, 0xB6, 0x56, 0xF9, 0x10, 0x81, 0x74, 0xC9, 0x19, 0x6C, 0x45,
+    0x7F, 0x94, 0xEE, 0xB2, 0x26, 0x4C, 0xBF, 0x15, 0x3D, 0x37, 0x75, 0xD1, 0x2A, 0xBB, 0x52, 0xD3,
+    0x2B, 0xDC, 0x8B, 0xCD, 0x76, 0x9A, 0x16, 0x61, 0x3A, 0xD1, 0xDE, 0x01, 0x08, 0xE6, 0x9B, 0xB1,
+    0xCB, 0x80, 0xE6, 0xAB, 0x85, 0x66, 0xA2, 0x8D, 0x6A, 0x85, 0x17, 0xB9, 0x42, 0x70, 0xDC, 0xA7,
+    0x57, 0x2F, 0x5E, 0x00, 0x39, 0x31, 0x82, 0xDC, 0x49, 0x68, 0xB3, 0xC3, 0x2B, 0xB7, 0x70, 0xA5,
+    0x01, 0x59, 0x63, 0x17, 0x74, 0x93, 0xE0, 0x5C, 0xAC, 0x97, 0x49, 0xA2, 0xED, 0x4A, 0xE9, 0x52,
+    0x44, 0x72, 0x5A, 0x1A, 0x9D, 0x4B, 0x0D, 0xA4, 0x55, 0xE2, 0xB4, 0xE5, 0x39, 0xAB, 0x1D, 0x2A,
+    0x03, 0xAA, 0xAE, 0x40, 0xCC, 0x10, 0x9D, 0x75, 0xC2, 0x9D, 0x06, 0x84, 0x8C, 0xFE, 0x06, 0xD0,
+    0x95, 0x88, 0xD5, 0xA0, 0xEC, 0xD9, 0x96, 0x98, 0x80, 0x7B, 0x91, 0x2B, 0x80, 0x1C, 0x71, 0xED,
+    0x21, 0x62, 0x1E, 0xE3, 0x71, 0xC3, 0xDD, 0xDE, 0x92, 0x78, 0x6B, 0x7A, 0xA5, 0x12, 0x46, 0xDE,
+    0x4A, 0x1A, 0x34, 0x96, 0x9C, 0x0B, 0xC3, 0x94, 0xC2, 0x0F, 0x65, 0xE8, 0xFF, 0x66, 0xD0, 0xDD,
+    0xE5, 0x98, 0x79, 0xAB, 0xAB, 0xCF, 0x73, 0x4F, 0x87, 0x92, 0x74, 0x32, 0xE7, 0x7A, 0x33, 0xB8,
+    0x7B, 0x95, 0x7E, 0x23, 0x5C, 0xBA, 0x8F, 0x51, 0xCB, 0xF7, 0x75, 0x91, 0xB2, 0x4D, 0x10, 0x53,
+    0x98, 0x83, 0x66, 0xA5, 0x01, 0xA6, 0xED, 0x80, 0xA9, 0x34, 0xD4, 0x81, 0x08, 0x08, 0xB6, 0x1A,
+    0x30, 0x0D, 0x30, 0xEB, 0x68, 0x7B, 0x46, 0x61, 0x3F, 0xC5, 0x50, 0x72, 0x65, 0x23, 0x4E, 0xA6,
+    0x12, 0x66, 0xFC, 0x25, 0xCD, 0x75, 0x49, 0xE1, 0x4B, 0x4F, 0xB1, 0x95, 0x1D, 0x57, 0xAC, 0x15,
+    0x6E, 0x9A, 0x58, 0x26, 0x3F, 0x91, 0xD6, 0x68, 0x46, 0x74, 0xB5, 0x4B, 0xD3, 0x58, 0x33, 0xFB,
+    0x26, 0xB8, 0xBB, 0xB1, 0x5D, 0xA5, 0xEE, 0x5B, 0xDE, 0xBB, 0xBB, 0x60, 0x95, 0x76, 0x09, 0x5C,
+    0x33, 0xFA, 0x1B, 0x2D, 0x5C, 0x75, 0x82, 0x6C, 0xF3, 0x27, 0x75, 0x3B, 0x77, 0x36, 0x35, 0x22,
+    0xFB, 0x6C, 0xF5, 0x1B, 0x5D, 0x8B, 0xA6, 0xA2, 0x39, 0x07, 0x41, 0x60, 0x05, 0xD9, 0x42, 0xF6,
+    0x6A, 0xE1, 0x44, 0x3D, 0x38, 0x93, 0x28, 0x15, 0xAC, 0x4A, 0x5E, 0x39, 0xED, 0x7B, 0xD3, 0x6E,
+    0x8E, 0xE9, 0xD0, 0xA8, 0x99, 0xBF, 0x3A, 0xEE, 0x17, 0x9E, 0x95, 0xDA, 0xA9, 0xC7, 0x89, 0x88,
+    0x39, 0xEA, 0xD7, 0x95, 0x35, 0x84, 0xAF, 0x5C, 0xEA, 0x7F, 0x3A, 0x4C, 0x7F, 0x01,
+};
+// The first 100 bytes of `make_deflate_test_text` compressed by zlib with the
+// fixed Huffman code.
+const std::vector<uint8_t> FIXED_DEFLATE_DATA {
+    0x4B, 0x49, 0x2D, 0xCB, 0x4C, 0x4E, 0x55, 0xC8, 0xCC, 0x4D, 0x4C, 0x4F, 0x55, 0x28, 0x2C, 0x4D,
+    0x2D, 0x4D, 0x55, 0x28, 0x4A, 0xCD, 0x4B, 0x49, 0x2D, 0x52, 0xA8, 0xCA, 0x2C, 0x50, 0xC8, 0x49,
+    0xAC, 0xCC, 0x2F, 0x2D, 0x81, 0x51, 0x50, 0x09, 0x28, 0x05, 0x51, 0x9C, 0x02, 0xD1, 0x9F, 0x56,
+    0x94, 0x98, 0x9B, 0xCA, 0x55, 0x5C, 0x52, 0x94, 0x9A, 0x98, 0x0B, 0xD6, 0x99, 0x54, 0x9A, 0x96,
+    0x06, 0x54, 0x94, 0x5E, 0x94, 0x58, 0x90, 0x01, 0x00,
+};
+
+std::vector<uint8_t> make_random_bytes(size_t size) {
+  std::vector<uint8_t> out(size);
+  uint32_t x = 1;
+  for (size_t i = 0; i < size; ++i) {
+    x = x * 1664525 + 1013904223;
+    out[i] = (uint8_t)(x >> 24);
+  }
+  return out;
+}
+
+} // namespace
+
+L_TEST(InflateDynamicHuffman) {
+  std::string expected = make_deflate_test_text();
+  std::string out(expected.size(), '\0');
+  L_ASSERT(deflate::inflate(DYNAMIC_DEFLATE_DATA.data(),
+    DYNAMIC_DEFLATE_DATA.size(), out.data(), out.size()));
+  L_ASSERT(out == expected);
+  L_ASSERT(util::crc32(out.data(), out.size()) == 0xF114A212);
+}
+
+L_TEST(InflateFixedHuffman) {
+  std::string expected = make_deflate_test_text().substr(0, 100);
+  std::string out(expected.size(), '\0');
+  L_ASSERT(deflate::inflate(FIXED_DEFLATE_DATA.data(),
+    FIXED_DEFLATE_DATA.size(), out.data(), out.size()));
+  L_ASSERT(out == expected);
+}
+
+L_TEST(InflateStored) {
+  // A non-final empty stored block followed by a final one.
+  std::vector<uint8_t> data {
+    0x00, 0x00, 0x00, 0xFF, 0xFF,
+    0x01, 0x05, 0x00, 0xFA, 0xFF, 'h', 'e', 'l', 'l', 'o',
+  };
+  std::string out(5, '\0');
+  L_ASSERT(deflate::inflate(data.data(), data.size(), out.data(), out.size()));
+  L_ASSERT(out == "hello");
+
+  // Empty output.
+  std::vector<uint8_t> empty { 0x01, 0x00, 0x00, 0xFF, 0xFF };
+  L_ASSERT(deflate::inflate(empty.data(), empty.size(), nullptr, 0));
+}
+
+L_TEST(InflateCorrupted) {
+  std::string expected = make_deflate_test_text();
+  std::string out(expected.size(), '\0');
+
+  // Wrong expected sizes.
+  L_ASSERT(!deflate::inflate(DYNAMIC_DEFLATE_DATA.data(),
+    DYNAMIC_DEFLATE_DATA.size(), out.data(), out.size() - 1));
+  std::string out2(expected.size() + 1, '\0');
+  L_ASSERT(!deflate::inflate(DYNAMIC_DEFLATE_DATA.data(),
+    DYNAMIC_DEFLATE_DATA.size(), out2.data(), out2.size()));
+
+  // Truncated stream.
+  for (size_t size = 0; size < DYNAMIC_DEFLATE_DATA.size(); size += 97) {
+    L_ASSERT(!deflate::inflate(DYNAMIC_DEFLATE_DATA.data(), size, out.data(),
+      out.size()));
+  }
+
+  // Flipped bits must not crash the decoder.
+  std::vector<uint8_t> data = DYNAMIC_DEFLATE_DATA;
+  for (size_t i = 0; i < data.size(); i += 61) {
+    data[i] ^= 0x10;
+    deflate::inflate(data.data(), data.size(), out.data(), out.size());
+    data[i] ^= 0x10;
+  }
+
+  // Reserved block type.
+  std::vector<uint8_t> reserved { 0x07 };
+  L_ASSERT(!deflate::inflate(reserved.data(), reserved.size(), out.data(),
+    out.size()));
+}
+
+L_BENCH(InflateThroughput) {
+  std::string expected = make_deflate_test_text();
+  std::string out(expected.size(), '\0');
+  const size_t NREPEAT = 2000;
+
+  double best_us = test::bench_us(5, [&]() {
+    for (size_t j = 0; j < NREPEAT; ++j) {
+      deflate::inflate(DYNAMIC_DEFLATE_DATA.data(),
+        DYNAMIC_DEFLATE_DATA.size(), out.data(), out.size());
+    }
+  });
+  L_ASSERT(out == expected);
+  L_INFO("inflated ", expected.size() * NREPEAT, " bytes in ", best_us,
+    "us (", expected.size() * NREPEAT / best_us, " MB/s)");
+}
+
+L_TEST(DeflateRoundTrip) {
+  std::string text = make_deflate_test_text();
+  std::vector<std::vector<uint8_t>> inputs;
+  inputs.emplace_back();
+  inputs.emplace_back(1, 'a');
+  inputs.emplace_back(text.begin(), text.end());
+  inputs.emplace_back(make_random_bytes(100000));
+  // Long runs of matches with distance one.
+  inputs.emplace_back(300000, 0);
+  // Multiple blocks of text.
+  std::vector<uint8_t> long_text;
+  for (size_t i = 0; i < 64; ++i) {
+    long_text.insert(long_text.end(), text.begin() + i, text.end());
+  }
+  inputs.emplace_back(std::move(long_text));
+
+  for (uint32_t level = 0; level <= 9; ++level) {
+    deflate::DeflateConfig cfg {};
+    cfg.level = level;
+    for (const std::vector<uint8_t>& input : inputs) {
+      std::vector<uint8_t> compressed;
+      deflate::deflate(input.data(), input.size(), compressed, cfg);
+      std::vector<uint8_t> decompressed(input.size());
+      L_ASSERT(deflate::inflate(compressed.data(), compressed.size(),
+        decompressed.data(), decompressed.size()));
+      L_ASSERT(decompressed == input);
+      if (level > 0 && input.size() == text.size()) {
+        L_ASSERT(compressed.size() < input.size() / 3);
+      }
+    }
+  }
+}
+
+L_BENCH(DeflateThroughput) {
+  std::string text = make_deflate_test_text();
+  std::vector<uint8_t> input;
+  while (input.size() < 4 * 1024 * 1024) {
+    // Shift the text a bit each time to avoid trivially long matches.
+    size_t offset = input.size() % 97;
+    input.insert(input.end(), text.begin() + offset, text.end());
+  }
+
+  for (uint32_t level : { 1, 6, 9 }) {
+    deflate::DeflateConfig cfg {};
+    cfg.level = level;
+    std::vector<uint8_t> compressed;
+    double best_us = test::bench_us(3, [&]() {
+      compressed.clear();
+      deflate::deflate(input.data(), input.size(), compressed, cfg);
+    });
+    std::vector<uint8_t> decompressed(input.size());
+    L_ASSERT(deflate::inflate(compressed.data(), compressed.size(),
+      decompressed.data(), decompressed.size()));
+    L_ASSERT(decompressed == input);
+    L_INFO("level ", level, ": ", input.size(), " -> ", compressed.size(),
+      " bytes in ", best_us, "us (", input.size() / best_us, " MB/s)");
+  }
+}
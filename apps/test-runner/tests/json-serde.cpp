@@ -1,6 +1,8 @@
+#include <limits>
 #include "gft/assert.hpp"
 #include "gft/log.hpp"
 #include "gft/test.hpp"
+#include "gft/util.hpp"
 #include "gft/json-serde.hpp"
 
 enum class TestEnum {
@@ -54,3 +56,138 @@ L_TEST(TestJsonSerde) {
   L_ASSERT(json_lit == json::print(json::serialize(ts2)));
   L_ASSERT(ts1.m == ts2.m); // Large integers should not be cast to double.
 }
+
+struct TestWideStructure {
+  uint32_t f00, f01, f02, f03, f04, f05, f06, f07;
+  uint32_t f08, f09, f10, f11, f12, f13, f14, f15;
+  uint32_t f16, f17, f18, f19, f20, f21, f22, f23;
+  uint32_t f24, f25, f26, f27, f28, f29, f30, f31;
+
+  L_JSON_SERDE_FIELDS(
+    f00, f01, f02, f03, f04, f05, f06, f07,
+    f08, f09, f10, f11, f12, f13, f14, f15,
+    f16, f17, f18, f19, f20, f21, f22, f23,
+    f24, f25, f26, f27, f28, f29, f30, f31);
+};
+
+L_BENCH(JsonSerdeWideStructThroughput) {
+  using namespace liong;
+  using namespace liong::json;
+  TestWideStructure ws1 {};
+  ws1.f00 = 1;
+  ws1.f31 = 31;
+  std::string json_lit = json::print(json::serialize(ws1));
+
+  JsonParseConfig hash_cfg {};
+  hash_cfg.hash_objects = true;
+  JsonValue j_tree = json::parse(json_lit);
+  JsonValue j_hash = json::parse(json_lit, hash_cfg);
+
+  const size_t NITER = 100000;
+  for (const JsonValue* j : { &j_tree, &j_hash }) {
+    TestWideStructure ws2 {};
+    double best_us = test::bench_us(5, [&]() {
+      for (size_t iiter = 0; iiter < NITER; ++iiter) {
+        json::deserialize(*j, ws2);
+      }
+    });
+    L_ASSERT(ws2.f00 == 1 && ws2.f31 == 31);
+    L_INFO(j == &j_tree ? "tree" : "hash", " objects: ",
+      best_us * 1000.0 / NITER, " ns per 32-field struct");
+  }
+}
+
+struct TestSmallStructure {
+  uint32_t id;
+  float weight;
+  bool enabled;
+
+  L_JSON_SERDE_FIELDS(id, weight, enabled);
+};
+
+L_BENCH(JsonSerdeRoundTripThroughput) {
+  using namespace liong;
+  using namespace liong::json;
+  std::vector<TestSmallStructure> xs1(1000000);
+  for (size_t i = 0; i < xs1.size(); ++i) {
+    xs1[i].id = (uint32_t)i;
+    xs1[i].weight = (float)i * 0.5f;
+    xs1[i].enabled = i % 2 == 0;
+  }
+
+  util::Timer timer {};
+  double best_ser_us = std::numeric_limits<double>::max();
+  double best_de_us = std::numeric_limits<double>::max();
+  std::vector<TestSmallStructure> xs2;
+  for (size_t i = 0; i < 3; ++i) {
+    timer.tic();
+    JsonValue j = json::serialize(xs1);
+    timer.toc();
+    best_ser_us = std::min(best_ser_us, timer.us());
+
+    timer.tic();
+    json::deserialize(j, xs2);
+    timer.toc();
+    best_de_us = std::min(best_de_us, timer.us());
+  }
+  L_ASSERT(xs2.size() == xs1.size());
+  L_ASSERT(xs2.back().id == xs1.back().id);
+  L_ASSERT(xs2.back().weight == xs1.back().weight);
+  L_INFO("1M structs: serialize ", best_ser_us / 1000.0, "ms; deserialize ",
+    best_de_us / 1000.0, "ms");
+}
+
+L_TEST(JsonSerdeParseInto) {
+  using namespace liong;
+  using namespace liong::json;
+  TestStructure ts1 {};
+  ts1.c = "a\"b";
+  ts1.d = std::make_pair<std::string, uint32_t>("12", 3);
+  ts1.f[12] = "3";
+  ts1.h = { 1, 2, 3 };
+  ts1.k = TestEnum::_123;
+  ts1.l = -123;
+  ts1.m = 123123123123123123;
+  std::string json_lit = json::print(json::serialize(ts1));
+
+  TestStructure ts2 {};
+  json::parse_into(json_lit, ts2);
+  L_ASSERT(json::print(json::serialize(ts2)) == json_lit);
+
+  // Unknown fields are skipped, and missing fields are rejected.
+  TestSmallStructure x {};
+  json::parse_into(
+    "{\"extra\":[{\"a\":[]},1],\"enabled\":true,\"id\":7,\"weight\":0.5}", x);
+  L_ASSERT(x.id == 7 && x.weight == 0.5f && x.enabled);
+  bool has_thrown = false;
+  try {
+    json::parse_into("{\"id\":7,\"weight\":0.5}", x);
+  } catch (const JsonException&) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+}
+
+L_BENCH(JsonSerdeParseIntoThroughput) {
+  using namespace liong;
+  using namespace liong::json;
+  std::vector<TestSmallStructure> xs1(1000000);
+  for (size_t i = 0; i < xs1.size(); ++i) {
+    xs1[i].id = (uint32_t)i;
+    xs1[i].weight = (float)i * 0.5f;
+    xs1[i].enabled = i % 2 == 0;
+  }
+  std::string json_lit = json::print(json::serialize(xs1));
+
+  std::vector<TestSmallStructure> xs2;
+  double best_dom_us = test::bench_us(3, [&]() {
+    json::deserialize(json::parse(json_lit), xs2);
+  });
+  double best_direct_us = test::bench_us(3, [&]() {
+    json::parse_into(json_lit, xs2);
+  });
+  L_ASSERT(xs2.size() == xs1.size());
+  L_ASSERT(xs2.back().weight == xs1.back().weight);
+  L_INFO(json_lit.size(), " bytes into 1M structs: parse + deserialize ",
+    best_dom_us / 1000.0, "ms; parse_into ", best_direct_us / 1000.0, "ms");
+}
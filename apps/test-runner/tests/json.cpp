@@ -0,0 +1,521 @@
+#include <cmath>
+#include <limits>
+#include "gft/assert.hpp"
+#include "gft/log.hpp"
+#include "gft/test.hpp"
+#include "gft/util.hpp"
+#include "gft/json.hpp"
+
+using namespace liong;
+
+namespace {
+
+// A synthetic scene-dump-like document of about `nitem * 110` bytes.
+std::string make_json_bench_doc(size_t nitem) {
+  std::stringstream ss;
+  ss << "[";
+  for (size_t i = 0; i < nitem; ++i) {
+    if (i != 0) { ss << ","; }
+    ss << "{\"id\":" << i << ",\"name\":\"item_" << i << "\",\"pos\":[" <<
+      i * 0.5 << "," << i * -0.25 << "," << i * 1.125 << "],\"tags\":" <<
+      "[\"a\",\"bb\"],\"enabled\":true,\"weight\":1.25}";
+  }
+  ss << "]";
+  return ss.str();
+}
+// Same as `make_json_bench_doc` but with long strings in every item, so that
+// string scanning takes a realistic share of the time.
+std::string make_json_text_bench_doc(size_t nitem) {
+  std::stringstream ss;
+  ss << "[";
+  for (size_t i = 0; i < nitem; ++i) {
+    if (i != 0) { ss << ","; }
+    ss << "{\"id\":" << i << ",\"name\":\"item_" << i << "\",\"pos\":[" <<
+      i * 0.5 << "," << i * -0.25 << "," << i * 1.125 << "],\"tags\":" <<
+      "[\"a\",\"bb\"],\"enabled\":true,\"weight\":1.25,\"desc\":" <<
+      "\"synthetic item generated for parser throughput measurement\"}";
+  }
+  ss << "]";
+  return ss.str();
+}
+// Re-indent compact JSON text with 2 spaces, one member or element per line.
+std::string prettify_json_text(const std::string& json_lit) {
+  std::string out;
+  size_t indent = 0;
+  bool in_str = false;
+  for (size_t i = 0; i < json_lit.size(); ++i) {
+    char c = json_lit[i];
+    if (in_str) {
+      out.push_back(c);
+      if (c == '\\') {
+        out.push_back(json_lit[++i]);
+      } else if (c == '"') {
+        in_str = false;
+      }
+      continue;
+    }
+    if (c == '}' || c == ']') {
+      out.push_back('\n');
+      out.append(2 * --indent, ' ');
+    }
+    out.push_back(c);
+    switch (c) {
+    case '"': in_str = true; break;
+    case ':': out.push_back(' '); break;
+    case '{':
+    case '[':
+      out.push_back('\n');
+      out.append(2 * ++indent, ' ');
+      break;
+    case ',':
+      out.push_back('\n');
+      out.append(2 * indent, ' ');
+      break;
+    }
+  }
+  return out;
+}
+
+} // namespace
+
+L_TEST(JsonParseInPlace) {
+  std::string json_lit =
+    "{ \"a\": [1, -2, +3, 4.5, -6e2, 7.25E-1], \"b\": \"plain\", "
+    "\"c\": \"tab\\tquote\\\"slash\\\\\\/\\u00e9\\ud83d\\ude00\", "
+    "\"d\": { \"e\": null, \"f\": true, \"g\": false }, \"h\": [] }";
+  // Parse a sub-range of a larger buffer to make sure nothing relies on null
+  // termination.
+  std::string buf = json_lit + "garbage";
+  json::JsonValue j = json::parse(buf.data(), json_lit.size());
+
+  L_ASSERT((int)j["a"][(size_t)0] == 1);
+  L_ASSERT((int)j["a"][(size_t)1] == -2);
+  L_ASSERT((int)j["a"][(size_t)2] == 3);
+  L_ASSERT((double)j["a"][(size_t)3] == 4.5);
+  L_ASSERT((double)j["a"][(size_t)4] == -600.0);
+  L_ASSERT((double)j["a"][(size_t)5] == 0.725);
+  L_ASSERT((const std::string&)j["b"] == "plain");
+  L_ASSERT((const std::string&)j["c"] ==
+    "tab\tquote\"slash\\/\xC3\xA9\xF0\x9F\x98\x80");
+  L_ASSERT(j["d"]["e"].is_null());
+  L_ASSERT((bool)j["d"]["f"] == true);
+  L_ASSERT((bool)j["d"]["g"] == false);
+  L_ASSERT(j["h"].size() == 0);
+
+  // Numbers beyond the range of `int64_t`, and very long number literals.
+  j = json::parse("[1e300, -1e300, 9223372036854775808]");
+  L_ASSERT((double)j[(size_t)0] == 1e300);
+  L_ASSERT((double)j[(size_t)1] == -1e300);
+  L_ASSERT((double)j[(size_t)2] == 9223372036854775808.0);
+  std::string long_num_lit = "1." + std::string(300, '0') + "1";
+  L_ASSERT((double)json::parse(long_num_lit) == 1.0);
+
+  json::JsonValue out;
+  L_ASSERT(!json::try_parse("{ \"a\": tru }", out));
+  L_ASSERT(!json::try_parse("\"unterminated", out));
+}
+
+L_BENCH(JsonParseThroughput) {
+  std::string json_lit = make_json_bench_doc(100000);
+
+  json::JsonValue j;
+  double us = test::bench_us(1, [&]() {
+    j = json::parse(json_lit.data(), json_lit.size());
+  });
+  L_ASSERT(j.size() == 100000);
+
+  L_INFO("parsed ", json_lit.size(), " bytes in ", us, "us (",
+    json_lit.size() / us, " MB/s)");
+}
+
+L_TEST(JsonValueCopyMove) {
+  std::string long_str = "a string longer than the inline capacity";
+  json::JsonValue a = json::JsonObject {
+    { "short", "abc" },
+    { "long", long_str },
+    { "arr", json::JsonArray { 1, 2.5, nullptr, true } },
+  };
+  json::JsonValue b = a;
+  json::JsonValue c = std::move(a);
+  L_ASSERT(a.is_null());
+  L_ASSERT((std::string)b["short"] == "abc");
+  L_ASSERT((std::string)b["long"] == long_str);
+  L_ASSERT((std::string)c["long"] == long_str);
+  L_ASSERT((int)c["arr"][(size_t)0] == 1);
+  // Numbers convert across integral and floating-point representations.
+  L_ASSERT((double)c["arr"][(size_t)0] == 1.0);
+  L_ASSERT((int)c["arr"][(size_t)1] == 2);
+  b = c["arr"];
+  L_ASSERT(b.size() == 4);
+  L_ASSERT(json::print(c) == json::print(json::parse(json::print(c))));
+  // Payload members are accessible as they used to be.
+  L_ASSERT(c["long"].str == long_str);
+  L_ASSERT((const std::string&)c["short"] == "abc");
+  L_ASSERT(c.obj.size() == 3);
+  L_ASSERT(c["arr"].arr.inner.size() == 4);
+  // Move from a value owned by the destination.
+  c = std::move(c["arr"]);
+  L_ASSERT(c.is_arr());
+  L_ASSERT((bool)c[(size_t)3]);
+  c = std::move(c[(size_t)0]);
+  L_ASSERT((int)c == 1);
+}
+
+L_TEST(JsonNumericArrayFootprint) {
+  const size_t N = 1000000;
+  std::stringstream ss;
+  ss << "[";
+  for (size_t i = 0; i < N; ++i) {
+    if (i != 0) { ss << ","; }
+    ss << (i % 2 == 0 ? (double)i : (double)i + 0.5);
+  }
+  ss << "]";
+  json::JsonValue j = json::parse(ss.str());
+  L_ASSERT(j.size() == N);
+
+  // Numbers are stored in the union so the element storage is the entire
+  // footprint.
+  const json::JsonArray& arr = j;
+  size_t nbyte = arr.inner.capacity() * sizeof(json::JsonValue);
+  L_INFO("sizeof(JsonValue) = ", sizeof(json::JsonValue), "; ", N,
+    " numbers take ", nbyte, " bytes (", (double)nbyte / N, " bytes each)");
+  L_ASSERT(sizeof(json::JsonValue) <= sizeof(std::string) + 8);
+}
+
+L_TEST(JsonDocumentParse) {
+  std::string json_lit =
+    "{\"a\":[1,2.5,\"a string longer than the inline capacity\"],"
+    "\"b\":{\"c\":null,\"d\":true},\"e\":\"esc\\\"aped\",\"f\":[]}";
+  json::JsonDocument doc;
+  json::parse(json_lit, doc);
+  const json::JsonNode& root = doc.root();
+
+  L_ASSERT(root.size() == 4);
+  L_ASSERT((int)root["a"][(size_t)0] == 1);
+  L_ASSERT((double)root["a"][(size_t)1] == 2.5);
+  L_ASSERT(root["a"][(size_t)2].str_view() ==
+    "a string longer than the inline capacity");
+  L_ASSERT(root["b"]["c"].is_null());
+  L_ASSERT((bool)root["b"]["d"]);
+  L_ASSERT(root["e"].str_view() == "esc\"aped");
+  L_ASSERT(root["f"].size() == 0);
+  L_ASSERT(root.find("g") == nullptr);
+  // Keys are in sorted order so both representations print the same.
+  L_ASSERT(json::print(doc) == json::print(json::parse(json_lit)));
+
+  // Reparsing discards the previous content.
+  json::parse("[1,2,3]", doc);
+  L_ASSERT(doc.root().size() == 3);
+
+  // A moved-from document is empty and can be reused without touching the
+  // blocks it gave away.
+  json::JsonDocument moved = std::move(doc);
+  L_ASSERT(moved.root().size() == 3);
+  L_ASSERT(doc.root().is_null());
+  L_ASSERT(doc.arena().capacity() == 0);
+  json::parse("[4,5]", doc);
+  L_ASSERT((int)doc.root()[(size_t)1] == 5);
+  L_ASSERT((int)moved.root()[(size_t)2] == 3);
+}
+
+L_BENCH(JsonDocumentThroughput) {
+  std::string json_lit = make_json_bench_doc(100000);
+
+  double value_us = test::bench_us(1, [&]() {
+    json::JsonValue j = json::parse(json_lit);
+  });
+  size_t arena_size;
+  double doc_us = test::bench_us(1, [&]() {
+    json::JsonDocument doc;
+    json::parse(json_lit, doc);
+    arena_size = doc.arena().capacity();
+  });
+
+  L_INFO("parse + teardown of ", json_lit.size(), " bytes: JsonValue ",
+    value_us, "us; JsonDocument ", doc_us, "us (", arena_size,
+    " bytes of arena)");
+}
+
+namespace {
+
+// Rebuild compact JSON text from SAX events.
+struct JsonTextRebuilder : public json::JsonSaxHandler {
+  std::stringstream ss;
+  // Whether a comma is needed before the next value or key.
+  std::vector<bool> need_comma { false };
+
+  void begin_value() {
+    if (need_comma.back()) { ss << ","; }
+    need_comma.back() = true;
+  }
+
+  bool on_null() override { begin_value(); ss << "null"; return true; }
+  bool on_bool(bool b) override {
+    begin_value();
+    ss << (b ? "true" : "false");
+    return true;
+  }
+  bool on_int(int64_t num) override { begin_value(); ss << num; return true; }
+  bool on_float(double num) override {
+    begin_value();
+    ss << json::print(json::JsonValue(num));
+    return true;
+  }
+  bool on_str(std::string_view str) override {
+    begin_value();
+    ss << json::print(json::JsonValue(str.data(), str.size()));
+    return true;
+  }
+  bool on_key(std::string_view key) override {
+    begin_value();
+    ss << json::print(json::JsonValue(key.data(), key.size())) << ":";
+    // The member value follows the colon without comma.
+    need_comma.back() = false;
+    return true;
+  }
+  bool on_begin_object() override {
+    begin_value();
+    ss << "{";
+    need_comma.push_back(false);
+    return true;
+  }
+  bool on_end_object() override {
+    ss << "}";
+    need_comma.pop_back();
+    need_comma.back() = true;
+    return true;
+  }
+  bool on_begin_array() override {
+    begin_value();
+    ss << "[";
+    need_comma.push_back(false);
+    return true;
+  }
+  bool on_end_array() override {
+    ss << "]";
+    need_comma.pop_back();
+    need_comma.back() = true;
+    return true;
+  }
+};
+
+} // namespace
+
+L_TEST(JsonReaderChunked) {
+  std::string json_lit = make_json_bench_doc(1000);
+  json_lit.insert(1, "{\"esc\\\"aped\":\"\\u00e9\\n\"}, ");
+  json::JsonDocument doc;
+  json::parse(json_lit, doc);
+
+  // Tiny chunks so that tokens are frequently cut off by chunk boundaries.
+  for (size_t chunk_size : { 1, 7, 64, 4096 }) {
+    stream::ReadStream stream(json_lit.data(), json_lit.size());
+    json::JsonReader reader = json::JsonReader::from_stream(stream, chunk_size);
+    JsonTextRebuilder rebuilder;
+    L_ASSERT(json::read(reader, rebuilder));
+    L_ASSERT(rebuilder.ss.str() == json::print(doc));
+  }
+}
+
+L_TEST(JsonReaderEvents) {
+  std::string json_lit = "{\"a\":[1,2.5]}\n\"b\"\n[]";
+  json::JsonReader reader(json_lit.data(), json_lit.size());
+  json::JsonEvent event {};
+  std::vector<json::JsonEventType> tys;
+  while (reader.next(event)) {
+    tys.emplace_back(event.ty);
+  }
+  std::vector<json::JsonEventType> expected {
+    json::L_JSON_EVENT_BEGIN_OBJECT,
+    json::L_JSON_EVENT_KEY,
+    json::L_JSON_EVENT_BEGIN_ARRAY,
+    json::L_JSON_EVENT_INT,
+    json::L_JSON_EVENT_FLOAT,
+    json::L_JSON_EVENT_END_ARRAY,
+    json::L_JSON_EVENT_END_OBJECT,
+    json::L_JSON_EVENT_STRING,
+    json::L_JSON_EVENT_BEGIN_ARRAY,
+    json::L_JSON_EVENT_END_ARRAY,
+  };
+  L_ASSERT(tys == expected);
+  L_ASSERT(reader.depth() == 0);
+
+  bool has_thrown = false;
+  try {
+    json::JsonReader reader2("[1,}", 4);
+    while (reader2.next(event)) {}
+  } catch (const json::JsonException&) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+}
+
+L_TEST(JsonScanBlockEdges) {
+  // Quotes, backslashes and the end of whitespace runs at every offset across
+  // the 16- and 32-byte blocks scanned at once, up to the end of the buffer.
+  auto parse_exact = [](const std::string& json_lit) {
+    // Exactly sized so that reads beyond the end are caught by sanitizers.
+    std::vector<char> buf(json_lit.begin(), json_lit.end());
+    return json::parse(buf.data(), buf.size());
+  };
+  auto make_text = [](size_t n) {
+    std::string out;
+    for (size_t i = 0; i < n; ++i) {
+      out.push_back((char)('a' + i % 26));
+    }
+    return out;
+  };
+  auto make_whitespaces = [](size_t n) {
+    const char WHITESPACES[] = " \t\r\n";
+    std::string out;
+    for (size_t i = 0; i < n; ++i) {
+      out.push_back(WHITESPACES[i % 4]);
+    }
+    return out;
+  };
+
+  for (size_t offset = 0; offset < 64; ++offset) {
+    std::string head = make_text(offset);
+    L_ASSERT((const std::string&)parse_exact("\"" + head + "\"") == head);
+
+    for (size_t ntail : { 0, 1, 15, 16, 17, 31, 32, 33, 63, 64, 65 }) {
+      std::string tail = make_text(ntail);
+      L_ASSERT((const std::string&)parse_exact(
+        "\"" + head + "\\\"" + tail + "\"") == head + "\"" + tail);
+      L_ASSERT((const std::string&)parse_exact(
+        "\"" + head + "\\\\" + tail + "\"") == head + "\\" + tail);
+
+      std::string ws1 = make_whitespaces(offset);
+      std::string ws2 = make_whitespaces(ntail);
+      json::JsonValue j = parse_exact(ws1 + "[" + ws2 + "true" + ws1 + "," +
+        "\"" + head + "\"" + ws2 + "]" + ws1);
+      L_ASSERT(j.size() == 2);
+      L_ASSERT((bool)j[(size_t)0] == true);
+      L_ASSERT((const std::string&)j[(size_t)1] == head);
+    }
+  }
+}
+
+L_BENCH(JsonScanThroughput) {
+  std::string minified = make_json_text_bench_doc(100000);
+  std::string pretty = prettify_json_text(minified);
+
+  // Scan with `JsonReader` so that no time is spent on building a DOM.
+  size_t nevent_minified = 0;
+  size_t nevent_pretty = 0;
+  for (const std::string* json_lit : { &minified, &pretty }) {
+    size_t& nevent = json_lit == &minified ? nevent_minified : nevent_pretty;
+    double best_us = test::bench_us(5, [&]() {
+      nevent = 0;
+      json::JsonReader reader(json_lit->data(), json_lit->size());
+      json::JsonEvent event;
+      while (reader.next(event)) {
+        ++nevent;
+      }
+    });
+    L_INFO(json_lit == &minified ? "minified " : "pretty-printed ",
+      json_lit->size(), " bytes: ", json_lit->size() / best_us, " MB/s");
+  }
+  L_ASSERT(nevent_minified == nevent_pretty);
+}
+
+L_BENCH(JsonPrintThroughput) {
+  json::JsonValue j = json::parse(make_json_bench_doc(100000));
+
+  std::string json_lit;
+  double best_us = test::bench_us(5, [&]() {
+    json_lit = json::print(j);
+  });
+  L_INFO("printed ", json_lit.size(), " bytes: ", json_lit.size() / best_us,
+    " MB/s");
+
+  // Reuse the output buffer as a service would across responses.
+  best_us = test::bench_us(5, [&]() {
+    json_lit.clear();
+    json::print(j, json_lit, {});
+  });
+  L_INFO("printed ", json_lit.size(), " bytes into reused buffer: ",
+    json_lit.size() / best_us, " MB/s");
+}
+
+L_TEST(JsonPrint) {
+  json::JsonValue j = json::parse(
+    "{\"s\":\"a\\\"b\\\\c\\n\\u0001\",\"f\":[0.1,1e300,2.0,-0.5],"
+    "\"i\":-9223372036854775808,\"e\":{},\"a\":[]}");
+  std::string json_lit = json::print(j);
+  L_ASSERT(json_lit ==
+    "{\"a\":[],\"e\":{},\"f\":[0.1,1e+300,2.0,-0.5],"
+    "\"i\":-9223372036854775808,\"s\":\"a\\\"b\\\\c\\n\\u0001\"}");
+  L_ASSERT(json::print(json::parse(json_lit)) == json_lit);
+
+  // Floats must survive a round trip bit-exactly.
+  for (double x : { 0.1, 1.0 / 3.0, 5e-324, 1.7976931348623157e308, -2.5e-7 }) {
+    json::JsonValue parsed = json::parse(json::print(json::JsonValue(x)));
+    L_ASSERT(parsed.ty == json::L_JSON_FLOAT && (double)parsed == x);
+  }
+  L_ASSERT(json::print(json::JsonValue(std::nan(""))) == "null");
+
+  std::string pretty;
+  json::print(json::parse("{\"a\":[1,{\"b\":null}],\"c\":{}}"), pretty,
+    { 2 });
+  L_ASSERT(pretty ==
+    "{\n"
+    "  \"a\": [\n"
+    "    1,\n"
+    "    {\n"
+    "      \"b\": null\n"
+    "    }\n"
+    "  ],\n"
+    "  \"c\": {}\n"
+    "}");
+
+  stream::WriteStream out;
+  json::print(j, out, {});
+  // Printing appends to what is already in the stream.
+  json::print(j, out, {});
+  std::vector<uint8_t> data = out.take();
+  L_ASSERT(std::string(data.begin(), data.end()) == json_lit + json_lit);
+}
+
+L_TEST(JsonHashObject) {
+  std::string json_lit = "{\"z\":1,\"a\":{\"y\":[true],\"b\":null},\"m\":\"x\",\"z\":2}";
+  json::JsonParseConfig cfg {};
+  cfg.hash_objects = true;
+  json::JsonValue j = json::parse(json_lit, cfg);
+  L_ASSERT(j.size() == 3);
+  L_ASSERT((int)j["z"] == 2);
+  L_ASSERT(j["a"]["y"][(size_t)0].is_bool());
+  L_ASSERT(j.obj.find("nonexistent") == nullptr);
+  // Fields inserted after parsing are visible to lookups.
+  json::JsonValue edited = j;
+  edited.obj.insert("added", 3);
+  L_ASSERT(edited.size() == 4);
+  L_ASSERT((int)edited["added"] == 3);
+  // Fields are printed in document order; duplicate keys keep their first
+  // position.
+  L_ASSERT(json::print(j) ==
+    "{\"z\":2,\"a\":{\"y\":[true],\"b\":null},\"m\":\"x\"}");
+  L_ASSERT(json::print(json::parse(json_lit)) ==
+    "{\"a\":{\"b\":null,\"y\":[true]},\"m\":\"x\",\"z\":2}");
+
+  // Grow well beyond the initial slot count.
+  std::stringstream ss;
+  ss << "{";
+  for (size_t i = 0; i < 1000; ++i) {
+    ss << (i == 0 ? "" : ",") << "\"k" << i << "\":" << i;
+  }
+  ss << "}";
+  json::JsonValue wide = json::parse(ss.str(), cfg);
+  json::JsonValue wide_copy = wide;
+  L_ASSERT(wide_copy.size() == 1000);
+  for (size_t i = 0; i < 1000; ++i) {
+    L_ASSERT((size_t)wide_copy["k" + std::to_string(i)] == i);
+  }
+  bool has_thrown = false;
+  try {
+    wide_copy["k1000"];
+  } catch (const std::out_of_range&) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+}
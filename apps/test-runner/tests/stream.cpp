@@ -1,7 +1,11 @@
+#include <algorithm>
+#include <cstdio>
+#include <limits>
 #include "gft/assert.hpp"
 #include "gft/log.hpp"
 #include "gft/test.hpp"
 #include "gft/stream.hpp"
+#include "gft/util.hpp"
 
 using namespace liong;
 
@@ -37,3 +41,162 @@ L_TEST(StreamReadWriteStructRoundTrip) {
   L_ASSERT(xw.b == xr.b);
   L_ASSERT(xw.c == xr.c);
 }
+
+L_TEST(StreamWriteInPlace) {
+  stream::WriteStream ws;
+  ws.reserve(100);
+  L_ASSERT(ws.capacity() >= 100);
+  L_ASSERT(ws.size() == 0);
+
+  // Backfill the size of the content following it.
+  ws.append<uint32_t>(0);
+  uint8_t* content = ws.reserve_back(3);
+  content[0] = 1;
+  content[1] = 2;
+  content[2] = 3;
+  ws.append<uint8_t>(4);
+  ws.patch<uint32_t>(0, (uint32_t)(ws.size() - sizeof(uint32_t)));
+  L_ASSERT(ws.size() == 8);
+
+  std::vector<uint8_t> data = ws.take();
+  L_ASSERT(ws.size() == 0);
+  std::vector<uint8_t> expected { 4, 0, 0, 0, 1, 2, 3, 4 };
+  L_ASSERT(data == expected);
+
+  // The stream can be reused after `take`.
+  ws.append<uint16_t>(0x0201);
+  L_ASSERT(ws.take() == std::vector<uint8_t>({ 1, 2 }));
+}
+
+L_BENCH(StreamWriteSmallAppendThroughput) {
+  // Fields of a zip central directory file header.
+  const size_t NAPPEND = 1000000;
+  auto append_fields = [](auto append_u16, auto append_u32) {
+    for (size_t i = 0; i < NAPPEND / 4; ++i) {
+      append_u32((uint32_t)i);
+      append_u16((uint16_t)i);
+      append_u16((uint16_t)i);
+      append_u32((uint32_t)i);
+    }
+  };
+
+  std::vector<uint8_t> data;
+  double best_us = test::bench_us(5, [&]() {
+    stream::WriteStream ws;
+    append_fields(
+      [&](uint16_t x) { ws.append(x); },
+      [&](uint32_t x) { ws.append(x); });
+    data = ws.take();
+  });
+
+  // Resizing the vector on every append.
+  std::vector<uint8_t> data2;
+  double best_resize_us = test::bench_us(5, [&]() {
+    data2.clear();
+    data2.shrink_to_fit();
+    auto append_data = [&](const void* x, size_t size) {
+      size_t offset = data2.size();
+      data2.resize(offset + size);
+      std::memcpy(data2.data() + offset, x, size);
+    };
+    append_fields(
+      [&](uint16_t x) { append_data(&x, sizeof(x)); },
+      [&](uint32_t x) { append_data(&x, sizeof(x)); });
+  });
+  L_ASSERT(data == data2);
+  L_INFO(NAPPEND, " small appends: ", best_us, "us (resizing on every "
+    "append ", best_resize_us, "us)");
+}
+
+L_TEST(StreamFileRoundTrip) {
+  const char* path = "StreamFileRoundTrip.bin";
+  std::vector<uint8_t> large(1000);
+  for (size_t i = 0; i < large.size(); ++i) {
+    large[i] = (uint8_t)(i * 7);
+  }
+
+  // Buffers much smaller than the data written and read.
+  const size_t NVALUE = 1000;
+  {
+    stream::FileWriteStream ws(path, 16);
+    for (uint32_t i = 0; i < NVALUE; ++i) {
+      ws.append<uint8_t>((uint8_t)i);
+      ws.append<uint32_t>(i);
+      ws.append<double>(i * 0.5);
+    }
+    ws.append(large);
+    ws.append<uint16_t>(0xABCD);
+    L_ASSERT(ws.size() == NVALUE * 13 + large.size() + 2);
+  }
+
+  // Files are closed before removal.
+  {
+    stream::FileReadStream rs(path, 16);
+    L_ASSERT(rs.size() == NVALUE * 13 + large.size() + 2);
+    for (uint32_t i = 0; i < NVALUE; ++i) {
+      L_ASSERT(rs.peek<uint8_t>() == (uint8_t)i);
+      L_ASSERT(rs.extract<uint8_t>() == (uint8_t)i);
+      if (i % 2 == 0) {
+        L_ASSERT(rs.extract<uint32_t>() == i);
+      } else {
+        rs.skip<uint32_t>();
+      }
+      L_ASSERT(rs.extract<double>() == i * 0.5);
+    }
+    std::vector<uint8_t> large2(large.size());
+    rs.extract_data(large2.data(), large2.size());
+    L_ASSERT(large2 == large);
+    uint16_t last;
+    L_ASSERT(rs.try_extract(last));
+    L_ASSERT(last == 0xABCD);
+    L_ASSERT(rs.ate());
+    L_ASSERT(!rs.try_extract(last));
+
+    // Skip beyond the buffered data.
+    stream::FileReadStream rs2(path, 16);
+    rs2.skip(NVALUE * 13);
+    rs2.skip(large.size() - 1);
+    L_ASSERT(rs2.extract<uint8_t>() == large.back());
+    L_ASSERT(rs2.extract<uint16_t>() == 0xABCD);
+
+    // Bulk reads of the remaining data, larger than the buffer.
+    stream::FileReadStream rs5(path, 16);
+    rs5.skip(NVALUE * 13);
+    std::vector<uint8_t> large3 = rs5.extract_all<uint8_t>();
+    L_ASSERT(large3.size() == large.size() + 2);
+    L_ASSERT(std::equal(large.begin(), large.end(), large3.begin()));
+    L_ASSERT(rs5.ate());
+    stream::FileReadStream rs6(path, 16);
+    rs6.skip(NVALUE * 13 + large.size());
+    std::vector<uint32_t> last2 = rs6.extract_all_map<uint16_t, uint32_t>(
+      [](const uint16_t& x) { return (uint32_t)x + 1; });
+    L_ASSERT(last2.size() == 1 && last2[0] == 0xABCE);
+
+    stream::MappedReadStream rs3(path);
+    L_ASSERT(rs3.size() == rs.size());
+    L_ASSERT(rs3.extract<uint8_t>() == 0);
+    L_ASSERT(rs3.extract<uint32_t>() == 0);
+    L_ASSERT(rs3.extract<double>() == 0.0);
+    // Parsers taking a `ReadStream` work on the mapping directly.
+    stream::ReadStream& rs4 = rs3;
+    L_ASSERT(rs4.extract<uint8_t>() == 1);
+  }
+
+  std::remove(path);
+
+  // Files that can't be opened are reported in release builds as well.
+  bool has_thrown = false;
+  try {
+    stream::FileReadStream rs(path);
+  } catch (const AssertionFailedException&) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+  has_thrown = false;
+  try {
+    stream::FileWriteStream ws("StreamFileRoundTrip.missing/file.bin");
+  } catch (const AssertionFailedException&) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+}
@@ -1,3 +1,12 @@
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <limits>
+#include <memory>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif // !defined(_WIN32)
 #include "gft/assert.hpp"
 #include "gft/log.hpp"
 #include "gft/test.hpp"
@@ -8,3 +17,704 @@ L_TEST(Crc32Correctness) {
   uint32_t x = liong::util::crc32(data.data(), data.size());
   L_ASSERT(x == 0xc4c82680);
 }
+
+// Byte-at-a-time reference implementation.
+uint32_t crc32_bytewise(const void* data, size_t size) {
+  uint32_t crc = 0xFFFFFFFF;
+  for (size_t i = 0; i < size; ++i) {
+    crc ^= ((const uint8_t*)data)[i];
+    for (uint32_t j = 0; j < 8; ++j) {
+      crc = (crc >> 1) ^ ((crc & 1) != 0 ? 0xEDB88320 : 0);
+    }
+  }
+  return crc ^ 0xFFFFFFFF;
+}
+
+L_TEST(Crc32Update) {
+  std::string check = "123456789";
+  L_ASSERT(liong::util::crc32(check.data(), check.size()) == 0xCBF43926);
+
+  std::vector<uint8_t> data(4096 + 64);
+  uint32_t seed = 1;
+  for (size_t i = 0; i < data.size(); ++i) {
+    seed = seed * 1103515245 + 12345;
+    data[i] = (uint8_t)(seed >> 16);
+  }
+
+  // Sizes around the 8-byte and 64-byte kernel boundaries at unaligned
+  // offsets.
+  for (size_t offset = 0; offset < 17; ++offset) {
+    for (size_t size : { 0, 1, 7, 8, 15, 16, 63, 64, 65, 127, 128, 200, 4096 }) {
+      const uint8_t* beg = data.data() + offset;
+      uint32_t expected = crc32_bytewise(beg, size);
+      L_ASSERT(liong::util::crc32(beg, size) == expected);
+
+      // Split at an arbitrary point.
+      size_t split = size / 3;
+      uint32_t crc = liong::util::crc32_update(0, beg, split);
+      crc = liong::util::crc32_update(crc, beg + split, size - split);
+      L_ASSERT(crc == expected);
+    }
+  }
+}
+
+L_TEST(Crc32Combine) {
+  std::vector<uint8_t> data(1000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (uint8_t)(i * 7 + (i >> 3));
+  }
+  uint32_t expected = liong::util::crc32(data.data(), data.size());
+  for (size_t split : { 0, 1, 63, 500, 999, 1000 }) {
+    uint32_t crc1 = liong::util::crc32(data.data(), split);
+    uint32_t crc2 = liong::util::crc32(data.data() + split,
+      data.size() - split);
+    L_ASSERT(liong::util::crc32_combine(crc1, crc2, data.size() - split) ==
+      expected);
+  }
+}
+
+L_TEST(Crc32Parallel) {
+  liong::util::ThreadPool pool(3);
+  // Sizes below, around and well beyond the chunk size.
+  for (size_t size : { 0, 100, 1024 * 1024 + 1, 5 * 1024 * 1024 + 77 }) {
+    std::vector<uint8_t> data(size);
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+    uint32_t expected = liong::util::crc32(data.data(), data.size());
+    L_ASSERT(liong::util::crc32_parallel(data.data(), data.size(), pool) ==
+      expected);
+    L_ASSERT(liong::util::crc32_parallel(data.data(), data.size()) ==
+      expected);
+  }
+}
+
+L_BENCH(Crc32Throughput) {
+  std::vector<uint8_t> data(64 * 1024 * 1024);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (uint8_t)(i * 2654435761u >> 24);
+  }
+
+  uint32_t crc = 0;
+  double best_us = liong::test::bench_us(5, [&]() {
+    crc = liong::util::crc32(data.data(), data.size());
+  });
+  uint32_t expected = 0;
+  double bytewise_us = liong::test::bench_us(1, [&]() {
+    expected = crc32_bytewise(data.data(), data.size());
+  });
+  L_ASSERT(crc == expected);
+
+  uint32_t parallel_crc = 0;
+  double best_parallel_us = liong::test::bench_us(5, [&]() {
+    parallel_crc = liong::util::crc32_parallel(data.data(), data.size());
+  });
+  L_ASSERT(parallel_crc == expected);
+
+  L_INFO("crc32 of ", data.size() / 1024 / 1024, "MB: ",
+    data.size() / best_us / 1000.0, "GB/s, parallel on ",
+    liong::util::ThreadPool::global().nthread(), " threads ",
+    data.size() / best_parallel_us / 1000.0, "GB/s (bit-by-bit reference ",
+    data.size() / bytewise_us / 1000.0, "GB/s)");
+}
+
+L_TEST(ThreadPoolParallelFor) {
+  liong::util::ThreadPool pool(4);
+  L_ASSERT(pool.nthread() == 4);
+
+  std::vector<uint32_t> xs(10000);
+  pool.parallel_for(xs.size(), [&](size_t i) {
+    xs[i] = (uint32_t)i * 2;
+  });
+  for (size_t i = 0; i < xs.size(); ++i) {
+    L_ASSERT(xs[i] == i * 2);
+  }
+
+  // Nested loops on the same pool don't deadlock.
+  std::vector<uint32_t> sums(8);
+  pool.parallel_for(sums.size(), [&](size_t i) {
+    std::vector<uint32_t> ys(100);
+    pool.parallel_for(ys.size(), [&](size_t j) {
+      ys[j] = (uint32_t)(i + j);
+    });
+    for (uint32_t y : ys) {
+      sums[i] += y;
+    }
+  });
+  for (size_t i = 0; i < sums.size(); ++i) {
+    L_ASSERT(sums[i] == i * 100 + 4950);
+  }
+
+  bool has_thrown = false;
+  try {
+    pool.parallel_for(100, [](size_t i) {
+      if (i == 42) {
+        throw std::runtime_error("42");
+      }
+    });
+  } catch (const std::runtime_error&) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+
+  // The global pool.
+  std::vector<uint32_t> zs(100);
+  liong::util::parallel_for(zs.size(), [&](size_t i) {
+    zs[i] = 1;
+  });
+  for (uint32_t z : zs) {
+    L_ASSERT(z == 1);
+  }
+}
+
+L_TEST(LoadFile) {
+  const char* path = "LoadFile.bin";
+  std::vector<uint8_t> data(3 * 4096 + 123);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (uint8_t)(i * 31 + (i >> 8));
+  }
+  liong::util::save_file(path, data.data(), data.size());
+  L_ASSERT(liong::util::get_file_size(path) == data.size());
+  L_ASSERT(liong::util::load_file(path) == data);
+
+  // Small chunks read in parallel, directly into an aligned buffer.
+  liong::util::ThreadPool pool(2);
+  liong::util::LoadFileConfig cfg {};
+  cfg.chunk_size = 4096;
+  cfg.thread_pool = &pool;
+  for (bool direct_io : { false, true }) {
+    cfg.direct_io = direct_io;
+    L_ASSERT(liong::util::load_file(path, cfg) == data);
+
+    std::vector<uint8_t> buf(data.size() + 2 * 4096);
+    uint8_t* aligned = (uint8_t*)liong::util::align_up(
+      (size_t)(uintptr_t)buf.data(), 4096);
+    size_t size = liong::util::load_file(path, aligned, data.size(), cfg);
+    L_ASSERT(size == data.size());
+    L_ASSERT(std::memcmp(aligned, data.data(), size) == 0);
+  }
+
+  liong::util::save_text(path, "hello");
+  L_ASSERT(liong::util::load_text(path) == "hello");
+  liong::util::save_file(path, nullptr, 0);
+  L_ASSERT(liong::util::load_file(path).empty());
+  std::remove(path);
+
+  // Missing files are reported in release builds as well.
+  bool has_thrown = false;
+  try {
+    liong::util::load_file(path);
+  } catch (const liong::AssertionFailedException&) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+}
+
+L_TEST(MappedFileStream) {
+  const char* path = "MappedFileStream.bin";
+  std::vector<uint32_t> data(10000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (uint32_t)(i * 2654435761u);
+  }
+  liong::util::save_file(path, data.data(), data.size() * sizeof(uint32_t));
+
+  {
+    liong::util::MappedFile mapped_file(path,
+      liong::util::L_MAPPED_FILE_ACCESS_HINT_SEQUENTIAL);
+    L_ASSERT(mapped_file.size() == data.size() * sizeof(uint32_t));
+    // Unaligned ranges are fine.
+    mapped_file.advise(liong::util::L_MAPPED_FILE_ACCESS_HINT_RANDOM,
+      123, 4567);
+    mapped_file.advise(liong::util::L_MAPPED_FILE_ACCESS_HINT_WILL_NEED);
+
+    liong::stream::ReadStream stream = mapped_file.as_stream();
+    L_ASSERT(stream.extract_all<uint32_t>() == data);
+  }
+
+  std::remove(path);
+
+  // Missing files are reported in release builds as well.
+  bool has_thrown = false;
+  try {
+    liong::util::MappedFile mapped_file(path);
+  } catch (const liong::AssertionFailedException&) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+}
+
+L_TEST(AsyncIo) {
+  const char* path = "AsyncIo.bin";
+  std::vector<uint8_t> data(256 * 1024 + 123);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (uint8_t)(i * 31 + (i >> 8));
+  }
+
+  for (bool use_io_uring : { true, false }) {
+    // Outlive `aio` which waits for the requests in flight.
+    std::vector<uint8_t> buf(data.size());
+    std::atomic<size_t> ndone { 0 };
+
+    liong::util::AsyncIoConfig cfg {};
+    cfg.use_io_uring = use_io_uring;
+    cfg.queue_depth = 4;
+    liong::util::AsyncIo aio(cfg);
+    L_INFO("io_uring: ", aio.is_io_uring());
+
+    aio.save_file(path, data.data(), data.size()).get();
+    L_ASSERT(aio.load_file(path).get() == data);
+
+    // More requests than the queue depth, completed out of order.
+    const size_t CHUNK_SIZE = 4096;
+    size_t nchunk = liong::util::div_up(data.size(), CHUNK_SIZE);
+    std::atomic<int64_t> ntransferred { 0 };
+    for (size_t i = 0; i < nchunk; ++i) {
+      size_t offset = i * CHUNK_SIZE;
+      size_t size = std::min(CHUNK_SIZE, data.size() - offset);
+      aio.read(path, buf.data() + offset, size, offset, [&](int64_t res) {
+        ntransferred += res;
+        ++ndone;
+      });
+    }
+    while (ndone < nchunk) { std::this_thread::yield(); }
+    L_ASSERT(ntransferred == (int64_t)data.size());
+    L_ASSERT(buf == data);
+
+    // Callbacks submitting more requests than the queue depth.
+    std::fill(buf.begin(), buf.end(), 0);
+    ndone = 0;
+    ntransferred = 0;
+    aio.read(path, buf.data(), 1, 0, [&](int64_t res) {
+      ntransferred += res;
+      for (size_t i = 0; i < nchunk; ++i) {
+        size_t offset = i * CHUNK_SIZE;
+        size_t size = std::min(CHUNK_SIZE, data.size() - offset);
+        aio.read(path, buf.data() + offset, size, offset, [&](int64_t res) {
+          ntransferred += res;
+          ++ndone;
+        });
+      }
+    });
+    while (ndone < nchunk) { std::this_thread::yield(); }
+    L_ASSERT(ntransferred == (int64_t)data.size() + 1);
+    L_ASSERT(buf == data);
+
+    // Reads beyond the end of file are short.
+    L_ASSERT(aio.read(path, buf.data(), 1000, data.size() - 100).get() == 100);
+    L_ASSERT(aio.read(path, buf.data(), 1000, data.size() + 100).get() == 0);
+
+    // Writes keep the rest of the file.
+    const uint8_t patch[] = { 1, 2, 3, 4 };
+    L_ASSERT(aio.write(path, patch, sizeof(patch), 10).get() == 4);
+    std::vector<uint8_t> expected = data;
+    std::memcpy(expected.data() + 10, patch, sizeof(patch));
+    L_ASSERT(liong::util::load_file(path) == expected);
+
+    L_ASSERT(aio.read("AsyncIo.missing", buf.data(), 1, 0).get() < 0);
+    bool has_thrown = false;
+    try {
+      aio.load_file("AsyncIo.missing").get();
+    } catch (const liong::AssertionFailedException&) {
+      has_thrown = true;
+    }
+    L_ASSERT(has_thrown);
+
+    // Requests in flight complete before the queue is destroyed.
+    aio.read(path, buf.data(), 16, 0, [&](int64_t res) { ndone = res; });
+  }
+  std::remove(path);
+}
+
+L_TEST(SaveBmp) {
+  const uint32_t W = 7;
+  const uint32_t H = 5;
+  std::vector<float> pxs(W * H * 4);
+  for (size_t i = 0; i < pxs.size(); ++i) {
+    pxs[i] = (float)(i % 61) / 50.0f - 0.1f;
+  }
+  pxs[5] = std::numeric_limits<float>::quiet_NaN();
+
+  std::vector<uint32_t> packed(W * H);
+  liong::util::pack_rgba8(pxs.data(), packed.size(), packed.data());
+  for (size_t i = 0; i < packed.size(); ++i) {
+    for (size_t j = 0; j < 4; ++j) {
+      float x = pxs[i * 4 + j];
+      uint32_t expected = x > 0.0f ? (uint32_t)(std::min(x, 1.0f) * 255.0f) : 0;
+      L_ASSERT(((packed[i] >> (j * 8)) & 0xFF) == expected);
+    }
+  }
+
+  std::vector<uint8_t> bmp = liong::util::encode_bmp(packed.data(), W, H);
+  L_ASSERT(bmp.size() == 14 + 108 + W * H * 4);
+  L_ASSERT(bmp[0] == 'B' && bmp[1] == 'M');
+  uint32_t offset;
+  std::memcpy(&offset, bmp.data() + 10, sizeof(offset));
+  L_ASSERT(offset == 14 + 108);
+  // Rows are stored bottom-up.
+  for (uint32_t i = 0; i < H; ++i) {
+    L_ASSERT(std::memcmp(bmp.data() + offset + i * W * 4,
+      packed.data() + (H - i - 1) * W, W * 4) == 0);
+  }
+  L_ASSERT(liong::util::encode_bmp(pxs.data(), W, H) == bmp);
+
+  const char* path = "SaveBmp.bmp";
+  liong::util::save_bmp(pxs.data(), W, H, path);
+  L_ASSERT(liong::util::load_file(path) == bmp);
+  std::remove(path);
+
+  // Frames are copied so the pixels can be overwritten right away.
+  {
+    liong::util::AsyncBmpWriterConfig cfg {};
+    cfg.max_nframe_in_flight = 2;
+    liong::util::AsyncBmpWriter writer(cfg);
+    for (uint32_t i = 0; i < 5; ++i) {
+      packed[0] = i;
+      writer.save_bmp(packed.data(), W, H,
+        liong::util::format("SaveBmp", i, ".bmp").c_str());
+    }
+    writer.wait();
+  }
+  for (uint32_t i = 0; i < 5; ++i) {
+    std::string path = liong::util::format("SaveBmp", i, ".bmp");
+    packed[0] = i;
+    L_ASSERT(liong::util::load_file(path.c_str()) ==
+      liong::util::encode_bmp(packed.data(), W, H));
+    std::remove(path.c_str());
+  }
+}
+
+L_BENCH(SaveBmpThroughput) {
+  const uint32_t W = 3840;
+  const uint32_t H = 2160;
+  std::vector<float> pxs(W * H * 4);
+  for (size_t i = 0; i < pxs.size(); ++i) {
+    pxs[i] = (float)(uint8_t)(i * 2654435761u >> 24) / 255.0f;
+  }
+  std::vector<uint32_t> packed(W * H);
+  liong::util::pack_rgba8(pxs.data(), packed.size(), packed.data());
+
+  // The previous implementation, writing one pixel at a time.
+  auto save_bmp_per_pixel = [&](const uint32_t* pxs, const char* path) {
+    std::fstream f(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    f.write("BM", 2);
+    uint32_t img_size = W * H * sizeof(uint32_t);
+    uint32_t bmfile_hdr[] = { 14 + 108 + img_size, 0, 14 + 108 };
+    f.write((const char*)bmfile_hdr, sizeof(bmfile_hdr));
+    uint32_t bmcore_hdr[] = {
+      108, W, H, 1 | (32 << 16), 3, img_size, 2835, 2835, 0, 0,
+      0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000, 0x57696E20,
+      0,0,0,0,0,0,0,0,0,0,0,0,
+    };
+    f.write((const char*)bmcore_hdr, sizeof(bmcore_hdr));
+    for (uint32_t i = 0; i < H; ++i) {
+      for (uint32_t j = 0; j < W; ++j) {
+        uint32_t buf = pxs[(H - i - 1) * W + j];
+        f.write((const char*)&buf, sizeof(uint32_t));
+      }
+    }
+  };
+  auto save_bmp_float_per_pixel = [&](const char* path) {
+    std::vector<uint32_t> packed_pxs(W * H * 4);
+    for (size_t i = 0; i < W * H; ++i) {
+      uint32_t r = (uint32_t)(pxs[i * 4 + 0] * 255.0f);
+      uint32_t g = (uint32_t)(pxs[i * 4 + 1] * 255.0f);
+      uint32_t b = (uint32_t)(pxs[i * 4 + 2] * 255.0f);
+      uint32_t a = (uint32_t)(pxs[i * 4 + 3] * 255.0f);
+      packed_pxs[i] = (r << 0) | (g << 8) | (b << 16) | (a << 24);
+    }
+    save_bmp_per_pixel(packed_pxs.data(), path);
+  };
+
+  const char* path = "SaveBmpThroughput.bmp";
+  auto bench = [&](const char* name, const std::function<void()>& f) {
+    L_INFO(name, ": ", liong::test::bench_us(3, f) / 1000.0, "ms");
+  };
+  bench("save_bmp per pixel", [&]() {
+    save_bmp_per_pixel(packed.data(), path);
+  });
+  bench("save_bmp", [&]() {
+    liong::util::save_bmp(packed.data(), W, H, path);
+  });
+  bench("save_bmp of floats per pixel", [&]() {
+    save_bmp_float_per_pixel(path);
+  });
+  bench("save_bmp of floats", [&]() {
+    liong::util::save_bmp(pxs.data(), W, H, path);
+  });
+  bench("pack_rgba8", [&]() {
+    liong::util::pack_rgba8(pxs.data(), packed.size(), packed.data());
+  });
+  L_ASSERT(liong::util::load_file(path) ==
+    liong::util::encode_bmp(packed.data(), W, H));
+  std::remove(path);
+
+  // Time spent on the calling thread per frame when dumping a sequence.
+  const size_t NFRAME = 8;
+  {
+    liong::util::Timer timer {};
+    liong::util::AsyncBmpWriter writer {};
+    double total_us = 0.0;
+    for (size_t i = 0; i < NFRAME; ++i) {
+      timer.tic();
+      writer.save_bmp(pxs.data(), W, H,
+        liong::util::format("SaveBmpThroughput", i, ".bmp").c_str());
+      timer.toc();
+      total_us += timer.us();
+    }
+    timer.tic();
+    writer.wait();
+    timer.toc();
+    L_INFO("AsyncBmpWriter: ", total_us / NFRAME / 1000.0, "ms per frame, ",
+      timer.us() / 1000.0, "ms to drain");
+  }
+  for (size_t i = 0; i < NFRAME; ++i) {
+    std::remove(liong::util::format("SaveBmpThroughput", i, ".bmp").c_str());
+  }
+}
+
+L_TEST(Qoi) {
+  // One of each kind of op, checked against the format specification.
+  const uint32_t pxs[] = { 0xFF000000, 0xFF000000, 0xFF000001, 0x800000FF };
+  const std::vector<uint8_t> expected = {
+    'q', 'o', 'i', 'f', 0, 0, 0, 2, 0, 0, 0, 2, 4, 0,
+    0xC1, // Run of 2 of the initial color.
+    0x7A, // Difference of (+1, 0, 0).
+    0xFF, 0xFF, 0x00, 0x00, 0x80, // RGBA.
+    0, 0, 0, 0, 0, 0, 0, 1,
+  };
+  std::vector<uint8_t> qoi = liong::util::encode_qoi(pxs, 2, 2);
+  L_ASSERT(qoi == expected);
+  liong::util::Rgba8Image img {};
+  L_ASSERT(liong::util::decode_qoi(qoi.data(), qoi.size(), img));
+  L_ASSERT(img.width == 2 && img.height == 2);
+  L_ASSERT(img.pxs == std::vector<uint32_t>(pxs, pxs + 4));
+
+  // Gradients, flat areas longer than a run, repeated colors and random
+  // noise with alpha.
+  const uint32_t W = 97;
+  const uint32_t H = 31;
+  std::vector<uint32_t> pxs2(W * H);
+  uint32_t seed = 1;
+  for (uint32_t i = 0; i < H; ++i) {
+    for (uint32_t j = 0; j < W; ++j) {
+      uint32_t px;
+      if (i < 8) {
+        px = 0xFF000000 | (j * 3) | ((i * 5 + j) << 8) | ((j * 7 / 3) << 16);
+      } else if (i < 16) {
+        px = 0xFF336699;
+      } else if (i < 24) {
+        px = (j % 3 == 0) ? 0xFF0000FF : (j % 3 == 1) ? 0x80FF0000 : 0;
+      } else {
+        seed = seed * 1103515245 + 12345;
+        px = seed;
+      }
+      pxs2[i * W + j] = px;
+    }
+  }
+  qoi = liong::util::encode_qoi(pxs2.data(), W, H);
+  L_ASSERT(liong::util::decode_qoi(qoi.data(), qoi.size(), img));
+  L_ASSERT(img.width == W && img.height == H);
+  L_ASSERT(img.pxs == pxs2);
+
+  std::vector<float> pxs3(W * H * 4);
+  for (size_t i = 0; i < pxs3.size(); ++i) {
+    pxs3[i] = (float)(i % 67) / 60.0f;
+  }
+  std::vector<uint32_t> packed(W * H);
+  liong::util::pack_rgba8(pxs3.data(), packed.size(), packed.data());
+  L_ASSERT(liong::util::encode_qoi(pxs3.data(), W, H) ==
+    liong::util::encode_qoi(packed.data(), W, H));
+
+  const char* path = "Qoi.qoi";
+  liong::util::save_qoi(pxs2.data(), W, H, path);
+  img = liong::util::load_qoi(path);
+  L_ASSERT(img.pxs == pxs2);
+  std::remove(path);
+
+  // Malformed images.
+  L_ASSERT(!liong::util::decode_qoi(qoi.data(), qoi.size() / 2, img));
+  qoi[0] = 'x';
+  L_ASSERT(!liong::util::decode_qoi(qoi.data(), qoi.size(), img));
+}
+
+L_BENCH(QoiThroughput) {
+  // A shaded scene of flat background, smooth gradients and a noisy region,
+  // as in rendered frames.
+  const uint32_t W = 3840;
+  const uint32_t H = 2160;
+  std::vector<uint32_t> pxs(W * H);
+  uint32_t seed = 1;
+  for (uint32_t i = 0; i < H; ++i) {
+    for (uint32_t j = 0; j < W; ++j) {
+      uint32_t px = 0xFF402010;
+      float dx = (float)j - W / 2.0f;
+      float dy = (float)i - H / 2.0f;
+      float r2 = (dx * dx + dy * dy) / (H * H / 4.0f);
+      if (r2 < 1.0f) {
+        uint32_t shade = (uint32_t)((1.0f - r2) * 255.0f);
+        px = 0xFF000000 | shade | ((shade * 3 / 4) << 8) | ((shade / 2) << 16);
+        if (dx > 0.0f && dy > 0.0f) {
+          seed = seed * 1103515245 + 12345;
+          px ^= (seed >> 16) & 0x070707;
+        }
+      }
+      pxs[i * W + j] = px;
+    }
+  }
+
+  auto bench = [&](const char* name, size_t size, const std::function<void()>& f) {
+    double best_us = liong::test::bench_us(3, f);
+    L_INFO(name, ": ", best_us / 1000.0, "ms (", size / best_us, "MB/s)");
+  };
+  std::vector<uint8_t> bmp;
+  std::vector<uint8_t> qoi;
+  liong::util::Rgba8Image img {};
+  bench("encode_bmp", W * H * 4, [&]() {
+    bmp = liong::util::encode_bmp(pxs.data(), W, H);
+  });
+  bench("encode_qoi", W * H * 4, [&]() {
+    qoi = liong::util::encode_qoi(pxs.data(), W, H);
+  });
+  bench("decode_qoi", W * H * 4, [&]() {
+    L_ASSERT(liong::util::decode_qoi(qoi.data(), qoi.size(), img));
+  });
+  L_ASSERT(img.pxs == pxs);
+  L_INFO("bmp ", bmp.size(), " bytes, qoi ", qoi.size(), " bytes (",
+    (double)bmp.size() / qoi.size(), "x smaller)");
+}
+
+#if !defined(_WIN32)
+L_BENCH(LoadFileThroughput) {
+  const char* path = "LoadFileThroughput.bin";
+  const size_t SIZE = 128 * 1024 * 1024;
+  {
+    std::vector<uint8_t> data(SIZE);
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = (uint8_t)(i * 2654435761u >> 24);
+    }
+    liong::util::save_file(path, data.data(), data.size());
+  }
+
+  // Evict the file from the page cache for cold reads.
+  auto drop_cache = [&]() {
+    int fd = ::open(path, O_RDONLY);
+    L_ASSERT(fd >= 0);
+    ::fdatasync(fd);
+    ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    ::close(fd);
+  };
+  // The previous implementation.
+  auto load_file_ifstream = [&]() {
+    std::ifstream f(path, std::ios::ate | std::ios::binary | std::ios::in);
+    size_t size = f.tellg();
+    f.seekg(std::ios::beg);
+    std::vector<uint8_t> buf;
+    buf.resize(size);
+    f.read((char*)buf.data(), size);
+    return buf;
+  };
+
+  const size_t ALIGNMENT = 4096;
+  std::unique_ptr<uint8_t[]> buf(new uint8_t[SIZE + ALIGNMENT]);
+  uint8_t* aligned = (uint8_t*)liong::util::align_up(
+    (size_t)(uintptr_t)buf.get(), ALIGNMENT);
+
+  liong::util::LoadFileConfig parallel_cfg {};
+  parallel_cfg.thread_pool = &liong::util::ThreadPool::global();
+  liong::util::LoadFileConfig direct_cfg {};
+  direct_cfg.direct_io = true;
+
+  auto bench = [&](const char* name, const std::function<void()>& f) {
+    drop_cache();
+    double cold_us = liong::test::bench_us(1, f);
+    double warm_us = liong::test::bench_us(3, f);
+    L_INFO(name, ": cold ", SIZE / cold_us, "MB/s, warm ", SIZE / warm_us,
+      "MB/s");
+  };
+  bench("ifstream into vector", [&]() {
+    L_ASSERT(load_file_ifstream().size() == SIZE);
+  });
+  bench("load_file into vector", [&]() {
+    L_ASSERT(liong::util::load_file(path).size() == SIZE);
+  });
+  bench("load_file into buffer", [&]() {
+    L_ASSERT(liong::util::load_file(path, aligned, SIZE, {}) == SIZE);
+  });
+  bench("load_file into buffer in parallel", [&]() {
+    L_ASSERT(liong::util::load_file(path, aligned, SIZE, parallel_cfg) ==
+      SIZE);
+  });
+  bench("load_file into buffer with direct I/O", [&]() {
+    L_ASSERT(liong::util::load_file(path, aligned, SIZE, direct_cfg) == SIZE);
+  });
+  L_ASSERT(liong::util::crc32(aligned, SIZE) ==
+    liong::util::crc32(load_file_ifstream().data(), SIZE));
+
+  std::remove(path);
+}
+
+L_BENCH(AsyncIoThroughput) {
+  const size_t NFILE = 16;
+  const size_t SIZE = 4 * 1024 * 1024;
+  std::vector<std::string> paths;
+  {
+    std::vector<uint8_t> data(SIZE);
+    for (size_t i = 0; i < NFILE; ++i) {
+      for (size_t j = 0; j < data.size(); ++j) {
+        data[j] = (uint8_t)((i + j) * 2654435761u >> 24);
+      }
+      paths.emplace_back(liong::util::format("AsyncIoThroughput", i, ".bin"));
+      liong::util::save_file(paths.back().c_str(), data.data(), data.size());
+    }
+  }
+
+  auto drop_cache = [&]() {
+    for (const std::string& path : paths) {
+      int fd = ::open(path.c_str(), O_RDONLY);
+      L_ASSERT(fd >= 0);
+      ::fdatasync(fd);
+      ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+      ::close(fd);
+    }
+  };
+  // Each file is loaded and then checksummed, as a stand-in for parsing.
+  std::vector<uint32_t> crcs(NFILE);
+  auto load_sequential = [&]() {
+    for (size_t i = 0; i < NFILE; ++i) {
+      std::vector<uint8_t> buf = liong::util::load_file(paths[i].c_str());
+      crcs[i] = liong::util::crc32(buf.data(), buf.size());
+    }
+  };
+  auto load_async = [&](liong::util::AsyncIo& aio) {
+    std::vector<std::future<std::vector<uint8_t>>> futures;
+    for (const std::string& path : paths) {
+      futures.emplace_back(aio.load_file(path.c_str()));
+    }
+    for (size_t i = 0; i < NFILE; ++i) {
+      std::vector<uint8_t> buf = futures[i].get();
+      L_ASSERT(liong::util::crc32(buf.data(), buf.size()) == crcs[i]);
+    }
+  };
+
+  liong::util::AsyncIo io_uring_aio {};
+  liong::util::AsyncIoConfig thread_pool_cfg {};
+  thread_pool_cfg.use_io_uring = false;
+  liong::util::AsyncIo thread_pool_aio(thread_pool_cfg);
+
+  auto bench = [&](const char* name, const std::function<void()>& f) {
+    drop_cache();
+    double cold_us = liong::test::bench_us(1, f);
+    double warm_us = liong::test::bench_us(3, f);
+    L_INFO(name, ": cold ", NFILE * SIZE / cold_us, "MB/s, warm ",
+      NFILE * SIZE / warm_us, "MB/s");
+  };
+  bench("load_file sequentially", load_sequential);
+  bench(io_uring_aio.is_io_uring() ? "AsyncIo with io_uring" :
+    "AsyncIo without io_uring", [&]() { load_async(io_uring_aio); });
+  bench("AsyncIo with threads", [&]() { load_async(thread_pool_aio); });
+
+  for (const std::string& path : paths) {
+    std::remove(path.c_str());
+  }
+}
+#endif // !defined(_WIN32)
@@ -1,5 +1,12 @@
+#include <cstdio>
+#include <limits>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#endif // !defined(_WIN32)
 #include "gft/assert.hpp"
 #include "gft/log.hpp"
+#include "gft/stream.hpp"
 #include "gft/test.hpp"
 #include "gft/util.hpp"
 #include "gft/zip.hpp"
@@ -31,6 +38,12 @@ L_TEST(ZipMinimalFile) {
   };
   zip::ZipArchive ar = zip::ZipArchive::from_bytes(min_zip);
   L_ASSERT(ar.records.size() == 0);
+
+  zip::ZipParseConfig cfg {};
+  cfg.central_directory_only = true;
+  zip::ZipArchive ar2 = zip::ZipArchive::from_bytes(
+    min_zip.data(), min_zip.size(), cfg);
+  L_ASSERT(ar2.records.size() == 0);
 }
 
 L_TEST(ZipExtractReal) {
@@ -89,4 +102,529 @@ L_TEST(ZipExtractReal) {
     L_ASSERT(s == "123");
     L_ASSERT(record.crc32 == 0x884863d2);
   }
+
+  zip::ZipParseConfig cfg {};
+  cfg.central_directory_only = true;
+  zip::ZipArchive ar2 = zip::ZipArchive::from_bytes(
+    real_zip.data(), real_zip.size(), cfg);
+  L_ASSERT(ar2.records.size() == 3);
+  for (const zip::ZipFileRecord& record : ar2.records) {
+    L_ASSERT(!record.is_validated);
+    L_ASSERT(record.data == nullptr);
+  }
+  {
+    const zip::ZipFileRecord& record = ar2.get_file("_3");
+    L_ASSERT(record.is_validated);
+    L_ASSERT(record.data == ar.get_file("_3").data);
+    L_ASSERT(record.crc32 == 0x884863d2);
+  }
+  L_ASSERT(ar2.validate_record(ar2.file_name2irecord.at("_1")));
+  L_ASSERT(ar2.records.at(ar2.file_name2irecord.at("_1")).data != nullptr);
+  L_ASSERT(!ar2.records.at(ar2.file_name2irecord.at("_2")).is_validated);
+
+  // Records not validated yet can't be accessed through a const archive, but
+  // the archive can still be serialized.
+  const zip::ZipArchive& const_ar2 = ar2;
+  bool has_thrown = false;
+  try {
+    const_ar2.get_file("_2");
+  } catch (const AssertionFailedException&) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+  std::vector<uint8_t> bytes;
+  const_ar2.to_bytes(bytes);
+  zip::ZipArchive ar3 = zip::ZipArchive::from_bytes(bytes);
+  L_ASSERT(ar3.get_file("_2").size == 0);
+  L_ASSERT(ar3.get_file("_3").size == 3);
+
+  // Corrupted local file headers are reported on first access.
+  std::vector<uint8_t> corrupted_zip = real_zip;
+  size_t irecord = ar2.file_name2irecord.at("_2");
+  corrupted_zip[ar2.records[irecord].local_header_offset] = 0;
+  zip::ZipArchive ar4 = zip::ZipArchive::from_bytes(
+    corrupted_zip.data(), corrupted_zip.size(), cfg);
+  L_ASSERT(!ar4.validate_record(irecord));
+  std::vector<uint8_t> out;
+  L_ASSERT(!ar4.extract(irecord, out));
+  has_thrown = false;
+  try {
+    ar4.get_file("_2");
+  } catch (const AssertionFailedException&) {
+    has_thrown = true;
+  }
+  L_ASSERT(has_thrown);
+  L_ASSERT(ar4.get_file("_1").size == 1);
+}
+
+L_TEST(ZipExtractDeflate) {
+  // "hello" in a single stored deflate block.
+  std::vector<uint8_t> deflated {
+    0x01, 0x05, 0x00, 0xFA, 0xFF, 'h', 'e', 'l', 'l', 'o',
+  };
+  std::vector<uint8_t> stored { 'w', 'o', 'r', 'l', 'd' };
+
+  zip::ZipArchive ar {};
+  ar.add_file("stored", stored.data(), stored.size());
+  {
+    zip::ZipFileRecord record {};
+    record.file_name = "deflated";
+    record.data = nullptr;
+    record.size = 5;
+    record.crc32 = util::crc32("hello", 5);
+    record.compression_method = zip::L_ZIP_COMPRESSION_METHOD_DEFLATE;
+    record.compressed_data = deflated.data();
+    record.compressed_size = deflated.size();
+    record.is_validated = true;
+    ar.file_name2irecord["deflated"] = ar.records.size();
+    ar.records.emplace_back(std::move(record));
+  }
+  std::vector<uint8_t> bytes;
+  ar.to_bytes(bytes);
+
+  zip::ZipParseConfig cfg {};
+  cfg.central_directory_only = true;
+  zip::ZipArchive ar2 = zip::ZipArchive::from_bytes(bytes);
+  zip::ZipArchive ar3 = zip::ZipArchive::from_bytes(
+    bytes.data(), bytes.size(), cfg);
+  for (zip::ZipArchive* ar : { &ar2, &ar3 }) {
+    L_ASSERT(ar->records.size() == 2);
+    std::vector<uint8_t> out;
+    L_ASSERT(ar->extract_file("deflated", out));
+    L_ASSERT(std::string(out.begin(), out.end()) == "hello");
+    const zip::ZipFileRecord& record = ar->get_file("deflated");
+    L_ASSERT(record.data == nullptr);
+    L_ASSERT(record.size == 5);
+    L_ASSERT(record.compressed_size == deflated.size());
+    L_ASSERT(std::memcmp(record.compressed_data, deflated.data(),
+      deflated.size()) == 0);
+    L_ASSERT(ar->get_file("stored").data ==
+      ar->get_file("stored").compressed_data);
+    L_ASSERT(ar->extract_file("stored", out));
+    L_ASSERT(out == stored);
+  }
+
+  // Corrupted data fails the crc32 check.
+  ar2.records.at(ar2.file_name2irecord.at("deflated")).crc32 ^= 1;
+  std::vector<uint8_t> out;
+  L_ASSERT(!ar2.extract_file("deflated", out));
+}
+
+L_TEST(ZipWriteDeflate) {
+  std::string text;
+  for (size_t i = 0; i < 1000; ++i) {
+    text += "line " + std::to_string(i % 37) + " of some text\n";
+  }
+  std::vector<uint8_t> noise(10000);
+  uint32_t x = 1;
+  for (uint8_t& c : noise) {
+    x = x * 1664525 + 1013904223;
+    c = (uint8_t)(x >> 24);
+  }
+
+  zip::ZipArchive ar {};
+  ar.add_file("text", text.data(), text.size());
+  ar.add_file("noise", noise.data(), noise.size());
+  ar.add_file("empty", nullptr, 0);
+
+  util::ThreadPool thread_pool(4);
+  zip::ZipWriteConfig cfg {};
+  cfg.level = 6;
+  cfg.thread_pool = &thread_pool;
+  std::vector<uint8_t> bytes;
+  ar.to_bytes(bytes, cfg);
+  L_ASSERT(bytes.size() < text.size());
+
+  zip::ZipArchive ar2 = zip::ZipArchive::from_bytes(bytes);
+  const zip::ZipFileRecord& text_record = ar2.get_file("text");
+  L_ASSERT(text_record.compression_method ==
+    zip::L_ZIP_COMPRESSION_METHOD_DEFLATE);
+  L_ASSERT(text_record.compressed_size < text.size() / 4);
+  // Incompressible data is left stored.
+  L_ASSERT(ar2.get_file("noise").compression_method ==
+    zip::L_ZIP_COMPRESSION_METHOD_STORE);
+
+  std::vector<uint8_t> out;
+  L_ASSERT(ar2.extract_file("text", out));
+  L_ASSERT(std::string(out.begin(), out.end()) == text);
+  L_ASSERT(ar2.extract_file("noise", out));
+  L_ASSERT(out == noise);
+  L_ASSERT(ar2.extract_file("empty", out));
+  L_ASSERT(out.empty());
+
+  // Compressed records are copied as is.
+  std::vector<uint8_t> bytes2;
+  ar2.to_bytes(bytes2, cfg);
+  L_ASSERT(bytes2 == bytes);
+}
+
+L_BENCH(ZipWriteDeflateThroughput) {
+  const size_t NFILE = 32;
+  std::vector<std::string> texts(NFILE);
+  zip::ZipArchive ar {};
+  size_t total_size = 0;
+  for (size_t i = 0; i < NFILE; ++i) {
+    for (size_t j = 0; texts[i].size() < 256 * 1024; ++j) {
+      texts[i] += std::to_string(i) + ": line " + std::to_string(j * j % 1009) +
+        " of some text\n";
+    }
+    total_size += texts[i].size();
+    ar.add_file("file" + std::to_string(i), texts[i].data(), texts[i].size());
+  }
+
+  util::ThreadPool single_thread_pool(1);
+  for (util::ThreadPool* thread_pool :
+    { &single_thread_pool, &util::ThreadPool::global() })
+  {
+    zip::ZipWriteConfig cfg {};
+    cfg.level = 6;
+    cfg.thread_pool = thread_pool;
+    std::vector<uint8_t> bytes;
+    double best_us = test::bench_us(3, [&]() {
+      ar.to_bytes(bytes, cfg);
+    });
+    L_INFO(thread_pool->nthread(), " thread(s): ", total_size, " -> ",
+      bytes.size(), " bytes in ", best_us, "us (", total_size / best_us,
+      " MB/s)");
+  }
+}
+
+L_TEST(ZipOpenMmap) {
+  std::vector<uint8_t> data(1000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (uint8_t)(i * 7);
+  }
+  zip::ZipArchive ar {};
+  ar.add_file("a.bin", data.data(), data.size());
+  ar.add_file("b/empty", nullptr, 0);
+  std::vector<uint8_t> bytes;
+  ar.to_bytes(bytes);
+
+  const char* path = "ZipOpenMmap.zip";
+  util::save_file(path, bytes.data(), bytes.size());
+  zip::ZipArchive ar2 = zip::ZipArchive::open_mmap(path);
+
+  // The mapping outlives the original archive object.
+  zip::ZipArchive ar3 = ar2;
+  ar2 = {};
+  L_ASSERT(ar3.records.size() == 2);
+  const zip::ZipFileRecord& record = ar3.get_file("a.bin");
+  L_ASSERT(record.size == data.size());
+  L_ASSERT(std::memcmp(record.data, data.data(), data.size()) == 0);
+  L_ASSERT(record.crc32 == util::crc32(data.data(), data.size()));
+  L_ASSERT(ar3.get_file("b/empty").size == 0);
+
+  ar3 = {};
+  std::remove(path);
+}
+
+L_TEST(ZipOpenManyEntries) {
+  // More than 65535 entries are only counted in the Zip64 end of central
+  // directory record.
+  const size_t NFILE = 70000;
+  std::vector<std::string> file_names(NFILE);
+  zip::ZipArchive ar {};
+  uint32_t content = 0x12345678;
+  for (size_t i = 0; i < NFILE; ++i) {
+    file_names[i] = "dir/" + std::to_string(i) + ".bin";
+    ar.add_file(file_names[i], &content, sizeof(content));
+  }
+  std::vector<uint8_t> bytes;
+  ar.to_bytes(bytes);
+
+  zip::ZipParseConfig cfg {};
+  cfg.central_directory_only = true;
+
+  zip::ZipArchive ar2 {};
+  double seq_us = test::bench_us(1, [&]() {
+    ar2 = zip::ZipArchive::from_bytes(bytes);
+  });
+  zip::ZipArchive ar3 {};
+  double cd_us = test::bench_us(1, [&]() {
+    ar3 = zip::ZipArchive::from_bytes(bytes.data(), bytes.size(), cfg);
+  });
+  L_ASSERT(ar2.records.size() == NFILE);
+  L_ASSERT(ar3.records.size() == NFILE);
+  L_ASSERT(ar3.get_file(file_names[NFILE / 2]).data ==
+    ar2.get_file(file_names[NFILE / 2]).data);
+  L_INFO("opening ", NFILE, " entries: sequential scan ", seq_us,
+    "us, central directory only ", cd_us, "us");
+}
+
+L_TEST(ZipZip64RoundTrip) {
+  std::vector<uint8_t> data(1000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (uint8_t)(i * 13);
+  }
+  zip::ZipArchive ar {};
+  ar.add_file("a.bin", data.data(), data.size());
+  ar.add_file("b/empty", nullptr, 0);
+
+  zip::ZipWriteConfig write_cfg {};
+  write_cfg.force_zip64 = true;
+  for (uint32_t level : { 0, 6 }) {
+    write_cfg.level = level;
+    std::vector<uint8_t> bytes;
+    ar.to_bytes(bytes, write_cfg);
+
+    zip::ZipParseConfig parse_cfg {};
+    for (bool central_directory_only : { false, true }) {
+      parse_cfg.central_directory_only = central_directory_only;
+      zip::ZipArchive ar2 = zip::ZipArchive::from_bytes(
+        bytes.data(), bytes.size(), parse_cfg);
+      L_ASSERT(ar2.records.size() == 2);
+      L_ASSERT(ar2.get_file("a.bin").size == data.size());
+      L_ASSERT(ar2.get_file("b/empty").size == 0);
+      std::vector<uint8_t> extracted;
+      L_ASSERT(ar2.extract_file("a.bin", extracted));
+      L_ASSERT(extracted == data);
+    }
+  }
+}
+
+#if !defined(_WIN32)
+L_TEST(ZipZip64SparseArchive) {
+  // A stored entry over 4GB followed by a small entry beyond 4GB. The large
+  // entry is all zeros left as a hole in a sparse file so it takes no space.
+  const uint64_t BIG_SIZE = (uint64_t(1) << 32) + 16;
+  const std::string BIG_NAME = "big";
+  const std::string SMALL_NAME = "small";
+  const std::string SMALL_DATA = "hello";
+  const uint32_t SMALL_CRC32 =
+    util::crc32(SMALL_DATA.data(), SMALL_DATA.size());
+
+  stream::WriteStream head {};
+  head.append<uint32_t>(0x04034b50);
+  head.append<uint16_t>(45); // min version
+  head.append<uint16_t>(0); // flags
+  head.append<uint16_t>(0); // compression
+  head.append<uint16_t>(0); // last modify time
+  head.append<uint16_t>(0); // last modify date
+  head.append<uint32_t>(0); // crc32, not checked
+  head.append<uint32_t>(0xFFFFFFFF); // compressed size
+  head.append<uint32_t>(0xFFFFFFFF); // uncompressed size
+  head.append<uint16_t>((uint16_t)BIG_NAME.size());
+  head.append<uint16_t>(20); // extra field size
+  head.append_data(BIG_NAME.data(), BIG_NAME.size());
+  head.append<uint16_t>(0x0001); // zip64 extra field
+  head.append<uint16_t>(16);
+  head.append<uint64_t>(BIG_SIZE); // uncompressed size
+  head.append<uint64_t>(BIG_SIZE); // compressed size
+  const uint64_t small_offset = head.size() + BIG_SIZE;
+
+  stream::WriteStream tail {};
+  tail.append<uint32_t>(0x04034b50);
+  tail.append<uint16_t>(0); // min version
+  tail.append<uint16_t>(0); // flags
+  tail.append<uint16_t>(0); // compression
+  tail.append<uint16_t>(0); // last modify time
+  tail.append<uint16_t>(0); // last modify date
+  tail.append<uint32_t>(SMALL_CRC32);
+  tail.append<uint32_t>((uint32_t)SMALL_DATA.size()); // compressed size
+  tail.append<uint32_t>((uint32_t)SMALL_DATA.size()); // uncompressed size
+  tail.append<uint16_t>((uint16_t)SMALL_NAME.size());
+  tail.append<uint16_t>(0); // extra field size
+  tail.append_data(SMALL_NAME.data(), SMALL_NAME.size());
+  tail.append_data(SMALL_DATA.data(), SMALL_DATA.size());
+
+  const uint64_t cdr_offset = small_offset + tail.size();
+  tail.append<uint32_t>(0x02014b50);
+  tail.append<uint16_t>(45); // version
+  tail.append<uint16_t>(45); // min version
+  tail.append<uint16_t>(0); // flags
+  tail.append<uint16_t>(0); // compression
+  tail.append<uint16_t>(0); // last modify time
+  tail.append<uint16_t>(0); // last modify date
+  tail.append<uint32_t>(0); // crc32
+  tail.append<uint32_t>(0xFFFFFFFF); // compressed size
+  tail.append<uint32_t>(0xFFFFFFFF); // uncompressed size
+  tail.append<uint16_t>((uint16_t)BIG_NAME.size());
+  tail.append<uint16_t>(20); // extra field size
+  tail.append<uint16_t>(0); // comment size
+  tail.append<uint16_t>(0); // disk number
+  tail.append<uint16_t>(0); // internal attrs
+  tail.append<uint32_t>(0); // external attrs
+  tail.append<uint32_t>(0); // offset
+  tail.append_data(BIG_NAME.data(), BIG_NAME.size());
+  tail.append<uint16_t>(0x0001); // zip64 extra field
+  tail.append<uint16_t>(16);
+  tail.append<uint64_t>(BIG_SIZE); // uncompressed size
+  tail.append<uint64_t>(BIG_SIZE); // compressed size
+
+  tail.append<uint32_t>(0x02014b50);
+  tail.append<uint16_t>(45); // version
+  tail.append<uint16_t>(45); // min version
+  tail.append<uint16_t>(0); // flags
+  tail.append<uint16_t>(0); // compression
+  tail.append<uint16_t>(0); // last modify time
+  tail.append<uint16_t>(0); // last modify date
+  tail.append<uint32_t>(SMALL_CRC32);
+  tail.append<uint32_t>((uint32_t)SMALL_DATA.size()); // compressed size
+  tail.append<uint32_t>((uint32_t)SMALL_DATA.size()); // uncompressed size
+  tail.append<uint16_t>((uint16_t)SMALL_NAME.size());
+  tail.append<uint16_t>(12); // extra field size
+  tail.append<uint16_t>(0); // comment size
+  tail.append<uint16_t>(0); // disk number
+  tail.append<uint16_t>(0); // internal attrs
+  tail.append<uint32_t>(0); // external attrs
+  tail.append<uint32_t>(0xFFFFFFFF); // offset
+  tail.append_data(SMALL_NAME.data(), SMALL_NAME.size());
+  tail.append<uint16_t>(0x0001); // zip64 extra field
+  tail.append<uint16_t>(8);
+  tail.append<uint64_t>(small_offset); // offset
+
+  const uint64_t zip64_ecdr_offset = small_offset + tail.size();
+  const uint64_t cdr_size = zip64_ecdr_offset - cdr_offset;
+  tail.append<uint32_t>(0x06064b50);
+  tail.append<uint64_t>(44); // size of the remaining record
+  tail.append<uint16_t>(45); // version
+  tail.append<uint16_t>(45); // min version
+  tail.append<uint32_t>(0); // current disk number
+  tail.append<uint32_t>(0); // cdr disk number
+  tail.append<uint64_t>(2); // cdr count on this disk
+  tail.append<uint64_t>(2); // total cdr count
+  tail.append<uint64_t>(cdr_size);
+  tail.append<uint64_t>(cdr_offset);
+
+  tail.append<uint32_t>(0x07064b50);
+  tail.append<uint32_t>(0); // zip64 ecdr disk number
+  tail.append<uint64_t>(zip64_ecdr_offset);
+  tail.append<uint32_t>(1); // total disk count
+
+  tail.append<uint32_t>(0x06054b50);
+  tail.append<uint16_t>(0); // current disk number
+  tail.append<uint16_t>(0); // cdr disk number
+  tail.append<uint16_t>(0xFFFF); // cdr count on this disk
+  tail.append<uint16_t>(0xFFFF); // total cdr count
+  tail.append<uint32_t>(0xFFFFFFFF); // cdr size
+  tail.append<uint32_t>(0xFFFFFFFF); // cdr offset
+  tail.append<uint16_t>(0); // comment size
+
+  const char* path = "ZipZip64SparseArchive.zip";
+  std::vector<uint8_t> head_bytes = head.take();
+  std::vector<uint8_t> tail_bytes = tail.take();
+  int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  L_ASSERT(fd >= 0);
+  L_ASSERT(::pwrite(fd, head_bytes.data(), head_bytes.size(), 0) ==
+    (ssize_t)head_bytes.size());
+  L_ASSERT(::pwrite(fd, tail_bytes.data(), tail_bytes.size(),
+    (off_t)small_offset) == (ssize_t)tail_bytes.size());
+  ::close(fd);
+
+  zip::ZipArchive ar = zip::ZipArchive::open_mmap(path);
+  L_ASSERT(ar.records.size() == 2);
+
+  // Walk through local file headers as well. The hole is skipped over
+  // without being read.
+  zip::ZipArchive ar2 =
+    zip::ZipArchive::from_bytes(ar.archive_data, ar.archive_size);
+  L_ASSERT(ar2.records.size() == 2);
+
+  for (zip::ZipArchive* ar3 : { &ar, &ar2 }) {
+    const zip::ZipFileRecord& big = ar3->get_file(BIG_NAME);
+    L_ASSERT(big.size == BIG_SIZE);
+    L_ASSERT(big.compressed_size == BIG_SIZE);
+    L_ASSERT(big.local_header_offset == 0);
+    L_ASSERT((const uint8_t*)big.data == ar.archive_data + head_bytes.size());
+
+    const zip::ZipFileRecord& small = ar3->get_file(SMALL_NAME);
+    L_ASSERT(small.local_header_offset == small_offset);
+    L_ASSERT(small.size == SMALL_DATA.size());
+    std::vector<uint8_t> extracted;
+    L_ASSERT(ar3->extract_file(SMALL_NAME, extracted));
+    L_ASSERT(std::string(extracted.begin(), extracted.end()) == SMALL_DATA);
+  }
+
+  ar2 = {};
+  ar = {};
+  std::remove(path);
+}
+#endif // !defined(_WIN32)
+
+L_TEST(ZipStreamWriterRoundTrip) {
+  std::vector<uint8_t> data(5000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = (uint8_t)(i % 17);
+  }
+
+  for (uint32_t level : { 0, 6 }) {
+    std::vector<uint8_t> bytes;
+    zip::ZipWriteConfig write_cfg {};
+    write_cfg.level = level;
+    zip::ZipStreamWriter writer([&](const void* data, size_t size) {
+      const uint8_t* beg = (const uint8_t*)data;
+      bytes.insert(bytes.end(), beg, beg + size);
+    }, write_cfg);
+
+    writer.add_file("a.bin", data.data(), data.size());
+    // Streamed in pieces with a data descriptor.
+    writer.begin_file("b.bin");
+    for (size_t i = 0; i < data.size(); i += 1000) {
+      writer.append_file_data(data.data() + i, 1000);
+    }
+    writer.end_file();
+    writer.begin_file("c/empty");
+    writer.end_file();
+    writer.add_file("d.bin", data.data(), 10);
+    writer.finish();
+    L_ASSERT(writer.size() == bytes.size());
+
+    zip::ZipParseConfig parse_cfg {};
+    for (bool central_directory_only : { false, true }) {
+      parse_cfg.central_directory_only = central_directory_only;
+      zip::ZipArchive ar = zip::ZipArchive::from_bytes(
+        bytes.data(), bytes.size(), parse_cfg);
+      L_ASSERT(ar.records.size() == 4);
+
+      std::vector<uint8_t> extracted;
+      L_ASSERT(ar.extract_file("a.bin", extracted));
+      L_ASSERT(extracted == data);
+      L_ASSERT(ar.extract_file("b.bin", extracted));
+      L_ASSERT(extracted == data);
+      L_ASSERT(ar.get_file("b.bin").crc32 ==
+        util::crc32(data.data(), data.size()));
+      L_ASSERT(ar.extract_file("c/empty", extracted));
+      L_ASSERT(extracted.empty());
+      L_ASSERT(ar.extract_file("d.bin", extracted));
+      L_ASSERT(extracted == std::vector<uint8_t>(data.begin(),
+        data.begin() + 10));
+    }
+  }
+}
+
+L_TEST(ZipStreamWriterFile) {
+  // Entries are generated piece by piece and never held in memory as a whole.
+  const size_t NFILE = 16;
+  const size_t NCHUNK = 64;
+  const size_t CHUNK_SIZE = 16 * 1024;
+  const char* path = "ZipStreamWriterFile.zip";
+
+  std::vector<uint32_t> crc32s(NFILE);
+  {
+    zip::ZipStreamWriter writer(path);
+    std::vector<uint8_t> chunk(CHUNK_SIZE);
+    for (size_t i = 0; i < NFILE; ++i) {
+      writer.begin_file(std::to_string(i) + ".bin");
+      for (size_t j = 0; j < NCHUNK; ++j) {
+        for (size_t k = 0; k < CHUNK_SIZE; ++k) {
+          chunk[k] = (uint8_t)(i * 31 + j * 7 + k);
+        }
+        crc32s[i] = util::crc32_update(crc32s[i], chunk.data(), chunk.size());
+        writer.append_file_data(chunk.data(), chunk.size());
+      }
+      writer.end_file();
+    }
+    writer.finish();
+  }
+
+  zip::ZipArchive ar = zip::ZipArchive::open_mmap(path);
+  L_ASSERT(ar.records.size() == NFILE);
+  for (size_t i = 0; i < NFILE; ++i) {
+    const zip::ZipFileRecord& record = ar.get_file(std::to_string(i) + ".bin");
+    L_ASSERT(record.size == NCHUNK * CHUNK_SIZE);
+    L_ASSERT(record.crc32 == crc32s[i]);
+    L_ASSERT(util::crc32(record.data, record.size) == crc32s[i]);
+  }
+  ar = {};
+  std::remove(path);
 }
@@ -22,6 +22,11 @@ public:
   }
 };
 
+// Errors caused by the environment rather than misuse, e.g. missing files, are
+// thrown in all configs.
+#define L_THROW(...) \
+  throw liong::AssertionFailedException(__FILE__, __LINE__, liong::util::format(__VA_ARGS__))
+
 #ifdef NDEBUG
 // Release configs.
 #define L_ASSERT(pred, ...)
@@ -0,0 +1,341 @@
+// CBOR generated ser/de.
+// @PENGUINLIONG
+#pragma once
+#include <cstring>
+#include <memory>
+#include <array>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <type_traits>
+#include <optional>
+#include "gft/cbor.hpp"
+#include "gft/json-serde.hpp"
+
+namespace liong {
+namespace cbor {
+
+namespace detail {
+
+// Element types of contiguous sequences emitted as RFC 8746 typed arrays.
+template<typename T>
+struct IsTypedArrayElem {
+  static constexpr bool value =
+    (std::is_integral<T>::value && !std::is_same<T, bool>::value) ||
+    std::is_same<T, float>::value || std::is_same<T, double>::value;
+};
+
+template<typename T>
+struct CborSerde;
+
+// Arithmetic sequences are emitted as a tagged byte string in host byte order.
+// Other sequences are emitted as arrays of data items.
+template<typename T>
+inline void serialize_seq(CborWriter& w, const T* data, size_t n) {
+  if constexpr (IsTypedArrayElem<T>::value) {
+    w.write_tag(typed_array_tag(
+      sizeof(T), std::is_floating_point<T>::value, std::is_signed<T>::value));
+    w.write_bytes(data, n * sizeof(T));
+  } else {
+    w.write_array_head(n);
+    for (size_t i = 0; i < n; ++i) {
+      CborSerde<T>::serialize(w, data[i]);
+    }
+  }
+}
+// Read the number of elements of a sequence. Data of typed arrays is returned
+// via `typed_data` which is null for arrays of data items.
+template<typename T>
+inline size_t deserialize_seq_head(CborReader& r, const void*& typed_data) {
+  typed_data = nullptr;
+  if constexpr (IsTypedArrayElem<T>::value) {
+    if (r.peek_head().major == L_CBOR_MAJOR_TAG) {
+      uint64_t tag = r.read_tag();
+      uint64_t expected_tag = typed_array_tag(
+        sizeof(T), std::is_floating_point<T>::value, std::is_signed<T>::value);
+      if (tag != expected_tag) {
+        throw CborException("typed array element type mismatched");
+      }
+      std::string_view bytes = r.read_bytes();
+      if (bytes.size() % sizeof(T) != 0) {
+        throw CborException("typed array size is not a multiple of element size");
+      }
+      typed_data = bytes.data();
+      return bytes.size() / sizeof(T);
+    }
+  }
+  return r.read_array_head();
+}
+template<typename T>
+inline void deserialize_seq_elems(
+  CborReader& r,
+  const void* typed_data,
+  T* data,
+  size_t n
+) {
+  if constexpr (IsTypedArrayElem<T>::value) {
+    if (typed_data != nullptr) {
+      if (n > 0) {
+        std::memcpy(data, typed_data, n * sizeof(T));
+      }
+      return;
+    }
+  }
+  for (size_t i = 0; i < n; ++i) {
+    CborSerde<T>::deserialize(r, data[i]);
+  }
+}
+template<typename T>
+inline void deserialize_fixed_seq(CborReader& r, T* data, size_t n) {
+  const void* typed_data;
+  if (deserialize_seq_head<T>(r, typed_data) != n) {
+    throw CborException("fixed-size array length mismatched");
+  }
+  deserialize_seq_elems(r, typed_data, data, n);
+}
+
+template<typename T>
+struct CborSerde {
+  // Numeric and boolean types (integers and floating-point numbers).
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, typename std::enable_if_t<std::is_arithmetic<U>::value, T> x) {
+    if constexpr (std::is_same<U, bool>::value) {
+      w.write_bool(x);
+    } else if constexpr (std::is_same<U, float>::value) {
+      w.write_float(x);
+    } else if constexpr (std::is_floating_point<U>::value) {
+      w.write_double((double)x);
+    } else if constexpr (std::is_signed<U>::value) {
+      w.write_int((int64_t)x);
+    } else {
+      w.write_uint((uint64_t)x);
+    }
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_arithmetic<U>::value, T>& x) {
+    if constexpr (std::is_same<U, bool>::value) {
+      x = r.read_bool();
+    } else if constexpr (std::is_floating_point<U>::value) {
+      x = (T)r.read_double();
+    } else {
+      x = (T)r.read_int();
+    }
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, typename std::enable_if_t<std::is_enum<U>::value, T> x) {
+    w.write_int((int64_t)(typename std::underlying_type<T>::type)x);
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_enum<U>::value, T>& x) {
+    x = (T)(typename std::underlying_type<T>::type)r.read_int();
+  }
+
+  // String type.
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, const typename std::enable_if_t<std::is_same<U, std::string>::value, T>& x) {
+    w.write_text(x);
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_same<U, std::string>::value, T>& x) {
+    x = std::string(r.read_text());
+  }
+
+  // Structure types (annotated with `L_JSON_SERDE_FIELDS`), emitted as maps
+  // from field names to field values.
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, const typename std::enable_if_t<json::detail::HasSerdeFields<U>::value, T>& x) {
+    w.write_map_head(U::json_serde_field_names__().size());
+    json::detail::visit_fields(x, [&](std::string_view name, const auto& field) {
+      typedef std::remove_cv_t<std::remove_reference_t<decltype(field)>> TField;
+      w.write_text(name);
+      CborSerde<TField>::serialize(w, field);
+    });
+  }
+  // Fields absent from the input are left untouched and unknown fields are
+  // skipped.
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<json::detail::HasSerdeFields<U>::value, T>& x) {
+    size_t nfield = r.read_map_head();
+    for (size_t i = 0; i < nfield; ++i) {
+      std::string_view key = r.read_text();
+      bool is_found = false;
+      json::detail::visit_fields(x, [&](std::string_view name, auto& field) {
+        typedef std::remove_cv_t<std::remove_reference_t<decltype(field)>> TField;
+        if (!is_found && name == key) {
+          CborSerde<TField>::deserialize(r, field);
+          is_found = true;
+        }
+      });
+      if (!is_found) {
+        r.skip_value();
+      }
+    }
+  }
+
+  // Key-value pairs, emitted as 2-element arrays.
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, const typename std::enable_if_t<std::is_same<std::pair<typename U::first_type, typename U::second_type>, T>::value, T>& x) {
+    w.write_array_head(2);
+    CborSerde<typename T::first_type>::serialize(w, x.first);
+    CborSerde<typename T::second_type>::serialize(w, x.second);
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_same<std::pair<typename U::first_type, typename U::second_type>, T>::value, T>& x) {
+    if (r.read_array_head() != 2) {
+      throw CborException("key-value pair must have 2 elements");
+    }
+    CborSerde<typename T::first_type>::deserialize(r, x.first);
+    CborSerde<typename T::second_type>::deserialize(r, x.second);
+  }
+
+  // Owned pointer (requires default constructable).
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, const typename std::enable_if_t<std::is_same<std::unique_ptr<typename U::element_type>, T>::value, T>& x) {
+    if (x == nullptr) {
+      w.write_null();
+    } else {
+      CborSerde<typename T::element_type>::serialize(w, *x);
+    }
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_same<std::unique_ptr<typename U::element_type>, T>::value, T>& x) {
+    if (r.try_read_null()) {
+      x = nullptr;
+    } else {
+      x = std::make_unique<typename T::element_type>();
+      CborSerde<typename T::element_type>::deserialize(r, *x);
+    }
+  }
+
+  // Array types (requires default + move constructable).
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, const typename std::enable_if_t<std::is_array<U>::value, T>& x) {
+    serialize_seq(w, x, std::extent<T>::value);
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, const typename std::enable_if_t<std::is_same<std::array<typename U::value_type, std::tuple_size<U>::value>, T>::value, T>& x) {
+    serialize_seq(w, x.data(), x.size());
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, const typename std::enable_if_t<std::is_same<std::vector<typename U::value_type>, T>::value, T>& x) {
+    if constexpr (std::is_same<typename T::value_type, bool>::value) {
+      // `std::vector<bool>` is not contiguous.
+      w.write_array_head(x.size());
+      for (bool xx : x) {
+        w.write_bool(xx);
+      }
+    } else {
+      serialize_seq(w, x.data(), x.size());
+    }
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_array<U>::value, T>& x) {
+    deserialize_fixed_seq(r, x, std::extent<T>::value);
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_same<std::array<typename U::value_type, std::tuple_size<U>::value>, T>::value, T>& x) {
+    deserialize_fixed_seq(r, x.data(), x.size());
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_same<std::vector<typename U::value_type>, T>::value, T>& x) {
+    x.clear();
+    if constexpr (std::is_same<typename T::value_type, bool>::value) {
+      size_t n = r.read_array_head();
+      for (size_t i = 0; i < n; ++i) {
+        x.emplace_back(r.read_bool());
+      }
+    } else {
+      const void* typed_data;
+      size_t n = deserialize_seq_head<typename T::value_type>(r, typed_data);
+      if (typed_data == nullptr && n > r.in.size_remain()) {
+        // Every data item takes at least one byte.
+        throw CborException("unexpected end of data");
+      }
+      x.resize(n);
+      deserialize_seq_elems(r, typed_data, x.data(), n);
+    }
+  }
+
+  // Dictionary types (requires default + move constructable).
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, const typename std::enable_if_t<std::is_same<std::map<typename U::key_type, typename U::mapped_type>, T>::value, T>& x) {
+    w.write_map_head(x.size());
+    for (const auto& xx : x) {
+      CborSerde<typename T::key_type>::serialize(w, xx.first);
+      CborSerde<typename T::mapped_type>::serialize(w, xx.second);
+    }
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, const typename std::enable_if_t<std::is_same<std::unordered_map<typename U::key_type, typename U::mapped_type>, T>::value, T>& x) {
+    w.write_map_head(x.size());
+    for (const auto& xx : x) {
+      CborSerde<typename T::key_type>::serialize(w, xx.first);
+      CborSerde<typename T::mapped_type>::serialize(w, xx.second);
+    }
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_same<std::map<typename U::key_type, typename U::mapped_type>, T>::value, T>& x) {
+    x.clear();
+    size_t n = r.read_map_head();
+    for (size_t i = 0; i < n; ++i) {
+      typename T::key_type key {};
+      typename T::mapped_type value {};
+      CborSerde<typename T::key_type>::deserialize(r, key);
+      CborSerde<typename T::mapped_type>::deserialize(r, value);
+      x.emplace(std::move(key), std::move(value));
+    }
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_same<std::unordered_map<typename U::key_type, typename U::mapped_type>, T>::value, T>& x) {
+    x.clear();
+    size_t n = r.read_map_head();
+    for (size_t i = 0; i < n; ++i) {
+      typename T::key_type key {};
+      typename T::mapped_type value {};
+      CborSerde<typename T::key_type>::deserialize(r, key);
+      CborSerde<typename T::mapped_type>::deserialize(r, value);
+      x.emplace(std::move(key), std::move(value));
+    }
+  }
+
+  // Optional types (requires default + move constructable).
+  template<typename U = typename std::remove_cv<T>::type>
+  static void serialize(CborWriter& w, const typename std::enable_if_t<std::is_same<std::optional<typename U::value_type>, T>::value, T>& x) {
+    if (x.has_value()) {
+      CborSerde<typename T::value_type>::serialize(w, x.value());
+    } else {
+      w.write_null();
+    }
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(CborReader& r, typename std::enable_if_t<std::is_same<std::optional<typename U::value_type>, T>::value, T>& x) {
+    if (r.try_read_null()) {
+      x = std::nullopt;
+    } else {
+      typename T::value_type xx {};
+      CborSerde<typename T::value_type>::deserialize(r, xx);
+      x = std::move(xx);
+    }
+  }
+};
+
+} // namespace detail
+
+// Serialize an object annotated with `L_JSON_SERDE_FIELDS` (or any other type
+// supported by JSON serde) into CBOR.
+template<typename T>
+void serialize(const T& x, stream::WriteStream& out) {
+  CborWriter w(out);
+  detail::CborSerde<T>::serialize(w, x);
+}
+
+// Deserialize an object from CBOR. `CborException` is raised if the data is
+// malformed or doesn't match the type.
+template<typename T>
+void deserialize(stream::ReadStream& in, T& out) {
+  CborReader r(in);
+  detail::CborSerde<T>::deserialize(r, out);
+}
+
+} // namespace cbor
+} // namespace liong
@@ -0,0 +1,115 @@
+// CBOR (RFC 8949) binary encoding.
+// @PENGUINLIONG
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include "gft/stream.hpp"
+
+namespace liong {
+namespace cbor {
+
+// Any error occured during CBOR encoding/decoding.
+class CborException : public std::exception {
+private:
+  std::string msg;
+public:
+  CborException(const char* msg);
+  const char* what() const noexcept override;
+};
+
+// Major type of CBOR data item, the high 3 bits of the initial byte.
+enum CborMajorType {
+  L_CBOR_MAJOR_UINT = 0,
+  L_CBOR_MAJOR_NEGINT = 1,
+  L_CBOR_MAJOR_BYTES = 2,
+  L_CBOR_MAJOR_TEXT = 3,
+  L_CBOR_MAJOR_ARRAY = 4,
+  L_CBOR_MAJOR_MAP = 5,
+  L_CBOR_MAJOR_TAG = 6,
+  L_CBOR_MAJOR_SIMPLE = 7,
+};
+
+// Initial byte of a data item with its argument. `info` is the low 5 bits of
+// the initial byte; for major type 7 it tells simple values from floats.
+struct CborHead {
+  CborMajorType major;
+  uint8_t info;
+  uint64_t arg;
+};
+
+// Tag number of RFC 8746 typed array of the given element type in host byte
+// order. Only 8, 16, 32 and 64-bit integers, `float` and `double` are
+// supported.
+uint64_t typed_array_tag(size_t elem_size, bool is_float, bool is_signed);
+
+// Emit CBOR data items. Lengths are always definite and integer arguments are
+// encoded in the shortest form.
+struct CborWriter {
+  stream::WriteStream& out;
+
+  inline CborWriter(stream::WriteStream& out) : out(out) {}
+
+  void write_head(CborMajorType major, uint64_t arg);
+
+  void write_null();
+  void write_bool(bool x);
+  void write_uint(uint64_t x);
+  void write_int(int64_t x);
+  void write_float(float x);
+  void write_double(double x);
+  void write_text(std::string_view x);
+  void write_bytes(const void* data, size_t size);
+
+  inline void write_array_head(size_t n) {
+    write_head(L_CBOR_MAJOR_ARRAY, n);
+  }
+  inline void write_map_head(size_t n) {
+    write_head(L_CBOR_MAJOR_MAP, n);
+  }
+  inline void write_tag(uint64_t tag) {
+    write_head(L_CBOR_MAJOR_TAG, tag);
+  }
+};
+
+// Decode CBOR data items in place. Indefinite-length items are not supported.
+// `CborException` is raised on malformed or truncated input, or if the next
+// data item is not of the expected type.
+struct CborReader {
+  stream::ReadStream& in;
+
+  inline CborReader(stream::ReadStream& in) : in(in) {}
+
+  CborHead peek_head();
+  CborHead read_head();
+  // Read the head of a data item of major type `major` and return its
+  // argument.
+  uint64_t read_head(CborMajorType major);
+
+  // Consume a null if it's the next data item.
+  bool try_read_null();
+  bool read_bool();
+  uint64_t read_uint();
+  int64_t read_int();
+  // Integers are accepted and converted.
+  double read_double();
+  // The returned views point into the underlying stream data.
+  std::string_view read_text();
+  std::string_view read_bytes();
+
+  inline size_t read_array_head() {
+    return (size_t)read_head(L_CBOR_MAJOR_ARRAY);
+  }
+  inline size_t read_map_head() {
+    return (size_t)read_head(L_CBOR_MAJOR_MAP);
+  }
+  inline uint64_t read_tag() {
+    return read_head(L_CBOR_MAJOR_TAG);
+  }
+
+  // Skip the next data item including all its children.
+  void skip_value();
+};
+
+} // namespace cbor
+} // namespace liong
@@ -0,0 +1,31 @@
+// DEFLATE (RFC 1951) compressed data format.
+// @PENGUINLIONG
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace liong {
+namespace deflate {
+
+// Decompress the raw DEFLATE stream in `data` to `out`. The stream must
+// decompress to exactly `out_size` bytes; returns false if the stream is
+// malformed, truncated, or doesn't match the expected size.
+bool inflate(const void* data, size_t size, void* out, size_t out_size);
+
+struct DeflateConfig {
+  // Compression level from 0 to 9 as in zlib. Level 0 emits stored blocks
+  // only; higher levels search harder for matches at the cost of speed.
+  uint32_t level = 6;
+};
+
+// Compress `data` to a raw DEFLATE stream appended to `out`.
+void deflate(
+  const void* data,
+  size_t size,
+  std::vector<uint8_t>& out,
+  const DeflateConfig& cfg
+);
+
+} // namespace deflate
+} // namespace liong
@@ -3,6 +3,7 @@
 #pragma once
 #include "gft/hal/scoped-hal.hpp"
 #include "gft/mesh.hpp"
+#include "gft/util.hpp"
 
 #ifndef HAL_IMPL_NAMESPACE
 static_assert(false, "please specify the implementation namespace (e.g. `vk`)");
@@ -63,6 +64,7 @@ struct TextureGpu {
 
   TextureGpu(const scoped::Context& ctxt, uint32_t width, uint32_t height, bool streaming = true, bool gc = true);
   TextureGpu(const scoped::Context& ctxt, uint32_t width, uint32_t height, const std::vector<uint32_t>& pxs, bool gc = true);
+  TextureGpu(const scoped::Context& ctxt, const util::Rgba8Image& img, bool gc = true);
 
   void write(const std::vector<uint32_t>& pxs);
 };
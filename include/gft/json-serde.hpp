@@ -8,6 +8,9 @@
 #include <unordered_map>
 #include <type_traits>
 #include <optional>
+#include <string_view>
+#include <tuple>
+#include <utility>
 #include "gft/json.hpp"
 
 namespace liong {
@@ -15,37 +18,73 @@ namespace json {
 
 namespace detail {
 
-struct FieldNameList {
-  const std::vector<std::string> field_names;
-
-  static std::vector<std::string> split_field_names(const char* field_names) {
-    std::vector<std::string> out {};
-    std::string buf {};
-
-    const char* pos = field_names;
-    for (char c = *pos; c != '\0'; c = *(++pos)) {
-      bool is_lower = (c >= 'a' && c <= 'z');
-      bool is_upper = (c >= 'A' && c <= 'Z');
-      bool is_digit = (c >= '0' && c <= '9');
-      bool is_underscore = c == '_';
-
-      if (is_lower || is_upper || is_digit || is_underscore) {
-        buf.push_back(c);
-      } else {
-        if (!buf.empty()) {
-          out.emplace_back(std::exchange(buf, std::string()));
-        }
-      }
+constexpr bool is_field_name_char(char c) {
+  return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+    (c >= '0' && c <= '9') || c == '_';
+}
+// Number of field names in the stringified `L_JSON_SERDE_FIELDS` arguments.
+constexpr size_t count_field_names(const char* field_names) {
+  size_t out = 0;
+  bool is_in_name = false;
+  for (const char* pos = field_names; *pos != '\0'; ++pos) {
+    bool is_name_char = is_field_name_char(*pos);
+    if (is_name_char && !is_in_name) {
+      ++out;
     }
-    if (!buf.empty()) {
-      out.emplace_back(std::move(buf));
+    is_in_name = is_name_char;
+  }
+  return out;
+}
+// Split the stringified `L_JSON_SERDE_FIELDS` arguments into field names at
+// compile time. The names are views into the string literal.
+template<size_t N>
+constexpr std::array<std::string_view, N> split_field_names(
+  const char* field_names
+) {
+  std::array<std::string_view, N> out {};
+  size_t i = 0;
+  const char* beg = nullptr;
+  for (const char* pos = field_names;; ++pos) {
+    bool is_name_char = is_field_name_char(*pos);
+    if (is_name_char && beg == nullptr) {
+      beg = pos;
+    } else if (!is_name_char && beg != nullptr) {
+      out[i++] = std::string_view(beg, (size_t)(pos - beg));
+      beg = nullptr;
     }
-    return out;
+    if (*pos == '\0') { break; }
   }
+  return out;
+}
 
-  FieldNameList(const char* field_names) :
-    field_names(split_field_names(field_names)) {}
-};
+// Whether `T` is annotated with `L_JSON_SERDE_FIELDS`.
+template<typename T, typename = void>
+struct HasSerdeFields : std::false_type {};
+template<typename T>
+struct HasSerdeFields<
+  T,
+  std::void_t<decltype(T::json_serde_field_names__())>
+> : std::true_type {};
+
+template<typename TFields, typename TVisitor, size_t ... I>
+inline void visit_fields_impl(
+  const std::array<std::string_view, sizeof...(I)>& names,
+  TFields&& fields,
+  TVisitor& visitor,
+  std::index_sequence<I ...>
+) {
+  (visitor(names[I], std::get<I>(fields)), ...);
+}
+// Invoke `visitor(name, field)` on each field of a structure annotated with
+// `L_JSON_SERDE_FIELDS`, in declaration order. `field` is a const reference if
+// `x` is const.
+template<typename T, typename TVisitor>
+inline void visit_fields(T& x, TVisitor&& visitor) {
+  typedef typename std::remove_cv<T>::type U;
+  constexpr auto names = U::json_serde_field_names__();
+  visit_fields_impl(names, x.json_serde_fields__(), visitor,
+    std::make_index_sequence<names.size()>());
+}
 
 template<typename T>
 struct JsonSerde {
@@ -91,8 +130,8 @@ struct JsonSerde {
   template<typename U = typename std::remove_cv<T>::type>
   static JsonValue serialize(const typename std::enable_if_t<std::is_same<std::pair<typename U::first_type, typename U::second_type>, T>::value, T>& x) {
     JsonObject obj {};
-    obj.inner.emplace(std::make_pair<const std::string, JsonValue>("key", JsonSerde<typename T::first_type>::serialize(x.first)));
-    obj.inner.emplace(std::make_pair<const std::string, JsonValue>("value", JsonSerde<typename T::second_type>::serialize(x.second)));
+    obj.insert("key", JsonSerde<typename T::first_type>::serialize(x.first));
+    obj.insert("value", JsonSerde<typename T::second_type>::serialize(x.second));
     return JsonValue(std::move(obj));
   }
   template<typename U = typename std::remove_cv<T>::type>
@@ -224,60 +263,215 @@ struct JsonSerde {
   }
 };
 
-template<typename ... TArgs>
-struct JsonSerdeFieldImpl {
-};
-template<typename TFirst, typename ... TOthers>
-struct JsonSerdeFieldImpl<TFirst, TOthers ...> {
-  inline static void serialize(
-    JsonObject& obj,
-    std::vector<std::string>::const_iterator name,
-    const TFirst& first,
-    const TOthers& ... others
-  ) {
-    obj.inner.emplace(std::make_pair<std::string, JsonValue>(std::string(*name), JsonSerde<TFirst>::serialize(first)));
-    JsonSerdeFieldImpl<TOthers ...>::serialize(obj, ++name, others ...);
-  }
-  inline static void deserialize(
-    const JsonObject& obj,
-    std::vector<std::string>::const_iterator name,
-    TFirst& first,
-    TOthers& ... others
-  ) {
-    JsonSerde<TFirst>::deserialize(obj.inner.at(*name), first);
-    JsonSerdeFieldImpl<TOthers ...>::deserialize(obj, ++name, others ...);
-  }
-};
-template<>
-struct JsonSerdeFieldImpl<> {
-  inline static void serialize(
-    JsonObject& obj,
-    std::vector<std::string>::const_iterator name
-  ) {
-  }
-  inline static void deserialize(
-    const JsonObject& obj,
-    std::vector<std::string>::const_iterator name
-  ) {
+template<typename T>
+inline void json_serialize_fields_impl(const T& x, JsonObject& obj) {
+  visit_fields(x, [&](std::string_view name, const auto& field) {
+    typedef std::remove_cv_t<std::remove_reference_t<decltype(field)>> TField;
+    obj.insert(std::string(name), JsonSerde<TField>::serialize(field));
+  });
+}
+template<typename T>
+inline void json_deserialize_fields_impl(T& x, const JsonObject& obj) {
+  visit_fields(x, [&](std::string_view name, auto& field) {
+    typedef std::remove_cv_t<std::remove_reference_t<decltype(field)>> TField;
+    JsonSerde<TField>::deserialize(obj.at(name), field);
+  });
+}
+
+inline void next_event(JsonReader& reader, JsonEvent& event) {
+  if (!reader.next(event)) {
+    throw JsonException("unexpected end of json");
   }
-};
-template<typename ... TArgs>
-inline void json_serialize_field_impl(
-  JsonObject& obj,
-  std::vector<std::string>::const_iterator name,
-  const TArgs& ... args
-) {
-  JsonSerdeFieldImpl<TArgs ...>::serialize(obj, name, args ...);
 }
-template<typename ... TArgs>
-inline void json_deserialize_field_impl(
-  const JsonObject& obj,
-  std::vector<std::string>::const_iterator name,
-  TArgs& ... args
-) {
-  JsonSerdeFieldImpl<TArgs ...>::deserialize(obj, name, args ...);
+inline void expect_event(const JsonEvent& event, JsonEventType ty) {
+  if (event.ty != ty) {
+    throw JsonException("unexpected json event");
+  }
 }
 
+// Deserialize JSON straight from `JsonReader` events without building a DOM.
+// `event` is the first event of the value which has already been read.
+template<typename T>
+struct JsonReaderSerde {
+  // Numeric and boolean types (integers and floating-point numbers).
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_arithmetic<U>::value, T>& x) {
+    if constexpr (std::is_same<U, bool>::value) {
+      expect_event(event, L_JSON_EVENT_BOOLEAN);
+      x = event.b;
+    } else if (event.ty == L_JSON_EVENT_INT) {
+      x = (T)event.num_int;
+    } else if (event.ty == L_JSON_EVENT_FLOAT) {
+      x = (T)event.num_float;
+    } else {
+      throw JsonException("value is not a number");
+    }
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_enum<U>::value, T>& x) {
+    typename std::underlying_type<T>::type xx {};
+    JsonReaderSerde<decltype(xx)>::deserialize(reader, event, xx);
+    x = (T)xx;
+  }
+
+  // String type.
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_same<U, std::string>::value, T>& x) {
+    expect_event(event, L_JSON_EVENT_STRING);
+    x.assign(event.str.data(), event.str.size());
+  }
+
+  // Structure types. Unknown fields are skipped.
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<HasSerdeFields<U>::value, T>& x) {
+    constexpr size_t NFIELD = U::json_serde_field_names__().size();
+    std::array<bool, NFIELD> is_found {};
+    expect_event(event, L_JSON_EVENT_BEGIN_OBJECT);
+    JsonEvent key_event {};
+    for (;;) {
+      next_event(reader, key_event);
+      if (key_event.ty == L_JSON_EVENT_END_OBJECT) { break; }
+      // The key view is invalidated by the next event.
+      std::string key(key_event.str);
+      JsonEvent value_event {};
+      next_event(reader, value_event);
+
+      size_t i = 0;
+      bool is_matched = false;
+      visit_fields(x, [&](std::string_view name, auto& field) {
+        typedef std::remove_cv_t<std::remove_reference_t<decltype(field)>> TField;
+        if (!is_matched && name == key) {
+          JsonReaderSerde<TField>::deserialize(reader, value_event, field);
+          is_found[i] = true;
+          is_matched = true;
+        }
+        ++i;
+      });
+      if (!is_matched) {
+        reader.skip_value(value_event);
+      }
+    }
+    for (bool xx : is_found) {
+      if (!xx) { throw JsonException("object field not found"); }
+    }
+  }
+
+  // Key-value pairs.
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_same<std::pair<typename U::first_type, typename U::second_type>, T>::value, T>& x) {
+    expect_event(event, L_JSON_EVENT_BEGIN_OBJECT);
+    bool has_key = false;
+    bool has_value = false;
+    JsonEvent key_event {};
+    for (;;) {
+      next_event(reader, key_event);
+      if (key_event.ty == L_JSON_EVENT_END_OBJECT) { break; }
+      bool is_key = key_event.str == "key";
+      bool is_value = key_event.str == "value";
+      JsonEvent value_event {};
+      next_event(reader, value_event);
+      if (is_key) {
+        JsonReaderSerde<typename T::first_type>::deserialize(reader, value_event, x.first);
+        has_key = true;
+      } else if (is_value) {
+        JsonReaderSerde<typename T::second_type>::deserialize(reader, value_event, x.second);
+        has_value = true;
+      } else {
+        reader.skip_value(value_event);
+      }
+    }
+    if (!has_key || !has_value) {
+      throw JsonException("object field not found");
+    }
+  }
+
+  // Owned pointer (requires default constructable).
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_same<std::unique_ptr<typename U::element_type>, T>::value, T>& x) {
+    if (event.ty == L_JSON_EVENT_NULL) {
+      x = nullptr;
+    } else {
+      x = std::make_unique<typename T::element_type>();
+      JsonReaderSerde<typename T::element_type>::deserialize(reader, event, *x);
+    }
+  }
+
+  // Array types (requires default + move constructable).
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_array<U>::value, T>& x) {
+    deserialize_fixed(reader, event, x, std::extent<T>::value);
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_same<std::array<typename U::value_type, std::tuple_size<U>::value>, T>::value, T>& x) {
+    deserialize_fixed(reader, event, x.data(), x.size());
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_same<std::vector<typename U::value_type>, T>::value, T>& x) {
+    expect_event(event, L_JSON_EVENT_BEGIN_ARRAY);
+    x.clear();
+    JsonEvent elem_event {};
+    for (;;) {
+      next_event(reader, elem_event);
+      if (elem_event.ty == L_JSON_EVENT_END_ARRAY) { break; }
+      typename T::value_type xx {};
+      JsonReaderSerde<decltype(xx)>::deserialize(reader, elem_event, xx);
+      x.emplace_back(std::move(xx));
+    }
+  }
+
+  // Dictionary types (requires default + move constructable).
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_same<std::map<typename U::key_type, typename U::mapped_type>, T>::value, T>& x) {
+    deserialize_dict(reader, event, x);
+  }
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_same<std::unordered_map<typename U::key_type, typename U::mapped_type>, T>::value, T>& x) {
+    deserialize_dict(reader, event, x);
+  }
+
+  // Optional types (requires default + move constructable).
+  template<typename U = typename std::remove_cv<T>::type>
+  static void deserialize(JsonReader& reader, const JsonEvent& event, typename std::enable_if_t<std::is_same<std::optional<typename U::value_type>, T>::value, T>& x) {
+    if (event.ty == L_JSON_EVENT_NULL) {
+      x = std::nullopt;
+    } else {
+      typename T::value_type xx {};
+      JsonReaderSerde<typename T::value_type>::deserialize(reader, event, xx);
+      x = std::move(xx);
+    }
+  }
+
+private:
+  template<typename TElem>
+  static void deserialize_fixed(JsonReader& reader, const JsonEvent& event, TElem* data, size_t n) {
+    expect_event(event, L_JSON_EVENT_BEGIN_ARRAY);
+    JsonEvent elem_event {};
+    for (size_t i = 0;; ++i) {
+      next_event(reader, elem_event);
+      if (elem_event.ty == L_JSON_EVENT_END_ARRAY) {
+        if (i != n) { throw JsonException("array is too short"); }
+        break;
+      }
+      if (i >= n) { throw JsonException("array is too long"); }
+      JsonReaderSerde<TElem>::deserialize(reader, elem_event, data[i]);
+    }
+  }
+  // Dictionaries are arrays of key-value pairs, as produced by `JsonSerde`.
+  template<typename TDict>
+  static void deserialize_dict(JsonReader& reader, const JsonEvent& event, TDict& x) {
+    expect_event(event, L_JSON_EVENT_BEGIN_ARRAY);
+    x.clear();
+    JsonEvent elem_event {};
+    for (;;) {
+      next_event(reader, elem_event);
+      if (elem_event.ty == L_JSON_EVENT_END_ARRAY) { break; }
+      std::pair<typename TDict::key_type, typename TDict::mapped_type> xx {};
+      JsonReaderSerde<decltype(xx)>::deserialize(reader, elem_event, xx);
+      x.emplace(std::move(xx.first), std::move(xx.second));
+    }
+  }
+};
+
 } // namespace detail
 
 // Serialize a JSON serde object, turning in-memory representations into JSON
@@ -295,6 +489,26 @@ void deserialize(const JsonValue& j, T& out) {
 }
 
 
+// Deserialize the next JSON value from `reader` straight into `out` without
+// building an intermediate `JsonValue` tree. `CustomJsonSerdeBase` is not
+// supported.
+template<typename T>
+void deserialize(JsonReader& reader, T& out) {
+  JsonEvent event {};
+  detail::next_event(reader, event);
+  detail::JsonReaderSerde<T>::deserialize(reader, event, out);
+}
+// Parse JSON text straight into `out`. See `deserialize(JsonReader&, T&)`.
+template<typename T>
+void parse_into(const char* json_lit, size_t size, T& out) {
+  JsonReader reader(json_lit, size);
+  deserialize(reader, out);
+}
+template<typename T>
+void parse_into(const std::string& json_lit, T& out) {
+  parse_into(json_lit.data(), json_lit.size(), out);
+}
+
 // If you need to control the serialization process on your own, you might want
 // to inherit from this.
 struct CustomJsonSerdeBase {
@@ -318,16 +532,21 @@ public:
 } // namespace json
 } // namespace liong
 
+// Annotate a structure with the fields to be serialized. The field names are
+// split at compile time, and the fields are visited in declaration order with
+// `detail::visit_fields`.
 #define L_JSON_SERDE_FIELDS(...) \
-  const std::vector<std::string>& json_serde_field_names__() const { \
-    static ::liong::json::detail::FieldNameList JSON_SERDE_FIELD_NAMES__ = { #__VA_ARGS__ }; \
-    return JSON_SERDE_FIELD_NAMES__.field_names; \
+  static constexpr auto json_serde_field_names__() { \
+    return ::liong::json::detail::split_field_names< \
+      ::liong::json::detail::count_field_names(#__VA_ARGS__)>(#__VA_ARGS__); \
   } \
+  auto json_serde_fields__() { return std::tie(__VA_ARGS__); } \
+  auto json_serde_fields__() const { return std::tie(__VA_ARGS__); } \
   ::liong::json::JsonValue json_serialize_fields__() const { \
     ::liong::json::JsonObject out__ {}; \
-    ::liong::json::detail::json_serialize_field_impl(out__, json_serde_field_names__().begin(), __VA_ARGS__); \
+    ::liong::json::detail::json_serialize_fields_impl(*this, out__); \
     return ::liong::json::JsonValue(std::move(out__)); \
   } \
   void json_deserialize_fields__(const ::liong::json::JsonObject& j__) { \
-    ::liong::json::detail::json_deserialize_field_impl(j__, json_serde_field_names__().begin(), __VA_ARGS__); \
+    ::liong::json::detail::json_deserialize_fields_impl(*this, j__); \
   }
@@ -1,10 +1,17 @@
 // JSON serialization/deserialization.
 // @PENGUINLIONG
 #pragma once
+#include <cstdint>
+#include <cstring>
+#include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 #include <map>
 #include <sstream>
+#include <functional>
+#include "gft/stream.hpp"
 
 namespace liong {
 namespace json {
@@ -45,16 +52,42 @@ public:
   }
 };
 
+// Object field as enumerated by `JsonFieldEnumerator`.
+struct JsonField {
+  const std::string& first;
+  const JsonValue& second;
+};
+// Iterate over either representation of `JsonObject`.
+class JsonFieldIterator {
+  std::map<std::string, JsonValue, std::less<>>::const_iterator tree_it_;
+  // Current entry of a hashed object; null for tree objects.
+  const std::pair<std::string, JsonValue>* entry_;
+public:
+  JsonFieldIterator(
+    std::map<std::string, JsonValue, std::less<>>::const_iterator it
+  ) :
+    tree_it_(it), entry_(nullptr) {}
+  JsonFieldIterator(const std::pair<std::string, JsonValue>* entry) :
+    tree_it_(), entry_(entry) {}
+
+  inline JsonField operator*() const;
+  inline JsonFieldIterator& operator++();
+  inline bool operator!=(const JsonFieldIterator& b) const;
+  inline bool operator==(const JsonFieldIterator& b) const {
+    return !(*this != b);
+  }
+};
+
 class JsonFieldEnumerator {
-  std::map<std::string, JsonValue>::const_iterator beg_, end_;
+  JsonFieldIterator beg_, end_;
 public:
-  JsonFieldEnumerator(const std::map<std::string, JsonValue>& obj) :
-    beg_(obj.cbegin()), end_(obj.cend()) {}
+  JsonFieldEnumerator(JsonFieldIterator beg, JsonFieldIterator end) :
+    beg_(beg), end_(end) {}
 
-  std::map<std::string, JsonValue>::const_iterator begin() const {
+  JsonFieldIterator begin() const {
     return beg_;
   }
-  std::map<std::string, JsonValue>::const_iterator end() const {
+  JsonFieldIterator end() const {
     return end_;
   }
 };
@@ -67,30 +100,103 @@ struct JsonArray {
   JsonArray(std::vector<JsonValue>&& b) : inner(std::move(b)) {}
   JsonArray(std::initializer_list<JsonValue>&& elems);
 };
+// Insertion-ordered hash table of object fields. Fields are kept densely in
+// insertion order and indexed by an open-addressing table with linear probing,
+// so lookups take constant time and enumeration follows the document order.
+class JsonFieldTable {
+  std::vector<std::pair<std::string, JsonValue>> entries_;
+  // Key hashes of `entries_`, compared before the keys on probing.
+  std::vector<uint32_t> hashes_;
+  // Index of the entry plus one; zero marks an empty slot. The number of slots
+  // is either zero or a power of two at least twice the number of entries.
+  std::vector<uint32_t> slots_;
+
+  void rehash(size_t nslot);
+
+public:
+  inline size_t size() const { return hashes_.size(); }
+  inline bool empty() const { return hashes_.empty(); }
+
+  void reserve(size_t n);
+  const JsonValue* find(std::string_view key) const;
+  inline JsonValue* find(std::string_view key) {
+    return const_cast<JsonValue*>(
+      static_cast<const JsonFieldTable*>(this)->find(key));
+  }
+  // Insert a field or overwrite the value of an existing one. An overwritten
+  // field keeps its original position.
+  JsonValue& insert(std::string&& key, JsonValue&& value);
+
+  inline const std::pair<std::string, JsonValue>* begin() const;
+  inline const std::pair<std::string, JsonValue>* end() const;
+};
+
 // JSON object builder.
-struct JsonObject {
-  std::map<std::string, JsonValue> inner;
+//
+// Objects built by hand and parsed by default keep their fields sorted by key.
+// Objects parsed with `JsonParseConfig::hash_objects` keep their fields in a
+// `JsonFieldTable` in document order instead. Only one of the two is
+// allocated, and fields are only reachable through the methods below so that
+// lookups always see every insertion.
+class JsonObject {
+  typedef std::map<std::string, JsonValue, std::less<>> JsonFieldTree;
+
+  std::unique_ptr<JsonFieldTree> tree_;
+  std::unique_ptr<JsonFieldTable> table_;
 
-  inline JsonObject() : inner() {}
-  JsonObject(std::map<std::string, JsonValue>&& b) : inner(std::move(b)) {}
+public:
+  JsonObject();
+  JsonObject(std::map<std::string, JsonValue>&& b);
+  JsonObject(JsonFieldTable&& b);
   JsonObject(
     std::initializer_list<std::pair<const std::string, JsonValue>>&& entries
   );
+  JsonObject(const JsonObject& b);
+  JsonObject(JsonObject&& b) noexcept;
+  ~JsonObject();
+
+  JsonObject& operator=(const JsonObject& b);
+  JsonObject& operator=(JsonObject&& b) noexcept;
+
+  inline bool is_hashed() const { return table_ != nullptr; }
+  size_t size() const;
+  const JsonValue* find(std::string_view key) const;
+  inline JsonValue* find(std::string_view key) {
+    return const_cast<JsonValue*>(
+      static_cast<const JsonObject*>(this)->find(key));
+  }
+  // Throws `std::out_of_range` if the field doesn't exist.
+  const JsonValue& at(std::string_view key) const;
+  inline JsonValue& at(std::string_view key) {
+    return const_cast<JsonValue&>(
+      static_cast<const JsonObject*>(this)->at(key));
+  }
+  // Insert a field or overwrite the value of an existing one.
+  JsonValue& insert(std::string&& key, JsonValue&& value);
+  JsonFieldEnumerator fields() const;
 };
 
 // Represent a abstract value in JSON representation.
+//
+// The payload is a tagged union discriminated by `ty`, so a value is as large
+// as its largest payload rather than all of them together. Only the member
+// matching `ty` is alive; short strings are kept inline by `std::string`.
 struct JsonValue {
   JsonType ty;
-  bool b;
-  int64_t num_int;
-  double num_float;
-  std::string str;
-  JsonObject obj;
-  JsonArray arr;
+  union {
+    bool b;
+    int64_t num_int;
+    double num_float;
+    std::string str;
+    JsonObject obj;
+    JsonArray arr;
+  };
 
-  inline JsonValue() : ty(L_JSON_NULL) {}
-  inline JsonValue(nullptr_t) : ty(L_JSON_NULL) {}
-  inline JsonValue(bool b) : ty(L_JSON_BOOLEAN), b(b) {}
+  inline JsonValue() : ty(L_JSON_NULL), num_int(0) {}
+  inline JsonValue(nullptr_t) : ty(L_JSON_NULL), num_int(0) {}
+  inline JsonValue(bool b) : ty(L_JSON_BOOLEAN), num_int(0) {
+    this->b = b;
+  }
   inline JsonValue(double num) : ty(L_JSON_FLOAT), num_float(num) {}
   inline JsonValue(float num) : ty(L_JSON_FLOAT), num_float(num) {}
   inline JsonValue(char num) : ty(L_JSON_INT), num_int(num) {}
@@ -105,28 +211,54 @@ struct JsonValue {
   inline JsonValue(long long num) : ty(L_JSON_INT), num_int(num) {}
   inline JsonValue(unsigned long long num) : ty(L_JSON_INT), num_int(num) {}
   inline JsonValue(const char* str) : ty(L_JSON_STRING), str(str) {}
+  inline JsonValue(const char* str, size_t len) :
+    ty(L_JSON_STRING), str(str, len) {}
   inline JsonValue(const std::string& str) : ty(L_JSON_STRING), str(str) {}
   inline JsonValue(std::string&& str) :
     ty(L_JSON_STRING),
     str(std::forward<std::string>(str)) {}
-  JsonValue(JsonObject&& obj);
-  JsonValue(JsonArray&& arr);
+  inline JsonValue(JsonObject&& obj) :
+    ty(L_JSON_OBJECT),
+    obj(std::forward<JsonObject>(obj)) {}
+  inline JsonValue(JsonArray&& arr) :
+    ty(L_JSON_ARRAY),
+    arr(std::forward<JsonArray>(arr)) {}
+
+  JsonValue(const JsonValue& b);
+  inline JsonValue(JsonValue&& b) noexcept : ty(L_JSON_NULL), num_int(0) {
+    take(std::move(b));
+  }
+  inline ~JsonValue() {
+    if (ty >= L_JSON_STRING) { release(); }
+  }
+
+  JsonValue& operator=(const JsonValue& b);
+  inline JsonValue& operator=(JsonValue&& b) noexcept {
+    if (this != &b) {
+      // `b` might be owned by this value, as in `j = std::move(j["k"])`, so
+      // its payload is moved out before ours is released.
+      JsonValue tmp(std::move(b));
+      if (ty >= L_JSON_STRING) { release(); }
+      take(std::move(tmp));
+    }
+    return *this;
+  }
 
   inline JsonValue& operator[](const char* key) {
     if (!is_obj()) { throw JsonException("value is not an object"); }
-    return obj.inner.at(key);
+    return obj.at(key);
   }
   inline const JsonValue& operator[](const char* key) const {
     if (!is_obj()) { throw JsonException("value is not an object"); }
-    return obj.inner.at(key);
+    return obj.at(key);
   }
   inline JsonValue& operator[](const std::string& key) {
     if (!is_obj()) { throw JsonException("value is not an object"); }
-    return obj.inner.at(key);
+    return obj.at(key);
   }
   inline const JsonValue& operator[](const std::string& key) const {
     if (!is_obj()) { throw JsonException("value is not an object"); }
-    return obj.inner.at(key);
+    return obj.at(key);
   }
   inline JsonValue& operator[](size_t i) {
     if (!is_arr()) { throw JsonException("value is not an array"); }
@@ -140,57 +272,20 @@ struct JsonValue {
     if (!is_bool()) { throw JsonException("value is not a bool"); }
     return b;
   }
-  inline operator double() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return num_float;
-  }
-  inline operator float() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (float)num_float;
-  }
-  inline operator char() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (char)num_int;
-  }
-  inline operator signed char() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (signed char)num_int;
-  }
-  inline operator unsigned char() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (unsigned char)num_int;
-  }
-  inline operator short() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (short)num_int;
-  }
-  inline operator unsigned short() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (unsigned short)num_int;
-  }
-  inline operator int() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (int)num_int;
-  }
-  inline operator unsigned int() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (unsigned int)num_int;
-  }
-  inline operator long() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (long)num_int;
-  }
-  inline operator unsigned long() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (unsigned long)num_int;
-  }
-  inline operator long long() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (long long)num_int;
-  }
+  inline operator double() const { return num<double>(); }
+  inline operator float() const { return num<float>(); }
+  inline operator char() const { return num<char>(); }
+  inline operator signed char() const { return num<signed char>(); }
+  inline operator unsigned char() const { return num<unsigned char>(); }
+  inline operator short() const { return num<short>(); }
+  inline operator unsigned short() const { return num<unsigned short>(); }
+  inline operator int() const { return num<int>(); }
+  inline operator unsigned int() const { return num<unsigned int>(); }
+  inline operator long() const { return num<long>(); }
+  inline operator unsigned long() const { return num<unsigned long>(); }
+  inline operator long long() const { return num<long long>(); }
   inline operator unsigned long long() const {
-    if (!is_num()) { throw JsonException("value is not a number"); }
-    return (unsigned long long)num_int;
+    return num<unsigned long long>();
   }
   inline operator const std::string& () const {
     if (!is_str()) { throw JsonException("value is not a string"); }
@@ -212,9 +307,27 @@ struct JsonValue {
   inline bool is_obj() const { return ty == L_JSON_OBJECT; }
   inline bool is_arr() const { return ty == L_JSON_ARRAY; }
 
+  // Numbers are casted on access so that integers are never rounded through
+  // floating-point representations.
+  template<typename T>
+  inline T num() const {
+    if (ty == L_JSON_INT) {
+      return (T)num_int;
+    } else if (ty == L_JSON_FLOAT) {
+      return (T)num_float;
+    } else {
+      throw JsonException("value is not a number");
+    }
+  }
+  // The returned view is invalidated when the value is modified or destroyed.
+  inline std::string_view str_view() const {
+    if (!is_str()) { throw JsonException("value is not a string"); }
+    return str;
+  }
+
   inline size_t size() const {
     if (is_obj()) {
-      return obj.inner.size();
+      return obj.size();
     } else if (is_arr()) {
       return arr.inner.size();
     } else {
@@ -222,22 +335,395 @@ struct JsonValue {
     }
   }
   inline JsonElementEnumerator elems() const {
+    if (!is_arr()) { throw JsonException("value is not an array"); }
     return JsonElementEnumerator(arr.inner);
   }
   inline JsonFieldEnumerator fields() const {
-    return JsonFieldEnumerator(obj.inner);
+    if (!is_obj()) { throw JsonException("value is not an object"); }
+    return obj.fields();
   }
+
+private:
+  // Move the payload of `b` into this null value and leave `b` null.
+  inline void take(JsonValue&& b) noexcept {
+    switch (b.ty) {
+    case L_JSON_STRING: new(&str) std::string(std::move(b.str)); break;
+    case L_JSON_OBJECT: new(&obj) JsonObject(std::move(b.obj)); break;
+    case L_JSON_ARRAY: new(&arr) JsonArray(std::move(b.arr)); break;
+    case L_JSON_BOOLEAN: this->b = b.b; break;
+    case L_JSON_FLOAT: num_float = b.num_float; break;
+    default: num_int = b.num_int; break;
+    }
+    ty = b.ty;
+    if (b.ty >= L_JSON_STRING) { b.release(); }
+  }
+  // Destroy the string, object or array payload and become null.
+  void release();
+};
+
+inline JsonField JsonFieldIterator::operator*() const {
+  if (entry_ != nullptr) {
+    return JsonField { entry_->first, entry_->second };
+  } else {
+    return JsonField { tree_it_->first, tree_it_->second };
+  }
+}
+inline JsonFieldIterator& JsonFieldIterator::operator++() {
+  if (entry_ != nullptr) {
+    ++entry_;
+  } else {
+    ++tree_it_;
+  }
+  return *this;
+}
+inline bool JsonFieldIterator::operator!=(const JsonFieldIterator& b) const {
+  return entry_ != b.entry_ || (entry_ == nullptr && tree_it_ != b.tree_it_);
+}
+inline const std::pair<std::string, JsonValue>* JsonFieldTable::begin() const {
+  return entries_.data();
+}
+inline const std::pair<std::string, JsonValue>* JsonFieldTable::end() const {
+  return entries_.data() + entries_.size();
+}
+
+// Monotonic memory arena. Allocations are carved out of large blocks and are
+// only released all at once when the arena is cleared or destroyed, so the
+// objects placed in it must be trivially destructible.
+class JsonArena {
+  static constexpr size_t MIN_BLOCK_SIZE = 64 * 1024;
+  static constexpr size_t MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+  std::vector<std::unique_ptr<uint8_t[]>> blocks_;
+  uint8_t* pos_;
+  uint8_t* end_;
+  size_t next_block_size_;
+  size_t capacity_;
+
+  void* alloc_slow(size_t size, size_t align);
+
+public:
+  JsonArena();
+  JsonArena(const JsonArena&) = delete;
+  JsonArena(JsonArena&& b) noexcept;
+  JsonArena& operator=(const JsonArena&) = delete;
+  JsonArena& operator=(JsonArena&& b) noexcept;
+
+  inline void* alloc(size_t size, size_t align) {
+    uint8_t* out = (uint8_t*)(((uintptr_t)pos_ + (align - 1)) & ~(uintptr_t)(align - 1));
+    if (pos_ == nullptr || out + size > end_) {
+      return alloc_slow(size, align);
+    }
+    pos_ = out + size;
+    return out;
+  }
+  template<typename T>
+  inline T* alloc_array(size_t n) {
+    static_assert(std::is_trivially_destructible<T>::value,
+      "arena objects are never destructed");
+    return (T*)alloc(n * sizeof(T), alignof(T));
+  }
+
+  // Number of bytes reserved from the system.
+  inline size_t capacity() const {
+    return capacity_;
+  }
+  void clear();
+};
+
+struct JsonMember;
+
+// Read-only counterpart of `JsonValue` living in a `JsonDocument`'s arena.
+// Objects and arrays refer to contiguous runs of child nodes, so nodes are
+// trivially copied and destroyed.
+struct JsonNode {
+  JsonType ty;
+  // Length of string, number of elements or number of object members.
+  uint32_t size_;
+  union {
+    bool b;
+    int64_t num_int;
+    double num_float;
+    const char* str_;
+    const JsonNode* elems_;
+    const JsonMember* members_;
+  };
+
+  inline JsonNode() : ty(L_JSON_NULL), size_(0), num_int(0) {}
+
+  inline bool is_null() const { return ty == L_JSON_NULL; }
+  inline bool is_bool() const { return ty == L_JSON_BOOLEAN; }
+  inline bool is_num() const { return ty == L_JSON_FLOAT || ty == L_JSON_INT; }
+  inline bool is_str() const { return ty == L_JSON_STRING; }
+  inline bool is_obj() const { return ty == L_JSON_OBJECT; }
+  inline bool is_arr() const { return ty == L_JSON_ARRAY; }
+
+  template<typename T>
+  inline T num() const {
+    if (ty == L_JSON_INT) {
+      return (T)num_int;
+    } else if (ty == L_JSON_FLOAT) {
+      return (T)num_float;
+    } else {
+      throw JsonException("value is not a number");
+    }
+  }
+  inline std::string_view str_view() const {
+    if (!is_str()) { throw JsonException("value is not a string"); }
+    return std::string_view(str_, size_);
+  }
+
+  // Returns null if the key doesn't exist, or the node is not an object.
+  const JsonNode* find(std::string_view key) const;
+  const JsonNode& operator[](std::string_view key) const;
+  inline const JsonNode& operator[](const char* key) const {
+    return (*this)[std::string_view(key)];
+  }
+  inline const JsonNode& operator[](const std::string& key) const {
+    return (*this)[std::string_view(key)];
+  }
+  inline const JsonNode& operator[](size_t i) const {
+    if (!is_arr()) { throw JsonException("value is not an array"); }
+    if (i >= size_) { throw JsonException("array index out of range"); }
+    return elems_[i];
+  }
+  inline operator bool() const {
+    if (!is_bool()) { throw JsonException("value is not a bool"); }
+    return b;
+  }
+  inline operator double() const { return num<double>(); }
+  inline operator float() const { return num<float>(); }
+  inline operator char() const { return num<char>(); }
+  inline operator signed char() const { return num<signed char>(); }
+  inline operator unsigned char() const { return num<unsigned char>(); }
+  inline operator short() const { return num<short>(); }
+  inline operator unsigned short() const { return num<unsigned short>(); }
+  inline operator int() const { return num<int>(); }
+  inline operator unsigned int() const { return num<unsigned int>(); }
+  inline operator long() const { return num<long>(); }
+  inline operator unsigned long() const { return num<unsigned long>(); }
+  inline operator long long() const { return num<long long>(); }
+  inline operator unsigned long long() const {
+    return num<unsigned long long>();
+  }
+  inline operator std::string() const {
+    return std::string(str_view());
+  }
+
+  inline size_t size() const {
+    if (is_obj() || is_arr()) {
+      return size_;
+    } else {
+      throw JsonException("only object and array can have size");
+    }
+  }
+
+  template<typename T>
+  struct Range {
+    const T* beg_;
+    const T* end_;
+    inline const T* begin() const { return beg_; }
+    inline const T* end() const { return end_; }
+  };
+  inline Range<JsonNode> elems() const {
+    if (!is_arr()) { throw JsonException("value is not an array"); }
+    return Range<JsonNode> { elems_, elems_ + size_ };
+  }
+  inline Range<JsonMember> fields() const;
+};
+struct JsonMember {
+  std::string_view first;
+  JsonNode second;
+};
+inline JsonNode::Range<JsonMember> JsonNode::fields() const {
+  if (!is_obj()) { throw JsonException("value is not an object"); }
+  return Range<JsonMember> { members_, members_ + size_ };
+}
+
+// A parsed JSON document. All nodes, keys and strings are allocated from a
+// single arena owned by the document, so parsing makes a handful of large
+// allocations and tearing down the document frees them all at once.
+class JsonDocument {
+  JsonArena arena_;
+  JsonNode root_;
+
+public:
+  JsonDocument() = default;
+  JsonDocument(const JsonDocument&) = delete;
+  // The root of a moved-from document is reset as it points into the arena
+  // blocks that have been moved away.
+  inline JsonDocument(JsonDocument&& b) noexcept :
+    arena_(std::move(b.arena_)),
+    root_(b.root_)
+  {
+    b.root_ = JsonNode();
+  }
+  JsonDocument& operator=(const JsonDocument&) = delete;
+  inline JsonDocument& operator=(JsonDocument&& b) noexcept {
+    if (this != &b) {
+      arena_ = std::move(b.arena_);
+      root_ = b.root_;
+      b.root_ = JsonNode();
+    }
+    return *this;
+  }
+
+  inline const JsonNode& root() const {
+    return root_;
+  }
+  inline JsonArena& arena() {
+    return arena_;
+  }
+  inline void set_root(const JsonNode& root) {
+    root_ = root;
+  }
+  inline void clear() {
+    root_ = JsonNode();
+    arena_.clear();
+  }
+};
+
+// Type of events emitted by `JsonReader`.
+enum JsonEventType {
+  L_JSON_EVENT_NULL,
+  L_JSON_EVENT_BOOLEAN,
+  L_JSON_EVENT_FLOAT,
+  L_JSON_EVENT_INT,
+  L_JSON_EVENT_STRING,
+  L_JSON_EVENT_KEY,
+  L_JSON_EVENT_BEGIN_OBJECT,
+  L_JSON_EVENT_END_OBJECT,
+  L_JSON_EVENT_BEGIN_ARRAY,
+  L_JSON_EVENT_END_ARRAY,
+};
+struct JsonEvent {
+  JsonEventType ty;
+  bool b;
+  int64_t num_int;
+  double num_float;
+  // String value or object key. Only valid until the next event is read.
+  std::string_view str;
+};
+
+// Provides more JSON text to a `JsonReader`. Returns the number of bytes
+// written to `dst`, which is at most `size`; returns 0 at the end of input.
+typedef std::function<size_t(char* dst, size_t size)> JsonSource;
+
+struct JsonReaderState;
+
+// Pull-style JSON reader. The input is consumed incrementally in chunks so the
+// memory footprint is bounded by the chunk size, the longest token and the
+// nesting depth, regardless of the size of the document.
+//
+// A sequence of top-level values (e.g. JSON lines) is accepted, one after
+// another.
+class JsonReader {
+  std::unique_ptr<JsonReaderState> state_;
+
+public:
+  static constexpr size_t DEFAULT_CHUNK_SIZE = 64 * 1024;
+
+  // Read from an in-memory buffer which must be kept alive until reading is
+  // done.
+  JsonReader(const char* json_lit, size_t size);
+  JsonReader(JsonSource&& src, size_t chunk_size = DEFAULT_CHUNK_SIZE);
+  JsonReader(JsonReader&&);
+  JsonReader& operator=(JsonReader&&);
+  ~JsonReader();
+
+  // Read from `stream` which must be kept alive until reading is done.
+  static JsonReader from_stream(
+    stream::ReadStream& stream,
+    size_t chunk_size = DEFAULT_CHUNK_SIZE
+  );
+  static JsonReader from_file(
+    const char* path,
+    size_t chunk_size = DEFAULT_CHUNK_SIZE
+  );
+
+  // Returns false at the end of input. `JsonException` is raised if the JSON
+  // is invalid.
+  bool next(JsonEvent& out);
+  // Number of containers left open after the last event.
+  size_t depth() const;
+  // Skip the rest of the value started by `first`, which must be the last
+  // event returned by `next`. Nothing is skipped for scalar values.
+  void skip_value(const JsonEvent& first);
+};
+
+// SAX-style callbacks for `json::read`. Return false to stop reading.
+struct JsonSaxHandler {
+  virtual ~JsonSaxHandler() {}
+
+  virtual bool on_null() { return true; }
+  virtual bool on_bool(bool b) { return true; }
+  virtual bool on_int(int64_t num) { return true; }
+  virtual bool on_float(double num) { return true; }
+  virtual bool on_str(std::string_view str) { return true; }
+  virtual bool on_key(std::string_view key) { return true; }
+  virtual bool on_begin_object() { return true; }
+  virtual bool on_end_object() { return true; }
+  virtual bool on_begin_array() { return true; }
+  virtual bool on_end_array() { return true; }
+};
+
+struct JsonParseConfig {
+  // Index the fields of parsed objects with insertion-ordered hash tables
+  // rather than sorted trees. Field lookups take constant time and the fields
+  // are enumerated, and thus printed, in document order.
+  bool hash_objects = false;
 };
 
 // Parse JSON literal into and `JsonValue` object. If the JSON is invalid or
 // unsupported, `JsonException` will be raised.
+//
+// The JSON literal is scanned in place. Memory is only allocated for the
+// parsed values and for strings with escape sequences.
+JsonValue parse(const char* json_lit, size_t size);
 JsonValue parse(const std::string& json_lit);
+JsonValue parse(
+  const char* json_lit,
+  size_t size,
+  const JsonParseConfig& cfg
+);
+JsonValue parse(const std::string& json_lit, const JsonParseConfig& cfg);
 // Returns true when JSON parsing successfully finished and parsed value is
 // returned via `out`. Otherwise, false is returned and out contains incomplete
 // result.
+bool try_parse(const char* json_lit, size_t size, JsonValue& out);
 bool try_parse(const std::string& json_lit, JsonValue& out);
+// Parse JSON literal into `out`, discarding its previous content. If the JSON
+// is invalid or unsupported, `JsonException` will be raised.
+void parse(const char* json_lit, size_t size, JsonDocument& out);
+void parse(const std::string& json_lit, JsonDocument& out);
+
+struct JsonPrintConfig {
+  // Number of spaces per indentation level. JSON is printed compact without
+  // any whitespace if it's zero.
+  uint32_t indent = 0;
+};
 
+// Append printed JSON text to `out`. Reuse `out` across calls to avoid
+// repeated reallocation. Floating-point numbers are printed in the shortest
+// form that parses back to the same value.
+void print(const JsonValue& json, std::string& out, const JsonPrintConfig& cfg);
+void print(const JsonNode& json, std::string& out, const JsonPrintConfig& cfg);
+void print(
+  const JsonValue& json,
+  stream::WriteStream& out,
+  const JsonPrintConfig& cfg
+);
+void print(
+  const JsonNode& json,
+  stream::WriteStream& out,
+  const JsonPrintConfig& cfg
+);
 std::string print(const JsonValue& json);
+std::string print(const JsonNode& json);
+std::string print(const JsonDocument& doc);
+
+// Feed all events of `reader` to `handler`. Returns false if the handler
+// stopped reading before the end of input.
+bool read(JsonReader& reader, JsonSaxHandler& handler);
 
 } // namespace json
 } // namespace liong
@@ -2,13 +2,81 @@
 // @PENGUINLIONG
 #pragma once
 #include <cstdint>
+#include <cstring>
 #include <vector>
+#include <fstream>
 #include <functional>
+#include <memory>
 
 namespace liong {
+
+namespace util {
+class MappedFile;
+} // namespace util
+
 namespace stream {
 
-struct ReadStream {
+// Typed reads shared by read streams. `TStream` provides `peek_data`,
+// `extract_data` and `size_remain`.
+template<typename TStream>
+struct ReadStreamBase {
+private:
+  inline TStream& self() {
+    return *static_cast<TStream*>(this);
+  }
+
+public:
+  template<typename T>
+  inline T peek() {
+    T out {};
+    self().peek_data(&out, sizeof(T));
+    return out;
+  }
+  template<typename T>
+  inline bool try_peek(T& out) {
+    if (self().size_remain() < sizeof(T)) {
+      return false;
+    } else {
+      self().peek_data(&out, sizeof(T));
+      return true;
+    }
+  }
+  template<typename T>
+  inline T extract() {
+    T out {};
+    self().extract_data(&out, sizeof(T));
+    return out;
+  }
+  template<typename T>
+  inline bool try_extract(T& out) {
+    if (self().size_remain() < sizeof(T)) {
+      return false;
+    } else {
+      self().extract_data(&out, sizeof(T));
+      return true;
+    }
+  }
+  template<typename T>
+  std::vector<T> extract_all() {
+    std::vector<T> out {};
+    size_t n = (size_t)(self().size_remain() / sizeof(T));
+    out.resize(n);
+    self().extract_data(out.data(), n * sizeof(T));
+    return out;
+  }
+  template<typename T, typename U>
+  std::vector<U> extract_all_map(const std::function<U(const T&)>& f) {
+    std::vector<T> tmp = extract_all<T>();
+    std::vector<U> out {};
+    out.resize(tmp.size());
+    for (size_t i = 0; i < tmp.size(); ++i) {
+      out[i] = f(tmp[i]);
+    }
+    return out;
+  }
+};
+
+struct ReadStream : public ReadStreamBase<ReadStream> {
 private:
   const void* data_;
   size_t size_;
@@ -49,68 +117,152 @@ public:
   inline ReadStream& skip() {
     return skip(sizeof(T));
   }
+};
 
+struct WriteStream {
+private:
+  // Bytes beyond `size_` are allocated ahead for later appends, so the
+  // buffer grows geometrically instead of on every append.
+  std::vector<uint8_t> data_;
+  size_t size_;
 
-  template<typename T>
-  inline T peek() {
-    T out {};
-    peek_data(&out);
+  void grow(size_t min_capacity);
+
+public:
+  inline WriteStream() : data_(), size_(0) {}
+
+  inline size_t size() const {
+    return size_;
+  }
+  inline size_t capacity() const {
+    return data_.size();
+  }
+  // Data written so far. Invalidated by appends that grow the buffer.
+  inline const uint8_t* data() const {
+    return data_.data();
+  }
+
+  // Allocate room for a total of `capacity` bytes ahead of time.
+  void reserve(size_t capacity);
+  // Append `size` bytes left for the caller to write in place through the
+  // returned pointer. The content of the bytes is unspecified until then. The
+  // pointer is invalidated by the next append that grows the buffer.
+  inline uint8_t* reserve_back(size_t size) {
+    if (data_.size() - size_ < size) {
+      grow(size_ + size);
+    }
+    uint8_t* out = data_.data() + size_;
+    size_ += size;
     return out;
   }
-  template<typename T>
-  inline bool try_peek(T& out) {
-    if (size_remain() < sizeof(T)) {
-      return false;
-    } else {
-      peek_data(&out, sizeof(T));
-      return true;
+
+  inline void append_data(const void* data, size_t size) {
+    if (size == 0) {
+      return;
     }
+    std::memcpy(reserve_back(size), data, size);
   }
+
   template<typename T>
-  inline T extract() {
-    T out {};
-    extract_data(&out, sizeof(T));
-    return out;
+  inline void append(const T& x) {
+    std::memcpy(reserve_back(sizeof(T)), &x, sizeof(T));
   }
   template<typename T>
-  inline bool try_extract(T& out) {
-    if (size_remain() < sizeof(T)) {
-      return false;
-    } else {
-      extract_data(&out);
-      return true;
-    }
+  inline void append(const std::vector<T>& data) {
+    append_data(data.data(), data.size() * sizeof(T));
   }
+
+  // Overwrite bytes already appended at `offset`, e.g., to backfill a size
+  // field once the content following it is written.
+  void patch_data(size_t offset, const void* data, size_t size);
   template<typename T>
-  std::vector<T> extract_all() {
-    std::vector<T> out {};
-    size_t n = size_remain() / sizeof(T);
-    out.resize(n);
-    extract_data(out.data(), n * sizeof(T));
-    return out;
+  inline void patch(size_t offset, const T& x) {
+    patch_data(offset, &x, sizeof(T));
   }
-  template<typename T, typename U>
-  std::vector<U> extract_all_map(const std::function<U(const T&)>& f) {
-    std::vector<T> tmp {};
-    std::vector<U> out {};
-    size_t n = size_remain() / sizeof(T);
-    tmp.resize(n);
-    out.resize(n);
-    extract_data(tmp.data(), n * sizeof(T));
-    for (size_t i = 0; i < tmp.size(); ++i) {
-      out[i] = f(tmp[i]);
-    }
+
+  inline std::vector<uint8_t> take() {
+    std::vector<uint8_t> out = std::move(data_);
+    out.resize(size_);
+    data_.clear();
+    size_ = 0;
     return out;
   }
 };
 
-struct WriteStream {
+// Read stream over a file memory-mapped read-only. Pages are loaded on demand
+// and the mapping is kept alive as long as any copy of the stream.
+struct MappedReadStream : public ReadStream {
 private:
-  std::vector<uint8_t> data_;
+  std::shared_ptr<const util::MappedFile> mapped_file_;
+
+  MappedReadStream(std::shared_ptr<const util::MappedFile>&& mapped_file);
 
 public:
-  inline size_t size() const {
-    return data_.size();
+  MappedReadStream(const char* path);
+};
+
+// Read stream over a file through a fixed-size buffer, so that files of any
+// size are read in constant memory. Reads larger than the buffer bypass it.
+struct FileReadStream : public ReadStreamBase<FileReadStream> {
+private:
+  std::ifstream f_;
+  std::vector<uint8_t> buffer_;
+  // Range of `buffer_` filled with file data not extracted yet.
+  size_t buffer_offset_;
+  size_t buffer_size_;
+  uint64_t size_;
+  uint64_t offset_;
+
+  // Make sure at least `size` bytes are buffered.
+  void fill_buffer(size_t size);
+
+public:
+  FileReadStream(const char* path, size_t buffer_size = 64 * 1024);
+
+  inline uint64_t size() const {
+    return size_;
+  }
+  inline uint64_t offset() const {
+    return offset_;
+  }
+  inline uint64_t size_remain() const {
+    return size_ - offset_;
+  }
+  inline bool ate() const {
+    return size_ <= offset_;
+  }
+
+  // `size` can't exceed the buffer size.
+  void peek_data(void* out, size_t size);
+  void extract_data(void* out, size_t size);
+
+  FileReadStream& skip(uint64_t n);
+  template<typename T>
+  inline FileReadStream& skip() {
+    return skip(sizeof(T));
+  }
+};
+
+// Write stream to a file through a fixed-size buffer, so that files of any
+// size are written in constant memory. Buffered data is flushed when the
+// buffer is full, on `flush`, and on destruction.
+struct FileWriteStream {
+private:
+  std::ofstream f_;
+  std::vector<uint8_t> buffer_;
+  size_t buffer_size_;
+  uint64_t size_;
+
+public:
+  // The file is truncated if it exists.
+  FileWriteStream(const char* path, size_t buffer_size = 64 * 1024);
+  FileWriteStream(FileWriteStream&&) = default;
+  FileWriteStream& operator=(FileWriteStream&&) = default;
+  // Errors can't be reported on destruction; `flush` explicitly to check.
+  ~FileWriteStream();
+
+  inline uint64_t size() const {
+    return size_;
   }
 
   void append_data(const void* data, size_t size);
@@ -124,9 +276,7 @@ public:
     append_data(data.data(), data.size() * sizeof(T));
   }
 
-  inline std::vector<uint8_t> take() {
-    return std::move(data_);
-  }
+  void flush();
 };
 
 } // namespace stream
@@ -17,6 +17,9 @@ struct TestReport {
 struct TestRegistry {
   struct Entry {
     std::function<void()> f;
+    // Benchmarks only run on demand as they take long and report timings
+    // rather than check behaviors.
+    bool is_bench;
   };
   std::map<std::string, Entry> tests;
 
@@ -24,10 +27,16 @@ struct TestRegistry {
 
   static TestRegistry& get_inst();
   static TestReport run_all();
+  static TestReport run_all(bool should_run_benches);
 
   int reg(const std::string& name, std::function<void()>&& func);
+  int reg_bench(const std::string& name, std::function<void()>&& func);
 };
 
+// Run `f` `nrun` times and return the shortest time taken in microseconds, to
+// filter out noise in benchmarks.
+double bench_us(size_t nrun, const std::function<void()>& f);
+
 } // namespace test
 
 } // namespace liong
@@ -36,3 +45,7 @@ struct TestRegistry {
   extern void l_test_##name();\
   int L_TEST_MARKER_##name = ::liong::test::TestRegistry::get_inst().reg(#name, l_test_##name); \
   void l_test_##name()
+#define L_BENCH(name) \
+  extern void l_test_##name();\
+  int L_TEST_MARKER_##name = ::liong::test::TestRegistry::get_inst().reg_bench(#name, l_test_##name); \
+  void l_test_##name()
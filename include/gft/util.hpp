@@ -11,6 +11,13 @@
 #include <functional>
 #include <chrono>
 #include <cstring>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <memory>
+#include "gft/stream.hpp"
 
 namespace liong {
 
@@ -104,14 +111,116 @@ inline std::string format(const TArgs& ... args) {
 
 // - [File I/O] ----------------------------------------------------------------
 
+class ThreadPool;
+
+struct LoadFileConfig {
+  // Files are read in chunks of this size, in parallel on `thread_pool` if
+  // it's not null.
+  size_t chunk_size = 8 * 1024 * 1024;
+  ThreadPool* thread_pool = nullptr;
+  // Bypass the page cache with `O_DIRECT` for files read only once. Parts not
+  // meeting the alignment requirements, and file systems not supporting it,
+  // fall back to buffered reads. Ignored on Windows.
+  bool direct_io = false;
+};
+
+extern uint64_t get_file_size(const char* path);
+// The returned vector is value-initialized before the file is read into it.
+// Read into a caller-provided buffer to skip that.
 extern std::vector<uint8_t> load_file(const char* path);
+extern std::vector<uint8_t> load_file(
+  const char* path,
+  const LoadFileConfig& cfg
+);
+// Read the entire file at `path` into `out` of `out_size` bytes, which must be
+// at least the file size. Returns the file size.
+extern size_t load_file(
+  const char* path,
+  void* out,
+  size_t out_size,
+  const LoadFileConfig& cfg
+);
 extern std::string load_text(const char* path);
 extern void save_file(const char* path, const void* data, size_t size);
 extern void save_text(const char* path, const std::string& txt);
 
+// Pack RGBA colors of 32-bit floats in [0, 1] into 8-bit unsigned ints packed
+// from LSB to MSB. Out-of-range values are clamped and NaNs become zero.
+void pack_rgba8(const float* pxs, size_t npx, uint32_t* out);
+
+// Encode a top-down image of `w` by `h` pixels into the content of a bitmap
+// file.
+std::vector<uint8_t> encode_bmp(const uint32_t* pxs, uint32_t w, uint32_t h);
+std::vector<uint8_t> encode_bmp(const float* pxs, uint32_t w, uint32_t h);
 void save_bmp(const uint32_t* pxs, uint32_t w, uint32_t h, const char* path);
 void save_bmp(const float* pxs, uint32_t w, uint32_t h, const char* path);
 
+// A top-down image of 8-bit unsigned int colors with RGBA channels packed from
+// LSB to MSB in a 32-bit unsigned int.
+struct Rgba8Image {
+  uint32_t width;
+  uint32_t height;
+  std::vector<uint32_t> pxs;
+};
+
+// Encode a top-down image of `w` by `h` pixels losslessly into the content of
+// a QOI (Quite OK Image) file, usually several times smaller than a bitmap.
+std::vector<uint8_t> encode_qoi(const uint32_t* pxs, uint32_t w, uint32_t h);
+std::vector<uint8_t> encode_qoi(const float* pxs, uint32_t w, uint32_t h);
+// Decode the content of a QOI file. Images of 3 channels are opaque. Returns
+// false if the data is malformed or truncated.
+bool decode_qoi(const void* data, size_t size, Rgba8Image& out);
+void save_qoi(const uint32_t* pxs, uint32_t w, uint32_t h, const char* path);
+void save_qoi(const float* pxs, uint32_t w, uint32_t h, const char* path);
+Rgba8Image load_qoi(const char* path);
+
+// Expected access pattern of a memory-mapped file, so that the OS can read
+// ahead, or not, accordingly.
+enum MappedFileAccessHint {
+  L_MAPPED_FILE_ACCESS_HINT_NORMAL,
+  // Pages are accessed in order and can be read ahead aggressively.
+  L_MAPPED_FILE_ACCESS_HINT_SEQUENTIAL,
+  // Pages are accessed in random order so reading ahead is wasted.
+  L_MAPPED_FILE_ACCESS_HINT_RANDOM,
+  // Pages will be accessed soon and can be read in the background.
+  L_MAPPED_FILE_ACCESS_HINT_WILL_NEED,
+};
+
+// Read-only memory mapping of an entire file. Pages are loaded on demand on
+// first access, and the mapping is released on destruction.
+class MappedFile {
+  const void* data_;
+  size_t size_;
+  // File mapping object on Windows; unused elsewhere.
+  void* handle_;
+
+  void release();
+
+public:
+  inline MappedFile() : data_(nullptr), size_(0), handle_(nullptr) {}
+  MappedFile(const char* path);
+  MappedFile(const char* path, MappedFileAccessHint hint);
+  MappedFile(const MappedFile&) = delete;
+  MappedFile(MappedFile&& b);
+  MappedFile& operator=(const MappedFile&) = delete;
+  MappedFile& operator=(MappedFile&& b);
+  inline ~MappedFile() { release(); }
+
+  // Null if the file is empty.
+  inline const void* data() const { return data_; }
+  inline size_t size() const { return size_; }
+
+  // Hint the access pattern of the entire file, or of `size` bytes at
+  // `offset`. Hints are advisory and ignored where unsupported.
+  void advise(MappedFileAccessHint hint) const;
+  void advise(MappedFileAccessHint hint, size_t offset, size_t size) const;
+
+  // Read stream over the mapped data, valid as long as the mapping.
+  inline stream::ReadStream as_stream() const {
+    return stream::ReadStream(data_, size_);
+  }
+};
+
 // - [Bitfield Manipulation] ---------------------------------------------------
 
 template<typename T>
@@ -201,6 +310,155 @@ struct Timer {
 
 void sleep_for_us(uint64_t t);
 
+// - [Parallelism] -------------------------------------------------------------
+
+// A fixed set of worker threads running submitted tasks in FIFO order. Tasks
+// still queued on destruction are run before the workers are joined.
+class ThreadPool {
+  std::vector<std::thread> threads_;
+  std::deque<std::function<void()>> tasks_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool is_stopping_;
+
+  void run_worker();
+
+public:
+  // Spawn `nthread` workers, or one per hardware thread if zero.
+  ThreadPool(size_t nthread = 0);
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+  ~ThreadPool();
+
+  inline size_t nthread() const { return threads_.size(); }
+
+  void submit(std::function<void()>&& task);
+  // Call `f(i)` for each `i` in `[0, n)` and wait for all of them. The calling
+  // thread takes part in the work so it's safe to nest `parallel_for` in
+  // tasks. The first exception thrown by `f` is rethrown here.
+  void parallel_for(size_t n, const std::function<void(size_t)>& f);
+
+  // Process-wide pool with one worker per hardware thread, created on first
+  // use.
+  static ThreadPool& global();
+};
+
+inline void parallel_for(size_t n, const std::function<void(size_t)>& f) {
+  ThreadPool::global().parallel_for(n, f);
+}
+
+// - [Asynchronous I/O] --------------------------------------------------------
+
+// Called with the number of bytes transferred, which is less than requested
+// only at the end of file on reads, or a negative error code on failure.
+typedef std::function<void(int64_t)> AsyncIoCallback;
+
+struct AsyncIoConfig {
+  // Use io_uring on Linux if the kernel allows it. Otherwise, or if false,
+  // requests are served by a pool of threads doing blocking I/O.
+  bool use_io_uring = true;
+  // Maximal number of requests in flight on io_uring; submissions beyond
+  // that wait for earlier requests to complete, or are deferred if submitted
+  // from callbacks.
+  uint32_t queue_depth = 64;
+  // Number of threads doing blocking I/O without io_uring.
+  uint32_t nthread = 4;
+};
+
+class AsyncIoQueue;
+
+// Submission queue of file reads and writes completed in the background, so
+// that I/O overlaps with parsing and uploads on the calling thread. Callbacks
+// are called on an I/O thread and should be short. Buffers have to be kept
+// alive until the request completes.
+class AsyncIo {
+  std::unique_ptr<AsyncIoQueue> queue_;
+  bool is_io_uring_;
+
+public:
+  AsyncIo();
+  AsyncIo(const AsyncIoConfig& cfg);
+  AsyncIo(const AsyncIo&) = delete;
+  AsyncIo& operator=(const AsyncIo&) = delete;
+  // Wait for all requests to complete.
+  ~AsyncIo();
+
+  inline bool is_io_uring() const { return is_io_uring_; }
+
+  // Read `size` bytes at `offset` of the file at `path` into `out`.
+  void read(
+    const char* path,
+    void* out,
+    size_t size,
+    uint64_t offset,
+    AsyncIoCallback&& callback
+  );
+  std::future<int64_t> read(
+    const char* path,
+    void* out,
+    size_t size,
+    uint64_t offset
+  );
+  // Write `size` bytes of `data` at `offset` of the file at `path`, which is
+  // created if it doesn't exist. Other content of the file is kept.
+  void write(
+    const char* path,
+    const void* data,
+    size_t size,
+    uint64_t offset,
+    AsyncIoCallback&& callback
+  );
+  std::future<int64_t> write(
+    const char* path,
+    const void* data,
+    size_t size,
+    uint64_t offset
+  );
+
+  // Asynchronous counterparts of `util::load_file` and `util::save_file`.
+  // Failures are rethrown from the futures.
+  std::future<std::vector<uint8_t>> load_file(const char* path);
+  std::future<void> save_file(const char* path, const void* data, size_t size);
+};
+
+struct AsyncBmpWriterConfig {
+  // Maximal number of frames being written. Saving more frames waits for the
+  // earliest one to be written, which bounds the memory in use when frames
+  // are produced faster than the disk accepts them.
+  uint32_t max_nframe_in_flight = 4;
+  AsyncIoConfig io_cfg {};
+};
+
+// Dump sequences of frames to bitmap files in the background. Frames are
+// encoded on the calling thread, which is as cheap as copying them, so the
+// pixels can be reused as soon as `save_bmp` returns.
+class AsyncBmpWriter {
+  struct Frame {
+    std::vector<uint8_t> data;
+    std::future<void> future;
+  };
+
+  AsyncIo aio_;
+  uint32_t max_nframe_in_flight_;
+  std::deque<Frame> frames_;
+
+  std::vector<uint8_t> acquire_frame_data();
+  void push_frame(std::vector<uint8_t>&& data, const char* path);
+
+public:
+  AsyncBmpWriter();
+  AsyncBmpWriter(const AsyncBmpWriterConfig& cfg);
+  AsyncBmpWriter(const AsyncBmpWriter&) = delete;
+  AsyncBmpWriter& operator=(const AsyncBmpWriter&) = delete;
+  // Wait for all frames to be written. Failures are dropped.
+  ~AsyncBmpWriter();
+
+  void save_bmp(const uint32_t* pxs, uint32_t w, uint32_t h, const char* path);
+  void save_bmp(const float* pxs, uint32_t w, uint32_t h, const char* path);
+  // Wait for all frames to be written, rethrowing the first failure.
+  void wait();
+};
+
 // - [Index & Size Manipulation] -----------------------------------------------
 
 constexpr size_t div_down(size_t x, size_t align) {
@@ -228,6 +486,21 @@ constexpr size_t pop_idx(size_t& aggr_idx, size_t dim_size) {
 // - [CRC32] -------------------------------------------------------------------
 
 uint32_t crc32(const void* data, size_t size);
+// Continue the crc32 of preceding data with `data`. `crc` is the crc32 of the
+// preceding data, or 0 at the beginning.
+uint32_t crc32_update(uint32_t crc, const void* data, size_t size);
+// Crc32 of the concatenation of two pieces of data, given the crc32 of each,
+// and the size of the second piece.
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t size2);
+// Crc32 of `data` split into chunks checksummed in parallel on `thread_pool`,
+// or the global pool if not given, and then combined. Small data is
+// checksummed on the calling thread.
+uint32_t crc32_parallel(const void* data, size_t size);
+uint32_t crc32_parallel(
+  const void* data,
+  size_t size,
+  ThreadPool& thread_pool
+);
 
 } // namespace util
 
@@ -1,34 +1,164 @@
-// Uncompressed Zip archive I/O.
+// Zip archive I/O.
 // @PENGUINLIONG
 #pragma once
+#include <functional>
+#include <memory>
 #include <string>
 #include <vector>
 #include <map>
+#include "gft/util.hpp"
 
 namespace liong {
 namespace zip {
 
+enum ZipCompressionMethod {
+  L_ZIP_COMPRESSION_METHOD_STORE = 0,
+  L_ZIP_COMPRESSION_METHOD_DEFLATE = 8,
+};
+
 struct ZipFileRecord {
   std::string file_name;
+  // File data of `size` bytes, or null if the record is compressed. Use
+  // `ZipArchive::extract` to get decompressed content.
   const void* data;
   size_t size;
   uint32_t crc32;
+  ZipCompressionMethod compression_method;
+  // File data of `compressed_size` bytes as stored in the archive. The same as
+  // `data` for stored records.
+  const void* compressed_data;
+  size_t compressed_size;
+  // Offset of the local file header from the beginning of the archive.
+  size_t local_header_offset;
+  // False if the record was parsed from the central directory and its local
+  // file header is yet to be validated. `data` and `compressed_data` are null
+  // until then.
+  bool is_validated;
+};
+
+struct ZipParseConfig {
+  // Only read the central directory, located from the end of the archive,
+  // instead of walking through all local file headers. Each local file header
+  // is validated, and the record data located, on first access with
+  // `ZipArchive::get_file` or `ZipArchive::validate_record`.
+  bool central_directory_only = false;
+};
+
+struct ZipWriteConfig {
+  // DEFLATE compression level from 1 to 9 of stored records; 0 keeps them
+  // stored. Records already compressed are copied as is, and so are records
+  // that don't get any smaller.
+  uint32_t level = 0;
+  // Records are compressed in parallel on this pool, or the global pool if
+  // null.
+  util::ThreadPool* thread_pool = nullptr;
+  // Always write Zip64 extra fields and end of central directory records.
+  // Otherwise they are only written for sizes and offsets over 4GB, or
+  // archives of more than 65534 records.
+  bool force_zip64 = false;
 };
 
 struct ZipArchive {
   std::vector<ZipFileRecord> records;
   std::map<std::string, size_t> file_name2irecord;
+  // Mapping of the archive file opened with `open_mmap`, shared by copies of
+  // the archive so that `records` stay valid as long as any of them is alive.
+  std::shared_ptr<util::MappedFile> mapped_file;
+  // Archive data parsed with `ZipParseConfig::central_directory_only`, to
+  // validate local file headers lazily.
+  const uint8_t* archive_data = nullptr;
+  size_t archive_size = 0;
 
   static ZipArchive from_bytes(const uint8_t* data, size_t size);
   static ZipArchive from_bytes(const std::vector<uint8_t>& out);
+  static ZipArchive from_bytes(
+    const uint8_t* data,
+    size_t size,
+    const ZipParseConfig& cfg
+  );
+  // Memory-map the archive file at `path` read-only. Records are zero-copy
+  // views into the mapping so only the pages actually accessed are read. Only
+  // the central directory is read unless specified otherwise in `cfg`.
+  static ZipArchive open_mmap(const char* path);
+  static ZipArchive open_mmap(const char* path, const ZipParseConfig& cfg);
+
+  // Validate the local file header of a record parsed with
+  // `ZipParseConfig::central_directory_only` and locate its data. Returns
+  // false if the record is corrupted. Validated records are skipped.
+  bool validate_record(size_t irecord);
+  // Validate the record on first access. Throws if the record is corrupted.
+  const ZipFileRecord& get_file(const std::string& file_name);
+  // Only records already validated can be accessed through a const archive;
+  // throws otherwise.
+  const ZipFileRecord& get_file(const std::string& file_name) const;
 
-  inline const ZipFileRecord& get_file(const std::string& file_name) const {
-    return records.at(file_name2irecord.at(file_name));
+  // Decompress the file data of a record into `out` and check its crc32.
+  // Returns false if the data is corrupted.
+  bool extract(size_t irecord, std::vector<uint8_t>& out);
+  inline bool extract_file(
+    const std::string& file_name,
+    std::vector<uint8_t>& out
+  ) {
+    return extract(file_name2irecord.at(file_name), out);
   }
 
   // `data` has to be kept alive through out the archive's lifetime.
   void add_file(const std::string& file_name, const void* data, size_t size);
   void to_bytes(std::vector<uint8_t>& out) const;
+  void to_bytes(std::vector<uint8_t>& out, const ZipWriteConfig& cfg) const;
+};
+
+// Write a zip archive to a sink entry by entry as they are added, so that file
+// data doesn't have to be kept alive until the whole archive is serialized.
+// Only central directory metadata is kept in memory, and it's written on
+// `finish`; the archive is incomplete until then. Entries are written in
+// order, and `ZipWriteConfig::thread_pool` only checksums large entries.
+class ZipStreamWriter {
+public:
+  // Receives archive data in order.
+  typedef std::function<void(const void* data, size_t size)> Sink;
+
+private:
+  Sink sink_;
+  ZipWriteConfig cfg_;
+  // Records with null `data` for the central directory.
+  std::vector<ZipFileRecord> records_;
+  // Whether the local file header of each record is followed by a data
+  // descriptor, and sizes are thus 64-bit.
+  std::vector<bool> has_data_descriptor_;
+  // Number of bytes written to the sink so far.
+  uint64_t offset_;
+  bool is_file_open_;
+  bool is_finished_;
+
+  void write(const void* data, size_t size);
+
+public:
+  ZipStreamWriter(Sink&& sink);
+  ZipStreamWriter(Sink&& sink, const ZipWriteConfig& cfg);
+  // Write to the file at `path`, truncated if it exists.
+  ZipStreamWriter(const char* path);
+  ZipStreamWriter(const char* path, const ZipWriteConfig& cfg);
+  ZipStreamWriter(const ZipStreamWriter&) = delete;
+  ZipStreamWriter& operator=(const ZipStreamWriter&) = delete;
+
+  inline const std::vector<ZipFileRecord>& records() const { return records_; }
+  // Number of bytes written so far.
+  inline uint64_t size() const { return offset_; }
+
+  // Write a file entry at once. `data` is no longer needed on return. The data
+  // is compressed if `ZipWriteConfig::level` is non-zero.
+  void add_file(const std::string& file_name, const void* data, size_t size);
+
+  // Write a file entry of unknown size in pieces with `append_file_data`,
+  // followed by a data descriptor on `end_file`. The data is stored
+  // uncompressed.
+  void begin_file(const std::string& file_name);
+  void append_file_data(const void* data, size_t size);
+  void end_file();
+
+  // Write the central directory. No more entries can be added afterwards.
+  void finish();
 };
 
 } // namespace zip
@@ -0,0 +1,326 @@
+// CBOR (RFC 8949) binary encoding.
+// @PENGUINLIONG
+#include <cmath>
+#include <cstring>
+#include "gft/cbor.hpp"
+
+namespace liong {
+namespace cbor {
+
+CborException::CborException(const char* msg) : msg(msg) {}
+const char* CborException::what() const noexcept {
+  return msg.c_str();
+}
+
+// Simple values and floating-point numbers of major type 7.
+enum CborSimple {
+  L_CBOR_SIMPLE_FALSE = 20,
+  L_CBOR_SIMPLE_TRUE = 21,
+  L_CBOR_SIMPLE_NULL = 22,
+  L_CBOR_SIMPLE_FLOAT16 = 25,
+  L_CBOR_SIMPLE_FLOAT32 = 26,
+  L_CBOR_SIMPLE_FLOAT64 = 27,
+};
+
+inline bool is_host_little_endian() {
+  const uint16_t x = 1;
+  return *(const uint8_t*)&x == 1;
+}
+
+uint64_t typed_array_tag(size_t elem_size, bool is_float, bool is_signed) {
+  // The tag number is `0b010_f_s_e_ll` where `f` marks floating-point
+  // numbers, `s` marks signed integers, `e` marks little-endian, and `ll` is
+  // the log2 of element size (minus one for floating-point numbers).
+  uint64_t ll;
+  switch (elem_size) {
+  case 1: ll = 0; break;
+  case 2: ll = 1; break;
+  case 4: ll = 2; break;
+  case 8: ll = 3; break;
+  default: throw CborException("unsupported typed array element size");
+  }
+  uint64_t out = 64;
+  if (is_float) {
+    if (ll == 0) {
+      throw CborException("unsupported typed array element size");
+    }
+    out |= 16 | (ll - 1);
+  } else {
+    out |= (is_signed ? 8 : 0) | ll;
+  }
+  // Endianness is meaningless for single-byte elements; the bit is reused for
+  // clamped arithmetic there.
+  if (elem_size > 1 && is_host_little_endian()) {
+    out |= 4;
+  }
+  return out;
+}
+
+
+
+void CborWriter::write_head(CborMajorType major, uint64_t arg) {
+  uint8_t buf[9];
+  size_t n;
+  uint8_t major_bits = (uint8_t)(major << 5);
+  if (arg < 24) {
+    buf[0] = major_bits | (uint8_t)arg;
+    n = 1;
+  } else if (arg <= UINT8_MAX) {
+    buf[0] = major_bits | 24;
+    n = 2;
+  } else if (arg <= UINT16_MAX) {
+    buf[0] = major_bits | 25;
+    n = 3;
+  } else if (arg <= UINT32_MAX) {
+    buf[0] = major_bits | 26;
+    n = 5;
+  } else {
+    buf[0] = major_bits | 27;
+    n = 9;
+  }
+  // Arguments are big-endian.
+  for (size_t i = n - 1; i > 0; --i) {
+    buf[i] = (uint8_t)arg;
+    arg >>= 8;
+  }
+  out.append_data(buf, n);
+}
+
+void CborWriter::write_null() {
+  out.append<uint8_t>((L_CBOR_MAJOR_SIMPLE << 5) | L_CBOR_SIMPLE_NULL);
+}
+void CborWriter::write_bool(bool x) {
+  out.append<uint8_t>((L_CBOR_MAJOR_SIMPLE << 5) |
+    (x ? L_CBOR_SIMPLE_TRUE : L_CBOR_SIMPLE_FALSE));
+}
+void CborWriter::write_uint(uint64_t x) {
+  write_head(L_CBOR_MAJOR_UINT, x);
+}
+void CborWriter::write_int(int64_t x) {
+  if (x >= 0) {
+    write_head(L_CBOR_MAJOR_UINT, (uint64_t)x);
+  } else {
+    // Negative integers are encoded as `-1 - arg`.
+    write_head(L_CBOR_MAJOR_NEGINT, ~(uint64_t)x);
+  }
+}
+void CborWriter::write_float(float x) {
+  uint32_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  uint8_t buf[5] = {
+    (L_CBOR_MAJOR_SIMPLE << 5) | L_CBOR_SIMPLE_FLOAT32,
+    (uint8_t)(bits >> 24), (uint8_t)(bits >> 16), (uint8_t)(bits >> 8),
+    (uint8_t)bits,
+  };
+  out.append_data(buf, sizeof(buf));
+}
+void CborWriter::write_double(double x) {
+  uint64_t bits;
+  std::memcpy(&bits, &x, sizeof(bits));
+  uint8_t buf[9];
+  buf[0] = (L_CBOR_MAJOR_SIMPLE << 5) | L_CBOR_SIMPLE_FLOAT64;
+  for (size_t i = 8; i > 0; --i) {
+    buf[i] = (uint8_t)bits;
+    bits >>= 8;
+  }
+  out.append_data(buf, sizeof(buf));
+}
+void CborWriter::write_text(std::string_view x) {
+  write_head(L_CBOR_MAJOR_TEXT, x.size());
+  if (!x.empty()) {
+    out.append_data(x.data(), x.size());
+  }
+}
+void CborWriter::write_bytes(const void* data, size_t size) {
+  write_head(L_CBOR_MAJOR_BYTES, size);
+  if (size > 0) {
+    out.append_data(data, size);
+  }
+}
+
+
+
+// Decode the argument of `head` following the initial byte at `data`, returns
+// the number of bytes taken by the head.
+size_t decode_head(const uint8_t* data, size_t size, CborHead& head) {
+  if (size == 0) {
+    throw CborException("unexpected end of data");
+  }
+  head.major = (CborMajorType)(data[0] >> 5);
+  head.info = data[0] & 0x1F;
+  size_t narg_byte;
+  if (head.info < 24) {
+    head.arg = head.info;
+    return 1;
+  } else if (head.info < 28) {
+    narg_byte = (size_t)1 << (head.info - 24);
+  } else if (head.info == 31) {
+    throw CborException("indefinite-length data item is not supported");
+  } else {
+    throw CborException("malformed data item head");
+  }
+  if (size < 1 + narg_byte) {
+    throw CborException("unexpected end of data");
+  }
+  head.arg = 0;
+  for (size_t i = 1; i <= narg_byte; ++i) {
+    head.arg = (head.arg << 8) | data[i];
+  }
+  return 1 + narg_byte;
+}
+
+CborHead CborReader::peek_head() {
+  CborHead out;
+  decode_head((const uint8_t*)in.pos(), in.size_remain(), out);
+  return out;
+}
+CborHead CborReader::read_head() {
+  CborHead out;
+  in.skip(decode_head((const uint8_t*)in.pos(), in.size_remain(), out));
+  return out;
+}
+uint64_t CborReader::read_head(CborMajorType major) {
+  CborHead head = read_head();
+  if (head.major != major) {
+    throw CborException("unexpected data item type");
+  }
+  return head.arg;
+}
+
+bool CborReader::try_read_null() {
+  if (in.size_remain() > 0 &&
+    *(const uint8_t*)in.pos() == ((L_CBOR_MAJOR_SIMPLE << 5) | L_CBOR_SIMPLE_NULL))
+  {
+    in.skip(1);
+    return true;
+  }
+  return false;
+}
+bool CborReader::read_bool() {
+  CborHead head = read_head();
+  if (head.major == L_CBOR_MAJOR_SIMPLE) {
+    if (head.info == L_CBOR_SIMPLE_TRUE) {
+      return true;
+    } else if (head.info == L_CBOR_SIMPLE_FALSE) {
+      return false;
+    }
+  }
+  throw CborException("data item is not a bool");
+}
+uint64_t CborReader::read_uint() {
+  CborHead head = read_head();
+  if (head.major != L_CBOR_MAJOR_UINT) {
+    throw CborException("data item is not an unsigned integer");
+  }
+  return head.arg;
+}
+int64_t CborReader::read_int() {
+  CborHead head = read_head();
+  if (head.major == L_CBOR_MAJOR_UINT) {
+    return (int64_t)head.arg;
+  } else if (head.major == L_CBOR_MAJOR_NEGINT) {
+    return (int64_t)~head.arg;
+  } else {
+    throw CborException("data item is not an integer");
+  }
+}
+double CborReader::read_double() {
+  CborHead head = read_head();
+  switch (head.major) {
+  case L_CBOR_MAJOR_UINT:
+    return (double)head.arg;
+  case L_CBOR_MAJOR_NEGINT:
+    return (double)(int64_t)~head.arg;
+  case L_CBOR_MAJOR_SIMPLE:
+    if (head.info == L_CBOR_SIMPLE_FLOAT64) {
+      double out;
+      std::memcpy(&out, &head.arg, sizeof(out));
+      return out;
+    } else if (head.info == L_CBOR_SIMPLE_FLOAT32) {
+      uint32_t bits = (uint32_t)head.arg;
+      float out;
+      std::memcpy(&out, &bits, sizeof(out));
+      return out;
+    } else if (head.info == L_CBOR_SIMPLE_FLOAT16) {
+      // Half-precision numbers are not emitted by `CborWriter` but are
+      // commonly used by other encoders.
+      uint32_t exp = (head.arg >> 10) & 0x1F;
+      uint32_t mant = head.arg & 0x3FF;
+      double out;
+      if (exp == 0) {
+        out = std::ldexp((double)mant, -24);
+      } else if (exp != 31) {
+        out = std::ldexp((double)(mant + 1024), (int)exp - 25);
+      } else {
+        out = mant == 0 ? INFINITY : NAN;
+      }
+      return (head.arg & 0x8000) ? -out : out;
+    }
+    break;
+  default:
+    break;
+  }
+  throw CborException("data item is not a number");
+}
+std::string_view CborReader::read_text() {
+  uint64_t size = read_head(L_CBOR_MAJOR_TEXT);
+  if (size > in.size_remain()) {
+    throw CborException("unexpected end of data");
+  }
+  std::string_view out((const char*)in.pos(), (size_t)size);
+  in.skip((size_t)size);
+  return out;
+}
+std::string_view CborReader::read_bytes() {
+  uint64_t size = read_head(L_CBOR_MAJOR_BYTES);
+  if (size > in.size_remain()) {
+    throw CborException("unexpected end of data");
+  }
+  std::string_view out((const char*)in.pos(), (size_t)size);
+  in.skip((size_t)size);
+  return out;
+}
+
+void CborReader::skip_value() {
+  // Number of data items left to skip. Nested items are counted instead of
+  // recursed into so that deeply nested input cannot overflow the stack.
+  uint64_t nitem = 1;
+  while (nitem > 0) {
+    CborHead head = read_head();
+    --nitem;
+    switch (head.major) {
+    case L_CBOR_MAJOR_BYTES:
+    case L_CBOR_MAJOR_TEXT:
+      if (head.arg > in.size_remain()) {
+        throw CborException("unexpected end of data");
+      }
+      in.skip((size_t)head.arg);
+      break;
+    case L_CBOR_MAJOR_ARRAY:
+    case L_CBOR_MAJOR_MAP:
+    {
+      // Every data item takes at least one byte. `head.arg` is checked first
+      // so the number of map children can't overflow.
+      if (head.arg > in.size_remain()) {
+        throw CborException("unexpected end of data");
+      }
+      uint64_t nchild = head.major == L_CBOR_MAJOR_ARRAY ?
+        head.arg : head.arg * 2;
+      if (nchild > in.size_remain()) {
+        throw CborException("unexpected end of data");
+      }
+      nitem += nchild;
+      break;
+    }
+    case L_CBOR_MAJOR_TAG:
+      // The argument is the tag number; the tagged item follows.
+      nitem += 1;
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+} // namespace cbor
+} // namespace liong
@@ -0,0 +1,1186 @@
+// DEFLATE (RFC 1951) compressed data format.
+// @PENGUINLIONG
+#include <algorithm>
+#include <cstring>
+#include <memory>
+#include "gft/log.hpp"
+#include "gft/deflate.hpp"
+
+namespace liong {
+namespace deflate {
+
+// Kind of the decoded result of a Huffman table entry.
+enum HuffmanEntryKind {
+  L_HUFFMAN_ENTRY_KIND_INVALID = 0,
+  L_HUFFMAN_ENTRY_KIND_LITERAL = 1,
+  L_HUFFMAN_ENTRY_KIND_LENGTH = 2,
+  L_HUFFMAN_ENTRY_KIND_END_OF_BLOCK = 3,
+  L_HUFFMAN_ENTRY_KIND_DISTANCE = 4,
+  L_HUFFMAN_ENTRY_KIND_SUBTABLE = 5,
+};
+
+// A Huffman table entry packs everything needed to act on a decoded symbol so
+// that a single lookup is taken for most codes:
+//
+// - Bits 0-3: Length of the code in bits;
+// - Bits 4-7: Number of extra bits following the code;
+// - Bits 8-15: Entry kind;
+// - Bits 16-31: Literal byte, base length, base distance or subtable offset.
+//
+// The table is indexed by the next `table_bits` bits of input. Codes longer
+// than that are resolved by a second lookup into a subtable; the primary entry
+// then stores the subtable offset and uses the extra bits field for the
+// subtable index width.
+constexpr uint32_t make_entry(
+  HuffmanEntryKind kind,
+  uint32_t value,
+  uint32_t nextra,
+  uint32_t code_len
+) {
+  return (value << 16) | ((uint32_t)kind << 8) | (nextra << 4) | code_len;
+}
+inline uint32_t entry_code_len(uint32_t e) {
+  return e & 0xF;
+}
+inline uint32_t entry_nextra(uint32_t e) {
+  return (e >> 4) & 0xF;
+}
+inline HuffmanEntryKind entry_kind(uint32_t e) {
+  return (HuffmanEntryKind)((e >> 8) & 0xFF);
+}
+inline uint32_t entry_value(uint32_t e) {
+  return e >> 16;
+}
+
+constexpr uint32_t MAX_CODE_LEN = 15;
+constexpr uint32_t NLITLEN_SYMBOL = 288;
+constexpr uint32_t NDIST_SYMBOL = 32;
+constexpr uint32_t NCODE_LEN_SYMBOL = 19;
+
+constexpr uint32_t LITLEN_TABLE_BITS = 10;
+constexpr uint32_t DIST_TABLE_BITS = 8;
+constexpr uint32_t CODE_LEN_TABLE_BITS = 7;
+// Each subtable holds at least one code so there can't be more subtables than
+// symbols.
+constexpr size_t LITLEN_TABLE_SIZE = ((size_t)1 << LITLEN_TABLE_BITS) +
+  ((size_t)NLITLEN_SYMBOL << (MAX_CODE_LEN - LITLEN_TABLE_BITS));
+constexpr size_t DIST_TABLE_SIZE = ((size_t)1 << DIST_TABLE_BITS) +
+  ((size_t)NDIST_SYMBOL << (MAX_CODE_LEN - DIST_TABLE_BITS));
+constexpr size_t CODE_LEN_TABLE_SIZE = (size_t)1 << CODE_LEN_TABLE_BITS;
+
+constexpr uint16_t LENGTH_BASES[] = {
+  3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67,
+  83, 99, 115, 131, 163, 195, 227, 258,
+};
+constexpr uint8_t LENGTH_NEXTRAS[] = {
+  0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5,
+  5, 5, 5, 0,
+};
+constexpr uint16_t DIST_BASES[] = {
+  1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513,
+  769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577,
+};
+constexpr uint8_t DIST_NEXTRAS[] = {
+  0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10,
+  11, 11, 12, 12, 13, 13,
+};
+// Order in which code length code lengths are stored in a dynamic block
+// header.
+constexpr uint8_t CODE_LEN_ORDER[NCODE_LEN_SYMBOL] = {
+  16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15,
+};
+
+// Decoded results of each symbol without the code length.
+struct SymbolEntries {
+  uint32_t litlen[NLITLEN_SYMBOL];
+  uint32_t dist[NDIST_SYMBOL];
+  uint32_t code_len[NCODE_LEN_SYMBOL];
+
+  SymbolEntries() {
+    for (uint32_t i = 0; i < 256; ++i) {
+      litlen[i] = make_entry(L_HUFFMAN_ENTRY_KIND_LITERAL, i, 0, 0);
+    }
+    litlen[256] = make_entry(L_HUFFMAN_ENTRY_KIND_END_OF_BLOCK, 0, 0, 0);
+    for (uint32_t i = 0; i < 29; ++i) {
+      litlen[257 + i] = make_entry(L_HUFFMAN_ENTRY_KIND_LENGTH,
+        LENGTH_BASES[i], LENGTH_NEXTRAS[i], 0);
+    }
+    litlen[286] = make_entry(L_HUFFMAN_ENTRY_KIND_INVALID, 0, 0, 0);
+    litlen[287] = make_entry(L_HUFFMAN_ENTRY_KIND_INVALID, 0, 0, 0);
+    for (uint32_t i = 0; i < 30; ++i) {
+      dist[i] = make_entry(L_HUFFMAN_ENTRY_KIND_DISTANCE,
+        DIST_BASES[i], DIST_NEXTRAS[i], 0);
+    }
+    dist[30] = make_entry(L_HUFFMAN_ENTRY_KIND_INVALID, 0, 0, 0);
+    dist[31] = make_entry(L_HUFFMAN_ENTRY_KIND_INVALID, 0, 0, 0);
+    for (uint32_t i = 0; i < NCODE_LEN_SYMBOL; ++i) {
+      code_len[i] = make_entry(L_HUFFMAN_ENTRY_KIND_LITERAL, i, 0, 0);
+    }
+  }
+};
+static const SymbolEntries SYMBOL_ENTRIES {};
+
+inline uint32_t reverse_bits(uint32_t code, uint32_t len) {
+  uint32_t out = 0;
+  for (uint32_t i = 0; i < len; ++i) {
+    out = (out << 1) | (code & 1);
+    code >>= 1;
+  }
+  return out;
+}
+
+// Build a decode table of the canonical Huffman code of `code_lens`. Incomplete
+// codes are accepted and the unused entries are marked invalid; that's only
+// an error if the stream actually refers to them.
+bool build_huffman_table(
+  const uint8_t* code_lens,
+  uint32_t nsym,
+  const uint32_t* sym_entries,
+  uint32_t table_bits,
+  uint32_t* table
+) {
+  uint32_t counts[MAX_CODE_LEN + 1] {};
+  for (uint32_t i = 0; i < nsym; ++i) {
+    ++counts[code_lens[i]];
+  }
+  counts[0] = 0;
+
+  int32_t nleft = 1;
+  uint32_t next_codes[MAX_CODE_LEN + 1] {};
+  for (uint32_t len = 1; len <= MAX_CODE_LEN; ++len) {
+    nleft = (nleft << 1) - (int32_t)counts[len];
+    if (nleft < 0) {
+      L_ERROR("over-subscribed huffman code");
+      return false;
+    }
+    next_codes[len] = (next_codes[len - 1] + counts[len - 1]) << 1;
+  }
+
+  // Codes are stored from the most significant bit while the bit stream is
+  // consumed from the least significant bit, so tables are indexed with
+  // bit-reversed codes.
+  const uint32_t table_size = 1u << table_bits;
+  const uint32_t table_mask = table_size - 1;
+  uint16_t rev_codes[NLITLEN_SYMBOL];
+  uint8_t subtable_bits[1u << LITLEN_TABLE_BITS] {};
+  for (uint32_t i = 0; i < nsym; ++i) {
+    uint32_t len = code_lens[i];
+    if (len == 0) { continue; }
+    uint32_t rev_code = reverse_bits(next_codes[len]++, len);
+    rev_codes[i] = (uint16_t)rev_code;
+    if (len > table_bits) {
+      uint8_t& nbit = subtable_bits[rev_code & table_mask];
+      nbit = std::max<uint8_t>(nbit, (uint8_t)(len - table_bits));
+    }
+  }
+
+  std::fill(table, table + table_size,
+    make_entry(L_HUFFMAN_ENTRY_KIND_INVALID, 0, 0, 0));
+  uint32_t subtable_offset = table_size;
+  for (uint32_t i = 0; i < table_size; ++i) {
+    uint32_t nbit = subtable_bits[i];
+    if (nbit == 0) { continue; }
+    table[i] = make_entry(L_HUFFMAN_ENTRY_KIND_SUBTABLE, subtable_offset,
+      nbit, table_bits);
+    std::fill(table + subtable_offset, table + subtable_offset + (1u << nbit),
+      make_entry(L_HUFFMAN_ENTRY_KIND_INVALID, 0, 0, 0));
+    subtable_offset += 1u << nbit;
+  }
+
+  for (uint32_t i = 0; i < nsym; ++i) {
+    uint32_t len = code_lens[i];
+    if (len == 0) { continue; }
+    uint32_t entry = sym_entries[i] | len;
+    uint32_t rev_code = rev_codes[i];
+    if (len <= table_bits) {
+      for (uint32_t j = rev_code; j < table_size; j += 1u << len) {
+        table[j] = entry;
+      }
+    } else {
+      uint32_t subtable_entry = table[rev_code & table_mask];
+      uint32_t* subtable = table + entry_value(subtable_entry);
+      uint32_t subtable_size = 1u << entry_nextra(subtable_entry);
+      for (uint32_t j = rev_code >> table_bits; j < subtable_size;
+        j += 1u << (len - table_bits))
+      {
+        subtable[j] = entry;
+      }
+    }
+  }
+  return true;
+}
+
+inline uint64_t load_le64(const uint8_t* data) {
+  uint64_t out = 0;
+  for (size_t i = 0; i < 8; ++i) {
+    out |= (uint64_t)data[i] << (i * 8);
+  }
+  return out;
+}
+
+struct Inflater {
+  const uint8_t* in;
+  const uint8_t* in_end;
+  uint8_t* out_beg;
+  uint8_t* out;
+  uint8_t* out_end;
+
+  // Bits not yet consumed are at the low end of `bit_buf`. Bytes past the end
+  // of input are read as zeros and counted in `npad` so that the hot path
+  // needs no bounds checks; truncation is detected once the padding is
+  // actually consumed.
+  uint64_t bit_buf;
+  uint32_t nbit;
+  size_t npad;
+
+  std::unique_ptr<uint32_t[]> litlen_table;
+  std::unique_ptr<uint32_t[]> dist_table;
+  uint32_t code_len_table[CODE_LEN_TABLE_SIZE];
+  bool has_fixed_tables;
+
+  Inflater(const void* data, size_t size, void* out, size_t out_size) :
+    in((const uint8_t*)data),
+    in_end((const uint8_t*)data + size),
+    out_beg((uint8_t*)out),
+    out((uint8_t*)out),
+    out_end((uint8_t*)out + out_size),
+    bit_buf(0),
+    nbit(0),
+    npad(0),
+    litlen_table(new uint32_t[LITLEN_TABLE_SIZE]),
+    dist_table(new uint32_t[DIST_TABLE_SIZE]),
+    has_fixed_tables(false) {}
+
+  // Ensure there are at least 56 bits in the bit buffer. That's enough for a
+  // length code, a distance code and their extra bits all together.
+  inline void refill() {
+    if (in_end - in >= 8) {
+      // Bits above `nbit` are either zero or exactly the bits of the next
+      // input byte, so it's safe to over-read and or them again later.
+      bit_buf |= load_le64(in) << nbit;
+      in += (63 - nbit) >> 3;
+      nbit |= 56;
+    } else {
+      while (nbit < 56) {
+        uint64_t byte = 0;
+        if (in < in_end) {
+          byte = *in++;
+        } else {
+          ++npad;
+        }
+        bit_buf |= byte << nbit;
+        nbit += 8;
+      }
+    }
+  }
+  inline uint32_t peek_bits(uint32_t n) const {
+    return (uint32_t)(bit_buf & (((uint64_t)1 << n) - 1));
+  }
+  inline void consume_bits(uint32_t n) {
+    bit_buf >>= n;
+    nbit -= n;
+  }
+  inline uint32_t extract_bits(uint32_t n) {
+    uint32_t out = peek_bits(n);
+    consume_bits(n);
+    return out;
+  }
+  inline bool is_overrun() const {
+    return npad * 8 > nbit;
+  }
+
+  inline uint32_t decode(const uint32_t* table, uint32_t table_bits) {
+    uint32_t entry = table[peek_bits(table_bits)];
+    if (entry_kind(entry) == L_HUFFMAN_ENTRY_KIND_SUBTABLE) {
+      uint32_t isubentry = (uint32_t)(bit_buf >> table_bits) &
+        ((1u << entry_nextra(entry)) - 1);
+      entry = table[entry_value(entry) + isubentry];
+    }
+    consume_bits(entry_code_len(entry));
+    return entry;
+  }
+
+  bool inflate_stored_block() {
+    // Return whole bytes left in the bit buffer to the input.
+    consume_bits(nbit & 7);
+    size_t nbuf_byte = nbit / 8;
+    if (npad > nbuf_byte) {
+      L_ERROR("unexpected end of deflate stream");
+      return false;
+    }
+    in -= nbuf_byte - npad;
+    bit_buf = 0;
+    nbit = 0;
+    npad = 0;
+
+    if (in_end - in < 4) {
+      L_ERROR("unexpected end of deflate stream");
+      return false;
+    }
+    uint16_t len = (uint16_t)(in[0] | (in[1] << 8));
+    uint16_t nlen = (uint16_t)(in[2] | (in[3] << 8));
+    in += 4;
+    if (len != (uint16_t)~nlen) {
+      L_ERROR("corrupted deflate stored block length");
+      return false;
+    }
+    if ((size_t)(in_end - in) < len) {
+      L_ERROR("unexpected end of deflate stream");
+      return false;
+    }
+    if ((size_t)(out_end - out) < len) {
+      L_ERROR("deflate stream decompressed to more data than expected");
+      return false;
+    }
+    if (len > 0) {
+      std::memcpy(out, in, len);
+    }
+    in += len;
+    out += len;
+    return true;
+  }
+
+  bool build_fixed_tables() {
+    if (has_fixed_tables) { return true; }
+    uint8_t code_lens[NLITLEN_SYMBOL + NDIST_SYMBOL];
+    std::fill(code_lens, code_lens + 144, 8);
+    std::fill(code_lens + 144, code_lens + 256, 9);
+    std::fill(code_lens + 256, code_lens + 280, 7);
+    std::fill(code_lens + 280, code_lens + 288, 8);
+    std::fill(code_lens + 288, code_lens + 320, 5);
+    bool out = true;
+    out &= build_huffman_table(code_lens, NLITLEN_SYMBOL,
+      SYMBOL_ENTRIES.litlen, LITLEN_TABLE_BITS, litlen_table.get());
+    out &= build_huffman_table(code_lens + NLITLEN_SYMBOL, NDIST_SYMBOL,
+      SYMBOL_ENTRIES.dist, DIST_TABLE_BITS, dist_table.get());
+    has_fixed_tables = out;
+    return out;
+  }
+
+  bool build_dynamic_tables() {
+    has_fixed_tables = false;
+
+    refill();
+    uint32_t nlitlen = extract_bits(5) + 257;
+    uint32_t ndist = extract_bits(5) + 1;
+    uint32_t ncode_len = extract_bits(4) + 4;
+    if (nlitlen > 286 || ndist > 30) {
+      L_ERROR("too many huffman codes in deflate block header");
+      return false;
+    }
+
+    uint8_t code_len_code_lens[NCODE_LEN_SYMBOL] {};
+    for (uint32_t i = 0; i < ncode_len; ++i) {
+      refill();
+      code_len_code_lens[CODE_LEN_ORDER[i]] = (uint8_t)extract_bits(3);
+    }
+    if (!build_huffman_table(code_len_code_lens, NCODE_LEN_SYMBOL,
+      SYMBOL_ENTRIES.code_len, CODE_LEN_TABLE_BITS, code_len_table))
+    {
+      return false;
+    }
+
+    // Literal/length and distance code lengths are run-length encoded as a
+    // whole.
+    uint8_t code_lens[NLITLEN_SYMBOL + NDIST_SYMBOL];
+    uint32_t ncode = nlitlen + ndist;
+    uint32_t icode = 0;
+    while (icode < ncode) {
+      refill();
+      uint32_t entry = decode(code_len_table, CODE_LEN_TABLE_BITS);
+      if (entry_kind(entry) != L_HUFFMAN_ENTRY_KIND_LITERAL) {
+        L_ERROR("invalid code length code");
+        return false;
+      }
+      uint32_t sym = entry_value(entry);
+      if (sym < 16) {
+        code_lens[icode++] = (uint8_t)sym;
+        continue;
+      }
+
+      uint8_t len = 0;
+      uint32_t nrepeat;
+      if (sym == 16) {
+        if (icode == 0) {
+          L_ERROR("no previous code length to repeat");
+          return false;
+        }
+        len = code_lens[icode - 1];
+        nrepeat = 3 + extract_bits(2);
+      } else if (sym == 17) {
+        nrepeat = 3 + extract_bits(3);
+      } else {
+        nrepeat = 11 + extract_bits(7);
+      }
+      if (icode + nrepeat > ncode) {
+        L_ERROR("code length repeat overflowed");
+        return false;
+      }
+      std::fill(code_lens + icode, code_lens + icode + nrepeat, len);
+      icode += nrepeat;
+    }
+    if (is_overrun()) {
+      L_ERROR("unexpected end of deflate stream");
+      return false;
+    }
+    if (code_lens[256] == 0) {
+      L_ERROR("missing end-of-block code");
+      return false;
+    }
+
+    bool out = true;
+    out &= build_huffman_table(code_lens, nlitlen, SYMBOL_ENTRIES.litlen,
+      LITLEN_TABLE_BITS, litlen_table.get());
+    out &= build_huffman_table(code_lens + nlitlen, ndist,
+      SYMBOL_ENTRIES.dist, DIST_TABLE_BITS, dist_table.get());
+    return out;
+  }
+
+  inline void copy_match(size_t dist, size_t len) {
+    const uint8_t* src = out - dist;
+    uint8_t* dst_end = out + len;
+    if (dist >= 8 && (size_t)(out_end - out) >= len + 8) {
+      // Copy in 8-byte words. Each word is read from data already written and
+      // the bytes written past the match are overwritten later on.
+      do {
+        std::memcpy(out, src, 8);
+        out += 8;
+        src += 8;
+      } while (out < dst_end);
+    } else if (dist == 1) {
+      std::memset(out, out[-1], len);
+    } else {
+      // Overlapped copy repeats the last `dist` bytes.
+      for (size_t i = 0; i < len; ++i) {
+        out[i] = src[i];
+      }
+    }
+    out = dst_end;
+  }
+
+  bool inflate_huffman_block() {
+    const uint32_t* litlen_table = this->litlen_table.get();
+    const uint32_t* dist_table = this->dist_table.get();
+    for (;;) {
+      refill();
+      uint32_t entry = decode(litlen_table, LITLEN_TABLE_BITS);
+      HuffmanEntryKind kind = entry_kind(entry);
+
+      if (kind == L_HUFFMAN_ENTRY_KIND_LITERAL) {
+        if (out == out_end) {
+          L_ERROR("deflate stream decompressed to more data than expected");
+          return false;
+        }
+        *out++ = (uint8_t)entry_value(entry);
+        continue;
+      }
+      if (kind == L_HUFFMAN_ENTRY_KIND_END_OF_BLOCK) {
+        return true;
+      }
+      if (kind != L_HUFFMAN_ENTRY_KIND_LENGTH) {
+        L_ERROR("invalid literal/length code");
+        return false;
+      }
+      size_t len = entry_value(entry) + extract_bits(entry_nextra(entry));
+
+      entry = decode(dist_table, DIST_TABLE_BITS);
+      if (entry_kind(entry) != L_HUFFMAN_ENTRY_KIND_DISTANCE) {
+        L_ERROR("invalid distance code");
+        return false;
+      }
+      size_t dist = entry_value(entry) + extract_bits(entry_nextra(entry));
+
+      if (dist > (size_t)(out - out_beg)) {
+        L_ERROR("deflate match distance is too far back");
+        return false;
+      }
+      if (len > (size_t)(out_end - out)) {
+        L_ERROR("deflate stream decompressed to more data than expected");
+        return false;
+      }
+      copy_match(dist, len);
+    }
+  }
+
+  bool inflate() {
+    bool is_final_block = false;
+    while (!is_final_block) {
+      refill();
+      if (is_overrun()) {
+        L_ERROR("unexpected end of deflate stream");
+        return false;
+      }
+      is_final_block = extract_bits(1) != 0;
+      uint32_t block_type = extract_bits(2);
+
+      bool succ;
+      switch (block_type) {
+      case 0:
+        succ = inflate_stored_block();
+        break;
+      case 1:
+        succ = build_fixed_tables() && inflate_huffman_block();
+        break;
+      case 2:
+        succ = build_dynamic_tables() && inflate_huffman_block();
+        break;
+      default:
+        L_ERROR("invalid deflate block type");
+        succ = false;
+        break;
+      }
+      if (!succ) {
+        return false;
+      }
+    }
+    if (is_overrun()) {
+      L_ERROR("unexpected end of deflate stream");
+      return false;
+    }
+    if (out != out_end) {
+      L_ERROR("deflate stream decompressed to less data than expected");
+      return false;
+    }
+    return true;
+  }
+};
+
+bool inflate(const void* data, size_t size, void* out, size_t out_size) {
+  Inflater inflater(data, size, out, out_size);
+  return inflater.inflate();
+}
+
+
+// Compression parameters of each level, similar to that of zlib.
+struct CompressionParams {
+  // Matches are searched for at most `max_chain` times. Zero means no
+  // compression at all.
+  uint32_t max_chain;
+  // Stop searching once a match of `nice_len` is found.
+  uint32_t nice_len;
+  // Try to find a longer match at the next byte unless the current match is
+  // at least `max_lazy` long. Zero means greedy matching.
+  uint32_t max_lazy;
+  // Greedy matching only: positions covered by matches longer than this are
+  // not inserted into the hash chains.
+  uint32_t max_insert_len;
+};
+constexpr CompressionParams COMPRESSION_PARAMS[] = {
+  { 0, 0, 0, 0 },
+  { 4, 8, 0, 4 },
+  { 8, 16, 0, 5 },
+  { 32, 32, 0, 6 },
+  { 16, 16, 4, 0 },
+  { 32, 32, 16, 0 },
+  { 128, 128, 16, 0 },
+  { 256, 128, 32, 0 },
+  { 1024, 258, 128, 0 },
+  { 4096, 258, 258, 0 },
+};
+
+constexpr uint32_t MIN_MATCH = 3;
+constexpr uint32_t MAX_MATCH = 258;
+constexpr uint32_t WINDOW_SIZE = 32768;
+constexpr uint32_t MAX_HASH_BITS = 15;
+constexpr uint32_t MIN_HASH_BITS = 8;
+constexpr uint32_t NLITLEN_CODE = 286;
+constexpr uint32_t NDIST_CODE = 30;
+// Number of symbols buffered before a block is emitted. Smaller blocks adapt
+// faster to the data but pay more for block headers.
+constexpr size_t MAX_BLOCK_NSYMBOL = 1 << 15;
+constexpr size_t MAX_STORED_BLOCK_SIZE = 65535;
+
+// Symbols of match lengths and distances, and the fixed Huffman code.
+struct EncoderTables {
+  uint8_t length_codes[MAX_MATCH + 1];
+  // Distances up to 256 are indexed directly by `dist - 1`; longer distances
+  // have at least 7 extra bits so they are indexed by `256 + (dist - 1) / 128`.
+  uint8_t dist_codes[512];
+  uint8_t fixed_litlen_lens[NLITLEN_SYMBOL];
+  uint16_t fixed_litlen_codes[NLITLEN_SYMBOL];
+  uint8_t fixed_dist_lens[NDIST_CODE];
+  uint16_t fixed_dist_codes[NDIST_CODE];
+
+  EncoderTables();
+};
+
+inline uint32_t get_dist_code(const EncoderTables& tables, uint32_t dist) {
+  return dist <= 256 ?
+    tables.dist_codes[dist - 1] :
+    tables.dist_codes[256 + ((dist - 1) >> 7)];
+}
+
+// Assign bit-reversed canonical Huffman codes to symbols of `code_lens`.
+void build_huffman_codes(
+  const uint8_t* code_lens,
+  uint32_t nsym,
+  uint16_t* codes
+) {
+  uint32_t counts[MAX_CODE_LEN + 1] {};
+  for (uint32_t i = 0; i < nsym; ++i) {
+    ++counts[code_lens[i]];
+  }
+  counts[0] = 0;
+  uint32_t next_codes[MAX_CODE_LEN + 1] {};
+  for (uint32_t len = 1; len <= MAX_CODE_LEN; ++len) {
+    next_codes[len] = (next_codes[len - 1] + counts[len - 1]) << 1;
+  }
+  for (uint32_t i = 0; i < nsym; ++i) {
+    uint32_t len = code_lens[i];
+    codes[i] = len == 0 ? 0 : (uint16_t)reverse_bits(next_codes[len]++, len);
+  }
+}
+
+EncoderTables::EncoderTables() {
+  for (uint32_t i = 0; i < 29; ++i) {
+    uint32_t end = i + 1 < 29 ? LENGTH_BASES[i + 1] : MAX_MATCH + 1;
+    for (uint32_t len = LENGTH_BASES[i]; len < end; ++len) {
+      length_codes[len] = (uint8_t)i;
+    }
+  }
+  for (uint32_t i = 0; i < NDIST_CODE; ++i) {
+    uint32_t end = DIST_BASES[i] + (1u << DIST_NEXTRAS[i]);
+    for (uint32_t dist = DIST_BASES[i]; dist < end; ++dist) {
+      if (dist <= 256) {
+        dist_codes[dist - 1] = (uint8_t)i;
+      } else {
+        dist_codes[256 + ((dist - 1) >> 7)] = (uint8_t)i;
+      }
+    }
+  }
+
+  std::fill(fixed_litlen_lens, fixed_litlen_lens + 144, 8);
+  std::fill(fixed_litlen_lens + 144, fixed_litlen_lens + 256, 9);
+  std::fill(fixed_litlen_lens + 256, fixed_litlen_lens + 280, 7);
+  std::fill(fixed_litlen_lens + 280, fixed_litlen_lens + 288, 8);
+  std::fill(fixed_dist_lens, fixed_dist_lens + NDIST_CODE, 5);
+  build_huffman_codes(fixed_litlen_lens, NLITLEN_SYMBOL, fixed_litlen_codes);
+  build_huffman_codes(fixed_dist_lens, NDIST_CODE, fixed_dist_codes);
+}
+static const EncoderTables ENCODER_TABLES {};
+
+// In-place computation of minimum-redundancy code lengths by Moffat and
+// Katajainen. `weights` must be sorted in ascending order and is replaced by
+// the code length of each symbol.
+void compute_minimum_redundancy(uint32_t* weights, int32_t n) {
+  uint32_t* a = weights;
+  a[0] += a[1];
+  int32_t root = 0;
+  int32_t leaf = 2;
+  for (int32_t next = 1; next < n - 1; ++next) {
+    if (leaf >= n || a[root] < a[leaf]) {
+      a[next] = a[root];
+      a[root++] = next;
+    } else {
+      a[next] = a[leaf++];
+    }
+    if (leaf >= n || (root < next && a[root] < a[leaf])) {
+      a[next] += a[root];
+      a[root++] = next;
+    } else {
+      a[next] += a[leaf++];
+    }
+  }
+
+  a[n - 2] = 0;
+  for (int32_t next = n - 3; next >= 0; --next) {
+    a[next] = a[a[next]] + 1;
+  }
+
+  int32_t navail = 1;
+  int32_t nused = 0;
+  uint32_t depth = 0;
+  root = n - 2;
+  int32_t next = n - 1;
+  while (navail > 0) {
+    while (root >= 0 && a[root] == depth) {
+      ++nused;
+      --root;
+    }
+    while (navail > nused) {
+      a[next--] = depth;
+      --navail;
+    }
+    navail = 2 * nused;
+    ++depth;
+    nused = 0;
+  }
+}
+
+// Build Huffman code lengths of no longer than `max_len` bits for symbols of
+// `freqs`. Unused symbols have zero length.
+void build_code_lens(
+  const uint32_t* freqs,
+  uint32_t nsym,
+  uint32_t max_len,
+  uint8_t* code_lens
+) {
+  std::fill(code_lens, code_lens + nsym, 0);
+  uint32_t syms[NLITLEN_SYMBOL];
+  uint32_t n = 0;
+  for (uint32_t i = 0; i < nsym; ++i) {
+    if (freqs[i] != 0) {
+      syms[n++] = i;
+    }
+  }
+  if (n == 0) { return; }
+  if (n == 1) {
+    code_lens[syms[0]] = 1;
+    return;
+  }
+  std::sort(syms, syms + n, [&](uint32_t a, uint32_t b) {
+    return freqs[a] != freqs[b] ? freqs[a] < freqs[b] : a < b;
+  });
+
+  uint32_t lens[NLITLEN_SYMBOL];
+  for (uint32_t i = 0; i < n; ++i) {
+    lens[i] = freqs[syms[i]];
+  }
+  compute_minimum_redundancy(lens, (int32_t)n);
+
+  // Clamp code lengths to `max_len` and then lengthen the shortest codes
+  // that can be lengthened until the Kraft inequality holds again.
+  uint32_t counts[MAX_CODE_LEN + 1] {};
+  for (uint32_t i = 0; i < n; ++i) {
+    ++counts[std::min(lens[i], max_len)];
+  }
+  uint32_t kraft_sum = 0;
+  for (uint32_t len = 1; len <= max_len; ++len) {
+    kraft_sum += counts[len] << (max_len - len);
+  }
+  while (kraft_sum > (1u << max_len)) {
+    --counts[max_len];
+    for (uint32_t len = max_len - 1; len > 0; --len) {
+      if (counts[len] != 0) {
+        --counts[len];
+        counts[len + 1] += 2;
+        break;
+      }
+    }
+    --kraft_sum;
+  }
+
+  // Less frequent symbols get longer codes.
+  uint32_t i = 0;
+  for (uint32_t len = max_len; len > 0; --len) {
+    for (uint32_t j = 0; j < counts[len]; ++j) {
+      code_lens[syms[i++]] = (uint8_t)len;
+    }
+  }
+}
+
+// Run-length encode code lengths with code length symbols 16, 17 and 18.
+// Each output is a symbol with its extra bits in the high byte.
+uint32_t encode_code_lens(const uint8_t* code_lens, uint32_t n, uint16_t* out) {
+  uint32_t nout = 0;
+  uint32_t i = 0;
+  while (i < n) {
+    uint8_t len = code_lens[i];
+    uint32_t nrun = 1;
+    while (i + nrun < n && code_lens[i + nrun] == len) {
+      ++nrun;
+    }
+    i += nrun;
+
+    if (len == 0) {
+      while (nrun >= 11) {
+        uint32_t nrepeat = std::min<uint32_t>(nrun, 138);
+        out[nout++] = (uint16_t)(18 | ((nrepeat - 11) << 8));
+        nrun -= nrepeat;
+      }
+      if (nrun >= 3) {
+        out[nout++] = (uint16_t)(17 | ((nrun - 3) << 8));
+        nrun = 0;
+      }
+    } else {
+      out[nout++] = len;
+      --nrun;
+      while (nrun >= 3) {
+        uint32_t nrepeat = std::min<uint32_t>(nrun, 6);
+        out[nout++] = (uint16_t)(16 | ((nrepeat - 3) << 8));
+        nrun -= nrepeat;
+      }
+    }
+    for (; nrun > 0; --nrun) {
+      out[nout++] = len;
+    }
+  }
+  return nout;
+}
+inline uint32_t code_len_sym_nextra(uint32_t sym) {
+  return sym == 16 ? 2 : sym == 17 ? 3 : sym == 18 ? 7 : 0;
+}
+
+struct Deflater {
+  const uint8_t* data;
+  size_t size;
+  std::vector<uint8_t>& out;
+  CompressionParams params;
+
+  uint64_t bit_buf;
+  uint32_t nbit;
+
+  // Most recent position of each 3-byte hash, and the previous position of
+  // the same hash for each position in the sliding window. Empty slots are -1.
+  uint32_t hash_bits;
+  std::vector<int64_t> heads;
+  std::vector<int64_t> prevs;
+
+  // Symbols of the pending block. Literals are stored as is; matches are
+  // `0x80000000 | (length << 16) | distance`.
+  std::vector<uint32_t> syms;
+  uint32_t litlen_freqs[NLITLEN_SYMBOL];
+  uint32_t dist_freqs[NDIST_CODE];
+  size_t block_beg;
+
+  Deflater(
+    const void* data,
+    size_t size,
+    std::vector<uint8_t>& out,
+    const DeflateConfig& cfg
+  ) :
+    data((const uint8_t*)data),
+    size(size),
+    out(out),
+    params(COMPRESSION_PARAMS[std::min<uint32_t>(cfg.level, 9)]),
+    bit_buf(0),
+    nbit(0),
+    hash_bits(MIN_HASH_BITS),
+    litlen_freqs(),
+    dist_freqs(),
+    block_beg(0)
+  {
+    // Small inputs don't need large hash tables which are costly to clear.
+    while (hash_bits < MAX_HASH_BITS && ((size_t)1 << hash_bits) < size) {
+      ++hash_bits;
+    }
+  }
+
+  inline void put_bits(uint32_t bits, uint32_t n) {
+    bit_buf |= (uint64_t)bits << nbit;
+    nbit += n;
+    if (nbit >= 32) {
+      uint8_t bytes[4] = {
+        (uint8_t)bit_buf, (uint8_t)(bit_buf >> 8), (uint8_t)(bit_buf >> 16),
+        (uint8_t)(bit_buf >> 24),
+      };
+      out.insert(out.end(), bytes, bytes + 4);
+      bit_buf >>= 32;
+      nbit -= 32;
+    }
+  }
+  inline void align_to_byte() {
+    while (nbit > 0) {
+      out.push_back((uint8_t)bit_buf);
+      bit_buf >>= 8;
+      nbit = nbit > 8 ? nbit - 8 : 0;
+    }
+    bit_buf = 0;
+  }
+
+  inline uint32_t hash(size_t pos) const {
+    uint32_t x = data[pos] | (data[pos + 1] << 8) | (data[pos + 2] << 16);
+    return (x * 0x9E3779B1u) >> (32 - hash_bits);
+  }
+  inline void insert(size_t pos) {
+    if (pos + MIN_MATCH > size) { return; }
+    uint32_t h = hash(pos);
+    prevs[pos & (WINDOW_SIZE - 1)] = heads[h];
+    heads[h] = (int64_t)pos;
+  }
+  inline uint32_t match_len(
+    const uint8_t* a,
+    const uint8_t* b,
+    uint32_t max_len
+  ) const {
+    uint32_t len = 0;
+    while (len + 8 <= max_len) {
+      uint64_t x, y;
+      std::memcpy(&x, a + len, 8);
+      std::memcpy(&y, b + len, 8);
+      if (x != y) { break; }
+      len += 8;
+    }
+    while (len < max_len && a[len] == b[len]) {
+      ++len;
+    }
+    return len;
+  }
+  // Find the longest match for `pos` among earlier positions of the same
+  // hash. Must be called before `pos` is inserted. Returns zero if there is
+  // no match of at least `MIN_MATCH` bytes.
+  uint32_t find_match(size_t pos, uint32_t& dist) const {
+    uint32_t max_len = (uint32_t)std::min<size_t>(MAX_MATCH, size - pos);
+    if (max_len < MIN_MATCH) { return 0; }
+    const uint8_t* cur = data + pos;
+    uint32_t best_len = MIN_MATCH - 1;
+    uint32_t nchain = params.max_chain;
+    int64_t cand = heads[hash(pos)];
+    while (cand >= 0 && pos - (size_t)cand <= WINDOW_SIZE && nchain-- > 0) {
+      const uint8_t* match = data + cand;
+      if (match[best_len] == cur[best_len] && match[0] == cur[0]) {
+        uint32_t len = match_len(match, cur, max_len);
+        if (len > best_len) {
+          best_len = len;
+          dist = (uint32_t)(pos - (size_t)cand);
+          if (len >= params.nice_len || len >= max_len) { break; }
+        }
+      }
+      // Slots overwritten by newer positions break the chain.
+      int64_t next = prevs[cand & (WINDOW_SIZE - 1)];
+      if (next >= cand) { break; }
+      cand = next;
+    }
+    return best_len >= MIN_MATCH ? best_len : 0;
+  }
+
+  inline void emit_literal(uint8_t c) {
+    syms.push_back(c);
+    ++litlen_freqs[c];
+  }
+  inline void emit_match(uint32_t len, uint32_t dist) {
+    syms.push_back(0x80000000 | (len << 16) | dist);
+    ++litlen_freqs[257 + ENCODER_TABLES.length_codes[len]];
+    ++dist_freqs[get_dist_code(ENCODER_TABLES, dist)];
+  }
+
+  void write_symbols(
+    const uint8_t* litlen_lens,
+    const uint16_t* litlen_codes,
+    const uint8_t* dist_lens,
+    const uint16_t* dist_codes
+  ) {
+    for (uint32_t sym : syms) {
+      if ((sym & 0x80000000) == 0) {
+        put_bits(litlen_codes[sym], litlen_lens[sym]);
+        continue;
+      }
+      uint32_t len = (sym >> 16) & 0x1FF;
+      uint32_t dist = sym & 0xFFFF;
+      uint32_t len_code = ENCODER_TABLES.length_codes[len];
+      put_bits(litlen_codes[257 + len_code], litlen_lens[257 + len_code]);
+      put_bits(len - LENGTH_BASES[len_code], LENGTH_NEXTRAS[len_code]);
+      uint32_t dist_code = get_dist_code(ENCODER_TABLES, dist);
+      put_bits(dist_codes[dist_code], dist_lens[dist_code]);
+      put_bits(dist - DIST_BASES[dist_code], DIST_NEXTRAS[dist_code]);
+    }
+    put_bits(litlen_codes[256], litlen_lens[256]);
+  }
+  // Size of the pending symbols in bits with the given code lengths.
+  uint64_t measure_symbols(
+    const uint8_t* litlen_lens,
+    const uint8_t* dist_lens
+  ) const {
+    uint64_t out = 0;
+    for (uint32_t i = 0; i < NLITLEN_CODE; ++i) {
+      out += (uint64_t)litlen_freqs[i] * litlen_lens[i];
+    }
+    for (uint32_t i = 0; i < 29; ++i) {
+      out += (uint64_t)litlen_freqs[257 + i] * LENGTH_NEXTRAS[i];
+    }
+    for (uint32_t i = 0; i < NDIST_CODE; ++i) {
+      out += (uint64_t)dist_freqs[i] * (dist_lens[i] + DIST_NEXTRAS[i]);
+    }
+    return out;
+  }
+
+  void write_stored_blocks(size_t beg, size_t end, bool is_final) {
+    do {
+      size_t n = std::min(end - beg, MAX_STORED_BLOCK_SIZE);
+      put_bits(is_final && beg + n == end ? 1 : 0, 1);
+      put_bits(0, 2);
+      align_to_byte();
+      uint8_t header[4] = {
+        (uint8_t)n, (uint8_t)(n >> 8), (uint8_t)~n, (uint8_t)(~n >> 8),
+      };
+      out.insert(out.end(), header, header + 4);
+      out.insert(out.end(), data + beg, data + beg + n);
+      beg += n;
+    } while (beg < end);
+  }
+
+  // Emit the pending symbols, which encode `data[block_beg, block_end)`, in
+  // whichever of the stored, fixed or dynamic Huffman block is the smallest.
+  void flush_block(size_t block_end, bool is_final) {
+    ++litlen_freqs[256];
+
+    uint8_t litlen_lens[NLITLEN_SYMBOL];
+    uint8_t dist_lens[NDIST_CODE];
+    build_code_lens(litlen_freqs, NLITLEN_CODE, MAX_CODE_LEN, litlen_lens);
+    build_code_lens(dist_freqs, NDIST_CODE, MAX_CODE_LEN, dist_lens);
+    litlen_lens[286] = 0;
+    litlen_lens[287] = 0;
+    uint32_t nlitlen = NLITLEN_CODE;
+    while (nlitlen > 257 && litlen_lens[nlitlen - 1] == 0) {
+      --nlitlen;
+    }
+    uint32_t ndist = NDIST_CODE;
+    while (ndist > 1 && dist_lens[ndist - 1] == 0) {
+      --ndist;
+    }
+
+    uint8_t code_lens[NLITLEN_CODE + NDIST_CODE];
+    std::copy(litlen_lens, litlen_lens + nlitlen, code_lens);
+    std::copy(dist_lens, dist_lens + ndist, code_lens + nlitlen);
+    uint16_t encoded_code_lens[NLITLEN_CODE + NDIST_CODE];
+    uint32_t nencoded_code_len =
+      encode_code_lens(code_lens, nlitlen + ndist, encoded_code_lens);
+    uint32_t code_len_freqs[NCODE_LEN_SYMBOL] {};
+    for (uint32_t i = 0; i < nencoded_code_len; ++i) {
+      ++code_len_freqs[encoded_code_lens[i] & 0xFF];
+    }
+    uint8_t code_len_code_lens[NCODE_LEN_SYMBOL];
+    uint16_t code_len_codes[NCODE_LEN_SYMBOL];
+    build_code_lens(code_len_freqs, NCODE_LEN_SYMBOL, 7, code_len_code_lens);
+    build_huffman_codes(code_len_code_lens, NCODE_LEN_SYMBOL, code_len_codes);
+    uint32_t ncode_len = NCODE_LEN_SYMBOL;
+    while (ncode_len > 4 &&
+      code_len_code_lens[CODE_LEN_ORDER[ncode_len - 1]] == 0)
+    {
+      --ncode_len;
+    }
+
+    uint64_t dynamic_nbit = 3 + 5 + 5 + 4 + 3 * ncode_len +
+      measure_symbols(litlen_lens, dist_lens);
+    for (uint32_t i = 0; i < NCODE_LEN_SYMBOL; ++i) {
+      dynamic_nbit += (uint64_t)code_len_freqs[i] *
+        (code_len_code_lens[i] + code_len_sym_nextra(i));
+    }
+    uint64_t fixed_nbit = 3 + measure_symbols(
+      ENCODER_TABLES.fixed_litlen_lens, ENCODER_TABLES.fixed_dist_lens);
+    size_t nstored_byte = block_end - block_beg;
+    size_t nstored_block = std::max<size_t>(
+      (nstored_byte + MAX_STORED_BLOCK_SIZE - 1) / MAX_STORED_BLOCK_SIZE, 1);
+    uint64_t stored_nbit = (uint64_t)(nstored_byte + nstored_block * 5) * 8;
+
+    if (stored_nbit <= fixed_nbit && stored_nbit <= dynamic_nbit) {
+      write_stored_blocks(block_beg, block_end, is_final);
+    } else if (fixed_nbit <= dynamic_nbit) {
+      put_bits(is_final ? 1 : 0, 1);
+      put_bits(1, 2);
+      write_symbols(
+        ENCODER_TABLES.fixed_litlen_lens, ENCODER_TABLES.fixed_litlen_codes,
+        ENCODER_TABLES.fixed_dist_lens, ENCODER_TABLES.fixed_dist_codes);
+    } else {
+      uint16_t litlen_codes[NLITLEN_SYMBOL];
+      uint16_t dist_codes[NDIST_CODE];
+      build_huffman_codes(litlen_lens, NLITLEN_SYMBOL, litlen_codes);
+      build_huffman_codes(dist_lens, NDIST_CODE, dist_codes);
+
+      put_bits(is_final ? 1 : 0, 1);
+      put_bits(2, 2);
+      put_bits(nlitlen - 257, 5);
+      put_bits(ndist - 1, 5);
+      put_bits(ncode_len - 4, 4);
+      for (uint32_t i = 0; i < ncode_len; ++i) {
+        put_bits(code_len_code_lens[CODE_LEN_ORDER[i]], 3);
+      }
+      for (uint32_t i = 0; i < nencoded_code_len; ++i) {
+        uint32_t sym = encoded_code_lens[i] & 0xFF;
+        put_bits(code_len_codes[sym], code_len_code_lens[sym]);
+        put_bits(encoded_code_lens[i] >> 8, code_len_sym_nextra(sym));
+      }
+      write_symbols(litlen_lens, litlen_codes, dist_lens, dist_codes);
+    }
+
+    syms.clear();
+    std::fill(litlen_freqs, litlen_freqs + NLITLEN_SYMBOL, 0);
+    std::fill(dist_freqs, dist_freqs + NDIST_CODE, 0);
+    block_beg = block_end;
+  }
+
+  void compress_greedy() {
+    size_t pos = 0;
+    while (pos < size) {
+      uint32_t dist = 0;
+      uint32_t len = find_match(pos, dist);
+      insert(pos);
+      if (len >= MIN_MATCH) {
+        emit_match(len, dist);
+        if (len <= params.max_insert_len) {
+          for (size_t i = pos + 1; i < pos + len; ++i) {
+            insert(i);
+          }
+        }
+        pos += len;
+      } else {
+        emit_literal(data[pos]);
+        ++pos;
+      }
+      if (syms.size() >= MAX_BLOCK_NSYMBOL) {
+        flush_block(pos, false);
+      }
+    }
+  }
+  // Defer each match by one byte and take the match at the next byte instead
+  // if it's longer.
+  void compress_lazy() {
+    size_t pos = 0;
+    bool has_prev = false;
+    uint32_t prev_len = 0;
+    uint32_t prev_dist = 0;
+    while (pos < size) {
+      uint32_t dist = 0;
+      uint32_t len = 0;
+      if (prev_len < params.max_lazy) {
+        len = find_match(pos, dist);
+      }
+      insert(pos);
+
+      if (prev_len >= MIN_MATCH && len <= prev_len) {
+        emit_match(prev_len, prev_dist);
+        size_t end = pos - 1 + prev_len;
+        for (size_t i = pos + 1; i < end; ++i) {
+          insert(i);
+        }
+        pos = end;
+        has_prev = false;
+        prev_len = 0;
+      } else {
+        if (has_prev) {
+          emit_literal(data[pos - 1]);
+        }
+        has_prev = true;
+        prev_len = len;
+        prev_dist = dist;
+        ++pos;
+      }
+      if (syms.size() >= MAX_BLOCK_NSYMBOL) {
+        flush_block(has_prev ? pos - 1 : pos, false);
+      }
+    }
+    if (has_prev) {
+      emit_literal(data[pos - 1]);
+    }
+  }
+
+  void compress() {
+    if (params.max_chain == 0) {
+      write_stored_blocks(0, size, true);
+    } else {
+      heads.assign((size_t)1 << hash_bits, -1);
+      prevs.resize(std::min<size_t>(size, WINDOW_SIZE));
+      syms.reserve(std::min<size_t>(size, MAX_BLOCK_NSYMBOL) + 1);
+      if (params.max_lazy == 0) {
+        compress_greedy();
+      } else {
+        compress_lazy();
+      }
+      flush_block(size, true);
+    }
+    align_to_byte();
+  }
+};
+
+void deflate(
+  const void* data,
+  size_t size,
+  std::vector<uint8_t>& out,
+  const DeflateConfig& cfg
+) {
+  Deflater deflater(data, size, out, cfg);
+  deflater.compress();
+}
+
+} // namespace deflate
+} // namespace liong
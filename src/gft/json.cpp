@@ -1,9 +1,28 @@
 // JSON serialization/deserialization.
 // @PENGUINLIONG
 #include <sstream>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <stdexcept>
 #include "gft/log.hpp"
 #include "gft/json.hpp"
 
+#if !defined(L_JSON_NO_SIMD)
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#endif
+#endif // !defined(L_JSON_NO_SIMD)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif // defined(_MSC_VER)
+
 namespace liong {
 namespace json {
 
@@ -17,15 +36,252 @@ const char* JsonException::what() const noexcept {
 JsonArray::JsonArray(
   std::initializer_list<JsonValue>&& elems
 ) : inner(elems) {}
+JsonObject::JsonObject() : tree_(), table_() {}
+JsonObject::JsonObject(std::map<std::string, JsonValue>&& b) :
+  tree_(new JsonFieldTree()),
+  table_()
+{
+  tree_->merge(b);
+}
+JsonObject::JsonObject(JsonFieldTable&& b) :
+  tree_(),
+  table_(new JsonFieldTable(std::move(b))) {}
 JsonObject::JsonObject(
   std::initializer_list<std::pair<const std::string, JsonValue>>&& fields
-) : inner(fields) {}
-JsonValue::JsonValue(JsonObject&& obj) :
-  ty(L_JSON_OBJECT),
-  obj(std::move(obj.inner)) {}
-JsonValue::JsonValue(JsonArray&& arr) :
-  ty(L_JSON_ARRAY),
-  arr(move(arr.inner)) {}
+) : tree_(new JsonFieldTree(fields)), table_() {}
+JsonObject::JsonObject(const JsonObject& b) :
+  tree_(b.tree_ != nullptr ? new JsonFieldTree(*b.tree_) : nullptr),
+  table_(b.table_ != nullptr ? new JsonFieldTable(*b.table_) : nullptr) {}
+JsonObject::JsonObject(JsonObject&& b) noexcept :
+  tree_(std::move(b.tree_)),
+  table_(std::move(b.table_)) {}
+JsonObject::~JsonObject() {}
+JsonObject& JsonObject::operator=(const JsonObject& b) {
+  if (this != &b) {
+    *this = JsonObject(b);
+  }
+  return *this;
+}
+JsonObject& JsonObject::operator=(JsonObject&& b) noexcept {
+  tree_ = std::move(b.tree_);
+  table_ = std::move(b.table_);
+  return *this;
+}
+size_t JsonObject::size() const {
+  if (table_ != nullptr) {
+    return table_->size();
+  } else if (tree_ != nullptr) {
+    return tree_->size();
+  } else {
+    return 0;
+  }
+}
+const JsonValue* JsonObject::find(std::string_view key) const {
+  if (table_ != nullptr) {
+    return table_->find(key);
+  } else if (tree_ != nullptr) {
+    auto it = tree_->find(key);
+    return it == tree_->end() ? nullptr : &it->second;
+  } else {
+    return nullptr;
+  }
+}
+const JsonValue& JsonObject::at(std::string_view key) const {
+  const JsonValue* out = find(key);
+  if (out == nullptr) {
+    throw std::out_of_range("json object field not found");
+  }
+  return *out;
+}
+JsonValue& JsonObject::insert(std::string&& key, JsonValue&& value) {
+  if (table_ != nullptr) {
+    return table_->insert(std::move(key), std::move(value));
+  }
+  if (tree_ == nullptr) {
+    tree_ = std::make_unique<JsonFieldTree>();
+  }
+  JsonValue& out = (*tree_)[std::move(key)];
+  out = std::move(value);
+  return out;
+}
+JsonFieldEnumerator JsonObject::fields() const {
+  static const JsonFieldTree EMPTY_TREE;
+  if (table_ != nullptr) {
+    return JsonFieldEnumerator(table_->begin(), table_->end());
+  }
+  const JsonFieldTree& tree = tree_ != nullptr ? *tree_ : EMPTY_TREE;
+  return JsonFieldEnumerator(tree.cbegin(), tree.cend());
+}
+
+// 32-bit FNV-1a.
+inline uint32_t hash_key(std::string_view key) {
+  uint32_t out = 2166136261u;
+  for (char c : key) {
+    out = (out ^ (uint8_t)c) * 16777619u;
+  }
+  return out;
+}
+
+void JsonFieldTable::rehash(size_t nslot) {
+  slots_.assign(nslot, 0);
+  size_t mask = nslot - 1;
+  for (size_t i = 0; i < hashes_.size(); ++i) {
+    size_t islot = hashes_[i] & mask;
+    while (slots_[islot] != 0) {
+      islot = (islot + 1) & mask;
+    }
+    slots_[islot] = (uint32_t)(i + 1);
+  }
+}
+void JsonFieldTable::reserve(size_t n) {
+  entries_.reserve(n);
+  hashes_.reserve(n);
+  size_t nslot = slots_.empty() ? 8 : slots_.size();
+  while (nslot < n * 2) {
+    nslot *= 2;
+  }
+  if (nslot != slots_.size()) {
+    rehash(nslot);
+  }
+}
+const JsonValue* JsonFieldTable::find(std::string_view key) const {
+  if (slots_.empty()) { return nullptr; }
+  uint32_t hash = hash_key(key);
+  size_t mask = slots_.size() - 1;
+  for (size_t islot = hash & mask; slots_[islot] != 0;
+    islot = (islot + 1) & mask)
+  {
+    size_t i = slots_[islot] - 1;
+    if (hashes_[i] == hash && entries_[i].first == key) {
+      return &entries_[i].second;
+    }
+  }
+  return nullptr;
+}
+JsonValue& JsonFieldTable::insert(std::string&& key, JsonValue&& value) {
+  JsonValue* existing = find(key);
+  if (existing != nullptr) {
+    *existing = std::move(value);
+    return *existing;
+  }
+  if (hashes_.size() >= UINT32_MAX - 1) {
+    throw JsonException("too many object fields");
+  }
+  if ((hashes_.size() + 1) * 2 > slots_.size()) {
+    rehash(slots_.empty() ? 8 : slots_.size() * 2);
+  }
+  uint32_t hash = hash_key(key);
+  size_t mask = slots_.size() - 1;
+  size_t islot = hash & mask;
+  while (slots_[islot] != 0) {
+    islot = (islot + 1) & mask;
+  }
+  slots_[islot] = (uint32_t)(hashes_.size() + 1);
+  hashes_.emplace_back(hash);
+  entries_.emplace_back(std::move(key), std::move(value));
+  return entries_.back().second;
+}
+JsonValue::JsonValue(const JsonValue& b) : ty(L_JSON_NULL), num_int(0) {
+  switch (b.ty) {
+  case L_JSON_STRING: new(&str) std::string(b.str); break;
+  case L_JSON_OBJECT: new(&obj) JsonObject(b.obj); break;
+  case L_JSON_ARRAY: new(&arr) JsonArray(b.arr); break;
+  case L_JSON_BOOLEAN: this->b = b.b; break;
+  case L_JSON_FLOAT: num_float = b.num_float; break;
+  default: num_int = b.num_int; break;
+  }
+  ty = b.ty;
+}
+JsonValue& JsonValue::operator=(const JsonValue& b) {
+  if (this != &b) {
+    *this = JsonValue(b);
+  }
+  return *this;
+}
+void JsonValue::release() {
+  switch (ty) {
+  case L_JSON_STRING: str.~basic_string(); break;
+  case L_JSON_OBJECT: obj.~JsonObject(); break;
+  case L_JSON_ARRAY: arr.~JsonArray(); break;
+  default: break;
+  }
+  ty = L_JSON_NULL;
+  num_int = 0;
+}
+
+
+
+JsonArena::JsonArena() :
+  blocks_(),
+  pos_(nullptr),
+  end_(nullptr),
+  next_block_size_(MIN_BLOCK_SIZE),
+  capacity_(0) {}
+JsonArena::JsonArena(JsonArena&& b) noexcept :
+  blocks_(std::move(b.blocks_)),
+  pos_(b.pos_),
+  end_(b.end_),
+  next_block_size_(b.next_block_size_),
+  capacity_(b.capacity_)
+{
+  b.clear();
+}
+JsonArena& JsonArena::operator=(JsonArena&& b) noexcept {
+  if (this != &b) {
+    blocks_ = std::move(b.blocks_);
+    pos_ = b.pos_;
+    end_ = b.end_;
+    next_block_size_ = b.next_block_size_;
+    capacity_ = b.capacity_;
+    b.clear();
+  }
+  return *this;
+}
+void* JsonArena::alloc_slow(size_t size, size_t align) {
+  // Oversized allocations get a dedicated block so that the remaining space
+  // of the current block is not wasted.
+  size_t block_size = size + align;
+  if (block_size > next_block_size_ / 4) {
+    blocks_.emplace_back(new uint8_t[block_size]);
+    capacity_ += block_size;
+    uintptr_t beg = (uintptr_t)blocks_.back().get();
+    return (void*)((beg + (align - 1)) & ~(uintptr_t)(align - 1));
+  }
+
+  block_size = next_block_size_;
+  next_block_size_ = std::min(next_block_size_ * 2, MAX_BLOCK_SIZE);
+  blocks_.emplace_back(new uint8_t[block_size]);
+  capacity_ += block_size;
+  pos_ = blocks_.back().get();
+  end_ = pos_ + block_size;
+  return alloc(size, align);
+}
+void JsonArena::clear() {
+  blocks_.clear();
+  pos_ = nullptr;
+  end_ = nullptr;
+  next_block_size_ = MIN_BLOCK_SIZE;
+  capacity_ = 0;
+}
+
+const JsonNode* JsonNode::find(std::string_view key) const {
+  if (!is_obj()) { return nullptr; }
+  // Later members override earlier ones with the same key, as in
+  // `JsonObject`.
+  for (size_t i = size_; i > 0; --i) {
+    const JsonMember& member = members_[i - 1];
+    if (member.first == key) {
+      return &member.second;
+    }
+  }
+  return nullptr;
+}
+const JsonNode& JsonNode::operator[](std::string_view key) const {
+  if (!is_obj()) { throw JsonException("value is not an object"); }
+  const JsonNode* out = find(key);
+  if (out == nullptr) { throw JsonException("object field not found"); }
+  return *out;
+}
 
 
 
@@ -43,23 +299,212 @@ enum JsonTokenType {
   L_JSON_TOKEN_CLOSE_BRACE,
   L_JSON_TOKEN_OPEN_BRACKET,
   L_JSON_TOKEN_CLOSE_BRACKET,
+  L_JSON_TOKEN_INCOMPLETE,
 };
 struct JsonToken {
   JsonTokenType ty;
   int64_t num_int;
   double num_float;
-  std::string str;
+  // Points into the input buffer if the string literal has no escape
+  // sequence; otherwise it points into the tokenizer's scratch buffer and is
+  // only valid until the next token is read.
+  std::string_view str;
 };
 
+// Encode a unicode code point as UTF-8.
+void append_utf8(std::string& out, uint32_t code) {
+  if (code < 0x80) {
+    out.push_back((char)code);
+  } else if (code < 0x800) {
+    out.push_back((char)(0xC0 | (code >> 6)));
+    out.push_back((char)(0x80 | (code & 0x3F)));
+  } else if (code < 0x10000) {
+    out.push_back((char)(0xE0 | (code >> 12)));
+    out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+    out.push_back((char)(0x80 | (code & 0x3F)));
+  } else {
+    out.push_back((char)(0xF0 | (code >> 18)));
+    out.push_back((char)(0x80 | ((code >> 12) & 0x3F)));
+    out.push_back((char)(0x80 | ((code >> 6) & 0x3F)));
+    out.push_back((char)(0x80 | (code & 0x3F)));
+  }
+}
+
+// - [Vectorized Scanning] -----------------------------------------------------
+//
+// Long runs of whitespaces (in pretty-printed JSON) and string contents are
+// scanned 16 or 32 bytes at a time. AVX2 is used if the compiler is allowed to
+// emit AVX2 instructions; SSE2 is always available on x86-64 and NEON on
+// AArch64. Other architectures, or builds with `L_JSON_NO_SIMD` defined, fall
+// back to scalar loops.
+
+#if !defined(L_JSON_NO_SIMD)
+#if defined(__AVX2__)
+#define L_JSON_SIMD_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || \
+  (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define L_JSON_SIMD_SSE2
+#elif defined(__ARM_NEON) || defined(__aarch64__) || defined(_M_ARM64)
+#define L_JSON_SIMD_NEON
+#endif
+#endif // !defined(L_JSON_NO_SIMD)
+
+inline bool is_whitespace(char c) {
+  return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+#if defined(L_JSON_SIMD_AVX2) || defined(L_JSON_SIMD_SSE2)
+inline uint32_t ctz32(uint32_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long out;
+  _BitScanForward(&out, x);
+  return (uint32_t)out;
+#else
+  return (uint32_t)__builtin_ctz(x);
+#endif
+}
+#endif
+#if defined(L_JSON_SIMD_NEON)
+inline uint32_t ctz64(uint64_t x) {
+#if defined(_MSC_VER) && !defined(__clang__)
+  unsigned long out;
+  _BitScanForward64(&out, x);
+  return (uint32_t)out;
+#else
+  return (uint32_t)__builtin_ctzll(x);
+#endif
+}
+// NEON has no `movemask`. Narrowing shift packs a 16-lane comparison result
+// into 64 bits with 4 bits per lane.
+inline uint64_t neon_mask4(uint8x16_t cmp) {
+  uint8x8_t packed = vshrn_n_u16(vreinterpretq_u16_u8(cmp), 4);
+  return vget_lane_u64(vreinterpret_u64_u8(packed), 0);
+}
+#endif
+
+// Returns the first position in `[pos, end)` that is not a whitespace.
+inline const char* skip_whitespaces(const char* pos, const char* end) {
+#if defined(L_JSON_SIMD_AVX2)
+  const __m256i sp = _mm256_set1_epi8(' ');
+  const __m256i tab = _mm256_set1_epi8('\t');
+  const __m256i cr = _mm256_set1_epi8('\r');
+  const __m256i lf = _mm256_set1_epi8('\n');
+  while (end - pos >= 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)pos);
+    __m256i ws = _mm256_or_si256(
+      _mm256_or_si256(_mm256_cmpeq_epi8(x, sp), _mm256_cmpeq_epi8(x, tab)),
+      _mm256_or_si256(_mm256_cmpeq_epi8(x, cr), _mm256_cmpeq_epi8(x, lf)));
+    uint32_t mask = ~(uint32_t)_mm256_movemask_epi8(ws);
+    if (mask != 0) {
+      return pos + ctz32(mask);
+    }
+    pos += 32;
+  }
+#elif defined(L_JSON_SIMD_SSE2)
+  const __m128i sp = _mm_set1_epi8(' ');
+  const __m128i tab = _mm_set1_epi8('\t');
+  const __m128i cr = _mm_set1_epi8('\r');
+  const __m128i lf = _mm_set1_epi8('\n');
+  while (end - pos >= 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)pos);
+    __m128i ws = _mm_or_si128(
+      _mm_or_si128(_mm_cmpeq_epi8(x, sp), _mm_cmpeq_epi8(x, tab)),
+      _mm_or_si128(_mm_cmpeq_epi8(x, cr), _mm_cmpeq_epi8(x, lf)));
+    uint32_t mask = ~(uint32_t)_mm_movemask_epi8(ws) & 0xFFFF;
+    if (mask != 0) {
+      return pos + ctz32(mask);
+    }
+    pos += 16;
+  }
+#elif defined(L_JSON_SIMD_NEON)
+  const uint8x16_t sp = vdupq_n_u8(' ');
+  const uint8x16_t tab = vdupq_n_u8('\t');
+  const uint8x16_t cr = vdupq_n_u8('\r');
+  const uint8x16_t lf = vdupq_n_u8('\n');
+  while (end - pos >= 16) {
+    uint8x16_t x = vld1q_u8((const uint8_t*)pos);
+    uint8x16_t ws = vorrq_u8(
+      vorrq_u8(vceqq_u8(x, sp), vceqq_u8(x, tab)),
+      vorrq_u8(vceqq_u8(x, cr), vceqq_u8(x, lf)));
+    uint64_t mask = ~neon_mask4(ws);
+    if (mask != 0) {
+      return pos + (ctz64(mask) >> 2);
+    }
+    pos += 16;
+  }
+#endif
+  while (pos != end && is_whitespace(*pos)) {
+    ++pos;
+  }
+  return pos;
+}
+
+// Returns the first position in `[pos, end)` of a quote or a backslash.
+inline const char* find_quote_or_backslash(const char* pos, const char* end) {
+#if defined(L_JSON_SIMD_AVX2)
+  const __m256i quote = _mm256_set1_epi8('"');
+  const __m256i backslash = _mm256_set1_epi8('\\');
+  while (end - pos >= 32) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)pos);
+    __m256i hit = _mm256_or_si256(
+      _mm256_cmpeq_epi8(x, quote), _mm256_cmpeq_epi8(x, backslash));
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(hit);
+    if (mask != 0) {
+      return pos + ctz32(mask);
+    }
+    pos += 32;
+  }
+#elif defined(L_JSON_SIMD_SSE2)
+  const __m128i quote = _mm_set1_epi8('"');
+  const __m128i backslash = _mm_set1_epi8('\\');
+  while (end - pos >= 16) {
+    __m128i x = _mm_loadu_si128((const __m128i*)pos);
+    __m128i hit = _mm_or_si128(
+      _mm_cmpeq_epi8(x, quote), _mm_cmpeq_epi8(x, backslash));
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(hit);
+    if (mask != 0) {
+      return pos + ctz32(mask);
+    }
+    pos += 16;
+  }
+#elif defined(L_JSON_SIMD_NEON)
+  const uint8x16_t quote = vdupq_n_u8('"');
+  const uint8x16_t backslash = vdupq_n_u8('\\');
+  while (end - pos >= 16) {
+    uint8x16_t x = vld1q_u8((const uint8_t*)pos);
+    uint8x16_t hit = vorrq_u8(vceqq_u8(x, quote), vceqq_u8(x, backslash));
+    uint64_t mask = neon_mask4(hit);
+    if (mask != 0) {
+      return pos + (ctz64(mask) >> 2);
+    }
+    pos += 16;
+  }
+#endif
+  while (pos != end && *pos != '"' && *pos != '\\') {
+    ++pos;
+  }
+  return pos;
+}
+
+// Scans JSON tokens directly from the input buffer. The buffer is not copied
+// and has to be kept alive until tokenization is done.
+//
+// If `is_final` is false, the buffer is only a window of a longer input, and a
+// token cut off by the end of the window is reported as
+// `L_JSON_TOKEN_INCOMPLETE` with `pos` left at the beginning of the token so
+// that the caller can refill the window and retry.
 struct Tokenizer {
-  std::string lit;
-  std::string::const_iterator pos;
-  std::string::const_iterator end;
+  const char* pos;
+  const char* end;
+  bool is_final;
+  // Scratch buffer for strings with escape sequences.
+  std::string buf;
 
-  Tokenizer(const std::string& json) :
-    lit(json),
-    pos(lit.cbegin()),
-    end(lit.cend()) {}
+  Tokenizer(const char* json, size_t size) :
+    pos(json),
+    end(json + size),
+    is_final(true),
+    buf() {}
 
   // Check the range first before calling this method.
   bool unsafe_starts_with(const char* head) {
@@ -71,14 +516,202 @@ struct Tokenizer {
     }
     return true;
   }
+
+  bool incomplete(const char* token_beg, JsonToken& out) {
+    pos = token_beg;
+    out.ty = L_JSON_TOKEN_INCOMPLETE;
+    return false;
+  }
+
+  static bool is_digit(char c) {
+    return c >= '0' && c <= '9';
+  }
+  bool parse_number(JsonToken& out) {
+    const char* beg = pos;
+    out.ty = L_JSON_TOKEN_INT;
+    if (*pos == '+' || *pos == '-') {
+      ++pos;
+    }
+    while (pos != end && is_digit(*pos)) { ++pos; }
+    if (pos != end && *pos == '.') {
+      out.ty = L_JSON_TOKEN_FLOAT;
+      ++pos;
+      while (pos != end && is_digit(*pos)) { ++pos; }
+    }
+    if (pos != end && (*pos == 'e' || *pos == 'E')) {
+      out.ty = L_JSON_TOKEN_FLOAT;
+      ++pos;
+      if (pos != end && (*pos == '+' || *pos == '-')) { ++pos; }
+      while (pos != end && is_digit(*pos)) { ++pos; }
+    }
+    if (pos == end && !is_final) {
+      // The number might continue in the next window.
+      return incomplete(beg, out);
+    }
+
+    // `from_chars` doesn't accept explicit positive signs.
+    const char* num_beg = *beg == '+' ? beg + 1 : beg;
+    if (out.ty == L_JSON_TOKEN_INT) {
+      auto res = std::from_chars(num_beg, pos, out.num_int);
+      if (res.ec == std::errc::invalid_argument || res.ptr != pos) {
+        throw JsonException("invalid number");
+      }
+      if (res.ec != std::errc::result_out_of_range) {
+        out.num_float = (double)out.num_int;
+        return true;
+      }
+      // Integer out of range, fall back to floating-point numbers.
+      out.ty = L_JSON_TOKEN_FLOAT;
+    }
+
+    // Floating-point `from_chars` is not universally available, so the number
+    // is copied to a null-terminated buffer for `strtod`. The buffer is on the
+    // stack unless the literal is insanely long.
+    char num_stack_buf[128];
+    std::string num_heap_buf;
+    size_t num_len = pos - num_beg;
+    char* num_buf = num_stack_buf;
+    if (num_len >= sizeof(num_stack_buf)) {
+      num_heap_buf.resize(num_len + 1);
+      num_buf = &num_heap_buf[0];
+    }
+    std::memcpy(num_buf, num_beg, num_len);
+    num_buf[num_len] = '\0';
+    char* num_end = nullptr;
+    out.num_float = std::strtod(num_buf, &num_end);
+    if (num_end != num_buf + num_len) {
+      throw JsonException("invalid number");
+    }
+    // Converting values out of the range of `int64_t` is undefined behavior.
+    // Both bounds are exact in double precision.
+    if (out.num_float >= -9223372036854775808.0 &&
+      out.num_float < 9223372036854775808.0)
+    {
+      out.num_int = (int64_t)out.num_float;
+    } else {
+      out.num_int = 0;
+    }
+    return true;
+  }
+
+  // `str_end` is the position of the closing quote.
+  uint32_t parse_hex4(const char* str_end) {
+    if (str_end - pos < 4) {
+      throw JsonException("incomplete unicode escape");
+    }
+    uint32_t out = 0;
+    for (size_t i = 0; i < 4; ++i) {
+      char c = *(pos++);
+      out <<= 4;
+      if (c >= '0' && c <= '9') {
+        out |= c - '0';
+      } else if (c >= 'a' && c <= 'f') {
+        out |= c - 'a' + 10;
+      } else if (c >= 'A' && c <= 'F') {
+        out |= c - 'A' + 10;
+      } else {
+        throw JsonException("invalid unicode escape");
+      }
+    }
+    return out;
+  }
+  void parse_escape(const char* str_end) {
+    // `pos` is right after the backslash.
+    char c = *(pos++);
+    switch (c) {
+    case '"': buf.push_back('"'); break;
+    case '\\': buf.push_back('\\'); break;
+    case '/': buf.push_back('/'); break;
+    case 'b': buf.push_back('\b'); break;
+    case 'f': buf.push_back('\f'); break;
+    case 'n': buf.push_back('\n'); break;
+    case 'r': buf.push_back('\r'); break;
+    case 't': buf.push_back('\t'); break;
+    case 'u':
+    {
+      uint32_t code = parse_hex4(str_end);
+      if (code >= 0xD800 && code < 0xDC00) {
+        // High surrogate, a low surrogate must follow.
+        if (str_end - pos < 2 || pos[0] != '\\' || pos[1] != 'u') {
+          throw JsonException("unpaired utf-16 surrogate");
+        }
+        pos += 2;
+        uint32_t lo = parse_hex4(str_end);
+        if (lo < 0xDC00 || lo >= 0xE000) {
+          throw JsonException("unpaired utf-16 surrogate");
+        }
+        code = 0x10000 + ((code - 0xD800) << 10) + (lo - 0xDC00);
+      }
+      append_utf8(buf, code);
+      break;
+    }
+    default:
+      throw JsonException("invalid escape charater");
+    }
+  }
+  bool parse_string(JsonToken& out) {
+    out.ty = L_JSON_TOKEN_STRING;
+    const char* token_beg = pos;
+    const char* beg = ++pos;
+    // Fast path: no escape sequence in the string so it can be referred to in
+    // place.
+    pos = find_quote_or_backslash(pos, end);
+    if (pos != end && *pos == '"') {
+      out.str = std::string_view(beg, pos - beg);
+      pos += 1;
+      return true;
+    }
+
+    // Slow path: find the closing quote first so that escape sequences are
+    // never cut off by the end of buffer, then unescape into the scratch
+    // buffer.
+    const char* str_end = find_quote_or_backslash(pos, end);
+    while (str_end != end && *str_end != '"') {
+      // Skip the backslash and the escaped character.
+      if (end - str_end < 2) {
+        str_end = end;
+        break;
+      }
+      str_end = find_quote_or_backslash(str_end + 2, end);
+    }
+    if (str_end == end) {
+      if (is_final) {
+        throw JsonException("unexpected end of string");
+      } else {
+        return incomplete(token_beg, out);
+      }
+    }
+
+    buf.assign(beg, pos);
+    while (pos != str_end) {
+      if (*pos == '\\') {
+        ++pos;
+        parse_escape(str_end);
+      } else {
+        const char* seg_beg = pos;
+        pos = find_quote_or_backslash(pos, str_end);
+        buf.append(seg_beg, pos);
+      }
+    }
+    out.str = std::string_view(buf);
+    pos = str_end + 1;
+    return true;
+  }
+
+  // Returns false if there is no more token in the buffer. If `is_final` is
+  // false, `out.ty` is set to `L_JSON_TOKEN_INCOMPLETE` if the buffer ends in
+  // the middle of a token.
   bool next_token(JsonToken& out) {
-    std::stringstream ss;
     while (pos != end) {
       char c = *pos;
 
-      // Ignore whitespaces.
-      if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+      // Ignore whitespaces. Tokens are mostly separated by none or a single
+      // whitespace in minified JSON, so only go vectorized for longer runs.
+      if (is_whitespace(c)) {
         pos += 1;
+        if (pos != end && is_whitespace(*pos)) {
+          pos = skip_whitespaces(pos, end);
+        }
         continue;
       }
 
@@ -93,95 +726,19 @@ struct Tokenizer {
       }
 
       // Try parse numbers.
-      if (c == '+' || c == '-' || (c >= '0' && c <= '9')) {
-        out.ty = L_JSON_TOKEN_INT;
-        const int STATE_INTEGRAL = 0;
-        const int STATE_FRACTION = 1;
-        const int STATE_EXPONENT = 2;
-        int state = STATE_INTEGRAL;
-        do {
-          c = *pos;
-          if (state == STATE_INTEGRAL) {
-            if (c == '.') {
-              state = STATE_FRACTION;
-              ss.put(c);
-              continue;
-            }
-            if (c == 'e') {
-              state = STATE_EXPONENT;
-              ss.put(c);
-              continue;
-            }
-            if (c != '+' && c != '-' && (c < '0' || c > '9')) {
-              break;
-            }
-          } else if (state == STATE_FRACTION) {
-            out.ty = L_JSON_TOKEN_FLOAT;
-            if (c == 'e') {
-              state = STATE_EXPONENT;
-              ss.put(c);
-              continue;
-            }
-            if (c < '0' || c > '9') {
-              break;
-            }
-          } else if (state == STATE_EXPONENT) {
-            out.ty = L_JSON_TOKEN_FLOAT;
-            if (c != '+' && c != '-' && (c < '0' || c > '9')) {
-              break;
-            }
-          }
-          ss.put(c);
-        } while (++pos != end);
-        if (out.ty == L_JSON_TOKEN_INT) {
-          out.num_int = std::atoll(ss.str().c_str());
-        } else if (out.ty == L_JSON_TOKEN_FLOAT) {
-          out.num_float = std::atof(ss.str().c_str());
-        }
-        return true;
+      if (c == '+' || c == '-' || is_digit(c)) {
+        return parse_number(out);
       }
 
       // Try parse strings.
       if (c == '"') {
-        out.ty = L_JSON_TOKEN_STRING;
-        bool escape = false;
-        while (++pos != end) {
-          c = *pos;
-          if (escape) {
-            switch (c) {
-            case '"':
-            case '/':
-              break;
-            case 'b': c = '\b'; break;
-            case 'f': c = '\f'; break;
-            case 'n': c = '\n'; break;
-            case 'r': c = '\r'; break;
-            case 't': c = '\t'; break;
-            case 'u':
-              throw JsonException("unicode escape is not supported");
-            default:
-              throw JsonException("invalid escape charater");
-            }
-            escape = false;
-          } else {
-            if (c == '\\') {
-              escape = true;
-              continue;
-            } else if (c == '"') {
-              if (escape != false) {
-                throw JsonException("incomplete escape sequence");
-              }
-              out.str = ss.str();
-              pos += 1;
-              return true;
-            }
-          }
-          ss.put(c);
-        }
-        throw JsonException("unexpected end of string");
+        return parse_string(out);
       }
 
       // Try parse literals.
+      if (!is_final && pos + 5 > end) {
+        return incomplete(pos, out);
+      }
       if (pos + 4 <= end) {
         if (unsafe_starts_with("null")) {
           out.ty = L_JSON_TOKEN_NULL;
@@ -201,6 +758,7 @@ struct Tokenizer {
           return true;
         }
       }
+      throw JsonException("unexpected character");
     }
     out.ty = L_JSON_TOKEN_UNDEFINED;
     return false;
@@ -209,6 +767,7 @@ struct Tokenizer {
 
 bool try_parse_impl(
   Tokenizer& tokenizer,
+  const JsonParseConfig& cfg,
   JsonValue& out
 ) {
   JsonToken token;
@@ -216,36 +775,185 @@ bool try_parse_impl(
     JsonValue val;
     switch (token.ty) {
     case L_JSON_TOKEN_TRUE:
-      out.ty = L_JSON_BOOLEAN;
-      out.b = true;
+      out = JsonValue(true);
+      return true;
+    case L_JSON_TOKEN_FALSE:
+      out = JsonValue(false);
+      return true;
+    case L_JSON_TOKEN_NULL:
+      out = JsonValue(nullptr);
+      return true;
+    case L_JSON_TOKEN_STRING:
+      out = JsonValue(token.str.data(), token.str.size());
+      return true;
+    case L_JSON_TOKEN_INT:
+      out = JsonValue(token.num_int);
+      return true;
+    case L_JSON_TOKEN_FLOAT:
+      out = JsonValue(token.num_float);
+      return true;
+    case L_JSON_TOKEN_OPEN_BRACKET:
+    {
+      out = JsonValue(JsonArray());
+      JsonArray& arr = out.arr;
+      for (;;) {
+        if (!try_parse_impl(tokenizer, cfg, val)) {
+          // When the array has no element.
+          break;
+        }
+        arr.inner.emplace_back(std::move(val));
+        if (tokenizer.next_token(token)) {
+          if (token.ty == L_JSON_TOKEN_COMMA) {
+            continue;
+          } else if (token.ty == L_JSON_TOKEN_CLOSE_BRACKET) {
+            break;
+          } else {
+            throw JsonException("unexpected token in array");
+          }
+        } else {
+          throw JsonException("unexpected end of array");
+        }
+      }
+      return true;
+    }
+    case L_JSON_TOKEN_OPEN_BRACE:
+    {
+      if (cfg.hash_objects) {
+        out = JsonValue(JsonObject(JsonFieldTable()));
+      } else {
+        out = JsonValue(JsonObject());
+      }
+      JsonObject& obj = out.obj;
+      for (;;) {
+        // Match the key.
+        std::string key;
+        if (tokenizer.next_token(token)) {
+          if (token.ty == L_JSON_TOKEN_STRING) {
+            key = std::string(token.str);
+          } else if (token.ty == L_JSON_TOKEN_CLOSE_BRACE) {
+            // The object has no field.
+            break;
+          } else {
+            throw JsonException("unexpected object field key type");
+          }
+        } else {
+          throw JsonException("unexpected end of object");
+        }
+        // Match the colon.
+        if (!tokenizer.next_token(token)) {
+          throw JsonException("unexpected end of object");
+        }
+        if (token.ty != L_JSON_TOKEN_COLON) {
+          throw JsonException("unexpected token in object");
+        }
+        // Match the value.
+        if (!try_parse_impl(tokenizer, cfg, val)) {
+          throw JsonException("unexpected end of object");
+        }
+        obj.insert(std::move(key), std::move(val));
+        // Should we head for another round?
+        if (tokenizer.next_token(token)) {
+          if (token.ty == L_JSON_TOKEN_COMMA) {
+            continue;
+          } else if (token.ty == L_JSON_TOKEN_CLOSE_BRACE) {
+            break;
+          } else {
+            throw JsonException("unexpected token in object");
+          }
+        } else {
+          throw JsonException("unexpected end of object");
+        }
+      }
       return true;
+    }
+    case L_JSON_TOKEN_CLOSE_BRACE:
+    case L_JSON_TOKEN_CLOSE_BRACKET:
+      return false;
+    default:
+      throw JsonException("unexpected token");
+    }
+  }
+  throw JsonException("unexpected program state");
+}
+
+
+
+// Parse into arena-allocated `JsonNode`s. Children of the arrays and objects
+// being parsed are collected on shared stacks and only moved to the arena in
+// one piece once the container is closed.
+struct DocumentParser {
+  Tokenizer& tokenizer;
+  JsonArena& arena;
+  std::vector<JsonNode> elem_stack;
+  std::vector<JsonMember> member_stack;
+
+  DocumentParser(Tokenizer& tokenizer, JsonArena& arena) :
+    tokenizer(tokenizer),
+    arena(arena),
+    elem_stack(),
+    member_stack() {}
+
+  std::string_view alloc_str(std::string_view str) {
+    if (str.size() > UINT32_MAX) {
+      throw JsonException("string is too long");
+    }
+    char* out = arena.alloc_array<char>(str.size() + 1);
+    std::memcpy(out, str.data(), str.size());
+    out[str.size()] = '\0';
+    return std::string_view(out, str.size());
+  }
+  template<typename T>
+  const T* alloc_children(std::vector<T>& stack, size_t beg) {
+    size_t n = stack.size() - beg;
+    if (n > UINT32_MAX) {
+      throw JsonException("too many children in a container");
+    }
+    T* out = arena.alloc_array<T>(n);
+    std::copy(stack.begin() + beg, stack.end(), out);
+    stack.resize(beg);
+    return out;
+  }
+
+  bool try_parse_impl(JsonNode& out) {
+    JsonToken token;
+    if (!tokenizer.next_token(token)) {
+      throw JsonException("unexpected program state");
+    }
+    out = JsonNode();
+    switch (token.ty) {
+    case L_JSON_TOKEN_TRUE:
     case L_JSON_TOKEN_FALSE:
       out.ty = L_JSON_BOOLEAN;
-      out.b = false;
+      out.b = token.ty == L_JSON_TOKEN_TRUE;
       return true;
     case L_JSON_TOKEN_NULL:
-      out.ty = L_JSON_NULL;
       return true;
     case L_JSON_TOKEN_STRING:
+    {
+      std::string_view str = alloc_str(token.str);
       out.ty = L_JSON_STRING;
-      out.str = std::move(token.str);
+      out.size_ = (uint32_t)str.size();
+      out.str_ = str.data();
       return true;
+    }
     case L_JSON_TOKEN_INT:
       out.ty = L_JSON_INT;
       out.num_int = token.num_int;
       return true;
     case L_JSON_TOKEN_FLOAT:
       out.ty = L_JSON_FLOAT;
-      out.num_int = token.num_float;
+      out.num_float = token.num_float;
       return true;
     case L_JSON_TOKEN_OPEN_BRACKET:
-      out.ty = L_JSON_ARRAY;
+    {
+      size_t beg = elem_stack.size();
+      JsonNode val;
       for (;;) {
-        if (!try_parse_impl(tokenizer, val)) {
+        if (!try_parse_impl(val)) {
           // When the array has no element.
           break;
         }
-        out.arr.inner.emplace_back(std::move(val));
+        elem_stack.emplace_back(val);
         if (tokenizer.next_token(token)) {
           if (token.ty == L_JSON_TOKEN_COMMA) {
             continue;
@@ -258,15 +966,20 @@ bool try_parse_impl(
           throw JsonException("unexpected end of array");
         }
       }
+      out.ty = L_JSON_ARRAY;
+      out.size_ = (uint32_t)(elem_stack.size() - beg);
+      out.elems_ = alloc_children(elem_stack, beg);
       return true;
+    }
     case L_JSON_TOKEN_OPEN_BRACE:
-      out.ty = L_JSON_OBJECT;
+    {
+      size_t beg = member_stack.size();
+      JsonMember member;
       for (;;) {
         // Match the key.
-        std::string key;
         if (tokenizer.next_token(token)) {
           if (token.ty == L_JSON_TOKEN_STRING) {
-            key = std::move(token.str);
+            member.first = alloc_str(token.str);
           } else if (token.ty == L_JSON_TOKEN_CLOSE_BRACE) {
             // The object has no field.
             break;
@@ -284,10 +997,10 @@ bool try_parse_impl(
           throw JsonException("unexpected token in object");
         }
         // Match the value.
-        if (!try_parse_impl(tokenizer, val)) {
+        if (!try_parse_impl(member.second)) {
           throw JsonException("unexpected end of object");
         }
-        out.obj.inner[key] = std::move(val);
+        member_stack.emplace_back(member);
         // Should we head for another round?
         if (tokenizer.next_token(token)) {
           if (token.ty == L_JSON_TOKEN_COMMA) {
@@ -301,7 +1014,11 @@ bool try_parse_impl(
           throw JsonException("unexpected end of object");
         }
       }
+      out.ty = L_JSON_OBJECT;
+      out.size_ = (uint32_t)(member_stack.size() - beg);
+      out.members_ = alloc_children(member_stack, beg);
       return true;
+    }
     case L_JSON_TOKEN_CLOSE_BRACE:
     case L_JSON_TOKEN_CLOSE_BRACKET:
       return false;
@@ -309,86 +1026,558 @@ bool try_parse_impl(
       throw JsonException("unexpected token");
     }
   }
-  throw JsonException("unexpected program state");
-}
+};
 
 
 
-JsonValue parse(const std::string& json_lit) {
-  if (json_lit.empty()) {
+JsonValue parse(
+  const char* json_lit,
+  size_t size,
+  const JsonParseConfig& cfg
+) {
+  if (size == 0) {
     throw JsonException("json text is empty");
   }
   JsonValue rv;
-  Tokenizer tokenizer(json_lit);
-  if (!try_parse_impl(tokenizer, rv)) {
+  Tokenizer tokenizer(json_lit, size);
+  if (!try_parse_impl(tokenizer, cfg, rv)) {
     throw JsonException("unexpected close token");
   }
   return rv;
 }
-bool try_parse(const std::string& json_lit, JsonValue& out) {
+JsonValue parse(const std::string& json_lit, const JsonParseConfig& cfg) {
+  return parse(json_lit.data(), json_lit.size(), cfg);
+}
+JsonValue parse(const char* json_lit, size_t size) {
+  return parse(json_lit, size, {});
+}
+JsonValue parse(const std::string& json_lit) {
+  return parse(json_lit.data(), json_lit.size(), {});
+}
+bool try_parse(const char* json_lit, size_t size, JsonValue& out) {
   try {
-    out = parse(json_lit);
-  } catch (JsonException e) {
+    out = parse(json_lit, size);
+  } catch (const JsonException& e) {
     L_ERROR("failed to parse json: ", e.what());
+    return false;
+  }
+  return true;
+}
+bool try_parse(const std::string& json_lit, JsonValue& out) {
+  return try_parse(json_lit.data(), json_lit.size(), out);
+}
+
+void parse(const char* json_lit, size_t size, JsonDocument& out) {
+  if (size == 0) {
+    throw JsonException("json text is empty");
+  }
+  out.clear();
+  Tokenizer tokenizer(json_lit, size);
+  DocumentParser parser(tokenizer, out.arena());
+  JsonNode root;
+  if (!parser.try_parse_impl(root)) {
+    throw JsonException("unexpected close token");
+  }
+  out.set_root(root);
+}
+void parse(const std::string& json_lit, JsonDocument& out) {
+  parse(json_lit.data(), json_lit.size(), out);
+}
+
+enum JsonReaderExpect {
+  // A top-level value or an object member value.
+  L_JSON_READER_EXPECT_VALUE,
+  // An array element or the end of an empty array.
+  L_JSON_READER_EXPECT_FIRST_ELEM,
+  L_JSON_READER_EXPECT_ELEM,
+  // An object key or the end of an empty object.
+  L_JSON_READER_EXPECT_FIRST_KEY,
+  L_JSON_READER_EXPECT_KEY,
+  L_JSON_READER_EXPECT_COLON,
+  L_JSON_READER_EXPECT_COMMA_OR_CLOSE,
+};
+
+struct JsonReaderState {
+  JsonSource src;
+  // Window of the input. Unconsumed bytes are moved to the front before more
+  // input is read, and the window only grows if a single token doesn't fit.
+  std::vector<char> window;
+  Tokenizer tokenizer;
+  // True for objects, false for arrays.
+  std::vector<bool> scopes;
+  JsonReaderExpect expect;
+
+  JsonReaderState(const char* json_lit, size_t size) :
+    src(),
+    window(),
+    tokenizer(json_lit, size),
+    scopes(),
+    expect(L_JSON_READER_EXPECT_VALUE) {}
+  JsonReaderState(JsonSource&& src, size_t chunk_size) :
+    src(std::move(src)),
+    window(std::max<size_t>(chunk_size, 16)),
+    tokenizer(window.data(), 0),
+    scopes(),
+    expect(L_JSON_READER_EXPECT_VALUE)
+  {
+    tokenizer.is_final = false;
+  }
+
+  // Returns false if the input has been exhausted.
+  bool refill() {
+    if (tokenizer.is_final) {
+      return false;
+    }
+    size_t nremain = tokenizer.end - tokenizer.pos;
+    if (nremain == window.size()) {
+      std::vector<char> window2(window.size() * 2);
+      std::memcpy(window2.data(), tokenizer.pos, nremain);
+      window.swap(window2);
+    } else {
+      std::memmove(window.data(), tokenizer.pos, nremain);
+    }
+    size_t nread = src(window.data() + nremain, window.size() - nremain);
+    if (nread == 0) {
+      tokenizer.is_final = true;
+    }
+    tokenizer.pos = window.data();
+    tokenizer.end = window.data() + nremain + nread;
     return true;
   }
-  return false;
+  bool next_token(JsonToken& out) {
+    while (!tokenizer.next_token(out)) {
+      if (!refill()) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void end_value() {
+    expect = scopes.empty() ?
+      L_JSON_READER_EXPECT_VALUE : L_JSON_READER_EXPECT_COMMA_OR_CLOSE;
+  }
+  bool end_scope(bool is_obj, JsonEvent& out) {
+    if (scopes.empty() || scopes.back() != is_obj) {
+      throw JsonException("mismatched close token");
+    }
+    scopes.pop_back();
+    out.ty = is_obj ? L_JSON_EVENT_END_OBJECT : L_JSON_EVENT_END_ARRAY;
+    end_value();
+    return true;
+  }
+  bool begin_value(const JsonToken& token, JsonEvent& out) {
+    switch (token.ty) {
+    case L_JSON_TOKEN_NULL:
+      out.ty = L_JSON_EVENT_NULL;
+      break;
+    case L_JSON_TOKEN_TRUE:
+    case L_JSON_TOKEN_FALSE:
+      out.ty = L_JSON_EVENT_BOOLEAN;
+      out.b = token.ty == L_JSON_TOKEN_TRUE;
+      break;
+    case L_JSON_TOKEN_INT:
+      out.ty = L_JSON_EVENT_INT;
+      out.num_int = token.num_int;
+      out.num_float = token.num_float;
+      break;
+    case L_JSON_TOKEN_FLOAT:
+      out.ty = L_JSON_EVENT_FLOAT;
+      out.num_int = token.num_int;
+      out.num_float = token.num_float;
+      break;
+    case L_JSON_TOKEN_STRING:
+      out.ty = L_JSON_EVENT_STRING;
+      out.str = token.str;
+      break;
+    case L_JSON_TOKEN_OPEN_BRACE:
+      out.ty = L_JSON_EVENT_BEGIN_OBJECT;
+      scopes.push_back(true);
+      expect = L_JSON_READER_EXPECT_FIRST_KEY;
+      return true;
+    case L_JSON_TOKEN_OPEN_BRACKET:
+      out.ty = L_JSON_EVENT_BEGIN_ARRAY;
+      scopes.push_back(false);
+      expect = L_JSON_READER_EXPECT_FIRST_ELEM;
+      return true;
+    default:
+      throw JsonException("unexpected token, expected a value");
+    }
+    end_value();
+    return true;
+  }
+
+  bool next(JsonEvent& out) {
+    JsonToken token;
+    for (;;) {
+      if (!next_token(token)) {
+        if (expect != L_JSON_READER_EXPECT_VALUE || !scopes.empty()) {
+          throw JsonException("unexpected end of input");
+        }
+        return false;
+      }
+
+      switch (expect) {
+      case L_JSON_READER_EXPECT_VALUE:
+      case L_JSON_READER_EXPECT_ELEM:
+        return begin_value(token, out);
+      case L_JSON_READER_EXPECT_FIRST_ELEM:
+        if (token.ty == L_JSON_TOKEN_CLOSE_BRACKET) {
+          return end_scope(false, out);
+        }
+        return begin_value(token, out);
+      case L_JSON_READER_EXPECT_FIRST_KEY:
+      case L_JSON_READER_EXPECT_KEY:
+        if (token.ty == L_JSON_TOKEN_STRING) {
+          out.ty = L_JSON_EVENT_KEY;
+          out.str = token.str;
+          expect = L_JSON_READER_EXPECT_COLON;
+          return true;
+        }
+        if (
+          token.ty == L_JSON_TOKEN_CLOSE_BRACE &&
+          expect == L_JSON_READER_EXPECT_FIRST_KEY
+        ) {
+          return end_scope(true, out);
+        }
+        throw JsonException("unexpected object field key type");
+      case L_JSON_READER_EXPECT_COLON:
+        if (token.ty != L_JSON_TOKEN_COLON) {
+          throw JsonException("unexpected token in object");
+        }
+        expect = L_JSON_READER_EXPECT_VALUE;
+        continue;
+      case L_JSON_READER_EXPECT_COMMA_OR_CLOSE:
+        if (token.ty == L_JSON_TOKEN_COMMA) {
+          expect = scopes.back() ?
+            L_JSON_READER_EXPECT_KEY : L_JSON_READER_EXPECT_ELEM;
+          continue;
+        } else if (token.ty == L_JSON_TOKEN_CLOSE_BRACE) {
+          return end_scope(true, out);
+        } else if (token.ty == L_JSON_TOKEN_CLOSE_BRACKET) {
+          return end_scope(false, out);
+        }
+        throw JsonException("unexpected token in container");
+      }
+    }
+  }
+};
+
+JsonReader::JsonReader(const char* json_lit, size_t size) :
+  state_(std::make_unique<JsonReaderState>(json_lit, size)) {}
+JsonReader::JsonReader(JsonSource&& src, size_t chunk_size) :
+  state_(std::make_unique<JsonReaderState>(std::move(src), chunk_size)) {}
+JsonReader::JsonReader(JsonReader&&) = default;
+JsonReader& JsonReader::operator=(JsonReader&&) = default;
+JsonReader::~JsonReader() {}
+
+JsonReader JsonReader::from_stream(
+  stream::ReadStream& stream,
+  size_t chunk_size
+) {
+  JsonSource src = [&stream](char* dst, size_t size) {
+    size_t n = std::min(size, stream.size_remain());
+    stream.extract_data(dst, n);
+    return n;
+  };
+  return JsonReader(std::move(src), chunk_size);
+}
+JsonReader JsonReader::from_file(const char* path, size_t chunk_size) {
+  auto f = std::make_shared<std::ifstream>(path, std::ios::in | std::ios::binary);
+  if (!f->is_open()) {
+    throw JsonException("cannot open json file");
+  }
+  JsonSource src = [f](char* dst, size_t size) {
+    f->read(dst, size);
+    return (size_t)f->gcount();
+  };
+  return JsonReader(std::move(src), chunk_size);
 }
 
-void print_impl(const JsonValue& json, std::stringstream& out) {
-  switch (json.ty) {
-  case L_JSON_NULL:
-    out << "null";
-    return;
-  case L_JSON_BOOLEAN:
-    out << (json.b ? "true" : "false");
-    return;
-  case L_JSON_FLOAT:
-    out << json.num_float;
-    return;
-  case L_JSON_INT:
-    out << json.num_int;
+bool JsonReader::next(JsonEvent& out) {
+  return state_->next(out);
+}
+size_t JsonReader::depth() const {
+  return state_->scopes.size();
+}
+void JsonReader::skip_value(const JsonEvent& first) {
+  if (first.ty != L_JSON_EVENT_BEGIN_OBJECT &&
+    first.ty != L_JSON_EVENT_BEGIN_ARRAY)
+  {
     return;
-  case L_JSON_STRING:
-    out << "\"" << json.str << "\"";
+  }
+  size_t depth = state_->scopes.size() - 1;
+  JsonEvent event {};
+  while (state_->scopes.size() > depth) {
+    if (!state_->next(event)) {
+      throw JsonException("unexpected end of json");
+    }
+  }
+}
+
+bool read(JsonReader& reader, JsonSaxHandler& handler) {
+  JsonEvent event {};
+  while (reader.next(event)) {
+    bool should_continue = true;
+    switch (event.ty) {
+    case L_JSON_EVENT_NULL:
+      should_continue = handler.on_null();
+      break;
+    case L_JSON_EVENT_BOOLEAN:
+      should_continue = handler.on_bool(event.b);
+      break;
+    case L_JSON_EVENT_INT:
+      should_continue = handler.on_int(event.num_int);
+      break;
+    case L_JSON_EVENT_FLOAT:
+      should_continue = handler.on_float(event.num_float);
+      break;
+    case L_JSON_EVENT_STRING:
+      should_continue = handler.on_str(event.str);
+      break;
+    case L_JSON_EVENT_KEY:
+      should_continue = handler.on_key(event.str);
+      break;
+    case L_JSON_EVENT_BEGIN_OBJECT:
+      should_continue = handler.on_begin_object();
+      break;
+    case L_JSON_EVENT_END_OBJECT:
+      should_continue = handler.on_end_object();
+      break;
+    case L_JSON_EVENT_BEGIN_ARRAY:
+      should_continue = handler.on_begin_array();
+      break;
+    case L_JSON_EVENT_END_ARRAY:
+      should_continue = handler.on_end_array();
+      break;
+    }
+    if (!should_continue) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Printed text is appended to either a `std::string` or, through this adapter
+// of the same interface, directly to a `stream::WriteStream`.
+struct JsonStreamOutput {
+  stream::WriteStream& out;
+
+  inline void push_back(char c) {
+    *out.reserve_back(1) = (uint8_t)c;
+  }
+  inline void append(const char* beg, const char* end) {
+    out.append_data(beg, end - beg);
+  }
+  inline void append(const char* str) {
+    append(str, str + std::strlen(str));
+  }
+  inline void append(size_t n, char c) {
+    if (n != 0) {
+      std::memset(out.reserve_back(n), c, n);
+    }
+  }
+};
+
+// Append the shortest representation of `x` which parses back to exactly the
+// same value. Integral values are suffixed with `.0` so that they are still
+// parsed as floating-point numbers.
+template<typename TOut>
+void print_float(double x, TOut& out) {
+  if (!std::isfinite(x)) {
+    // JSON has no representation for infinities and NaNs.
+    out.append("null");
     return;
-  case L_JSON_OBJECT:
-    out << "{";
-    {
-      bool is_first_iter = true;
-      for (const auto& pair : json.obj.inner) {
-        if (is_first_iter) {
-          is_first_iter = false;
-        } else {
-          out << ",";
-        }
-        out << "\"" << pair.first << "\":";
-        print_impl(pair.second, out);
+  }
+  char buf[32];
+  char* end;
+#if defined(__cpp_lib_to_chars) && __cpp_lib_to_chars >= 201611L
+  end = std::to_chars(buf, buf + sizeof(buf), x).ptr;
+#else
+  // Fall back to the shortest of `%.15g`, `%.16g` and `%.17g` that round-trips.
+  for (int precision = 15; precision <= 17; ++precision) {
+    int len = std::snprintf(buf, sizeof(buf), "%.*g", precision, x);
+    end = buf + len;
+    if (std::strtod(buf, nullptr) == x) {
+      break;
+    }
+  }
+#endif
+  out.append(buf, end);
+  for (const char* pos = buf; pos != end; ++pos) {
+    if (*pos == '.' || *pos == 'e' || *pos == 'E') {
+      return;
+    }
+  }
+  out.append(".0");
+}
+template<typename TOut>
+void print_int(int64_t x, TOut& out) {
+  char buf[24];
+  char* end = std::to_chars(buf, buf + sizeof(buf), x).ptr;
+  out.append(buf, end);
+}
+template<typename TOut>
+void print_str(std::string_view str, TOut& out) {
+  static const char HEX_DIGITS[] = "0123456789abcdef";
+  out.push_back('"');
+  const char* pos = str.data();
+  const char* end = pos + str.size();
+  while (pos != end) {
+    // Copy the longest run of characters that need no escaping at once.
+    const char* seg_beg = pos;
+    while (pos != end) {
+      uint8_t c = (uint8_t)*pos;
+      if (c < 0x20 || c == '"' || c == '\\') {
+        break;
       }
+      ++pos;
     }
-    out << "}";
-    return;
-  case L_JSON_ARRAY:
-    out << "[";
-    {
-      bool is_first_iter = true;
-      for (const auto& elem : json.arr.inner) {
-        if (is_first_iter) {
-          is_first_iter = false;
-        } else {
-          out << ",";
+    out.append(seg_beg, pos);
+    if (pos == end) {
+      break;
+    }
+
+    char c = *(pos++);
+    switch (c) {
+    case '"': out.append("\\\""); break;
+    case '\\': out.append("\\\\"); break;
+    case '\b': out.append("\\b"); break;
+    case '\f': out.append("\\f"); break;
+    case '\n': out.append("\\n"); break;
+    case '\r': out.append("\\r"); break;
+    case '\t': out.append("\\t"); break;
+    default:
+      out.append("\\u00");
+      out.push_back(HEX_DIGITS[(c >> 4) & 0xF]);
+      out.push_back(HEX_DIGITS[c & 0xF]);
+      break;
+    }
+  }
+  out.push_back('"');
+}
+
+// Shared by `JsonValue` and `JsonNode` which expose the same accessors.
+template<typename TValue, typename TOut>
+struct JsonPrinter {
+  const JsonPrintConfig& cfg;
+  TOut& out;
+  size_t depth;
+
+  JsonPrinter(const JsonPrintConfig& cfg, TOut& out) :
+    cfg(cfg),
+    out(out),
+    depth(0) {}
+
+  void newline() {
+    if (cfg.indent != 0) {
+      out.push_back('\n');
+      out.append(depth * cfg.indent, ' ');
+    }
+  }
+
+  void print(const TValue& json) {
+    switch (json.ty) {
+    case L_JSON_NULL:
+      out.append("null");
+      return;
+    case L_JSON_BOOLEAN:
+      if (json.b) {
+        out.append("true");
+      } else {
+        out.append("false");
+      }
+      return;
+    case L_JSON_FLOAT:
+      print_float(json.num_float, out);
+      return;
+    case L_JSON_INT:
+      print_int(json.num_int, out);
+      return;
+    case L_JSON_STRING:
+      print_str(json.str_view(), out);
+      return;
+    case L_JSON_OBJECT:
+      out.push_back('{');
+      if (json.size() != 0) {
+        ++depth;
+        bool is_first_iter = true;
+        for (const auto& pair : json.fields()) {
+          if (is_first_iter) {
+            is_first_iter = false;
+          } else {
+            out.push_back(',');
+          }
+          newline();
+          print_str(pair.first, out);
+          out.push_back(':');
+          if (cfg.indent != 0) {
+            out.push_back(' ');
+          }
+          print(pair.second);
+        }
+        --depth;
+        newline();
+      }
+      out.push_back('}');
+      return;
+    case L_JSON_ARRAY:
+      out.push_back('[');
+      if (json.size() != 0) {
+        ++depth;
+        bool is_first_iter = true;
+        for (const auto& elem : json.elems()) {
+          if (is_first_iter) {
+            is_first_iter = false;
+          } else {
+            out.push_back(',');
+          }
+          newline();
+          print(elem);
         }
-        print_impl(elem, out);
+        --depth;
+        newline();
       }
+      out.push_back(']');
+      return;
     }
-    out << "]";
-    return;
   }
+};
+
+void print(const JsonValue& json, std::string& out, const JsonPrintConfig& cfg) {
+  JsonPrinter<JsonValue, std::string>(cfg, out).print(json);
+}
+void print(const JsonNode& json, std::string& out, const JsonPrintConfig& cfg) {
+  JsonPrinter<JsonNode, std::string>(cfg, out).print(json);
+}
+void print(
+  const JsonValue& json,
+  stream::WriteStream& out,
+  const JsonPrintConfig& cfg
+) {
+  JsonStreamOutput stream_out { out };
+  JsonPrinter<JsonValue, JsonStreamOutput>(cfg, stream_out).print(json);
+}
+void print(
+  const JsonNode& json,
+  stream::WriteStream& out,
+  const JsonPrintConfig& cfg
+) {
+  JsonStreamOutput stream_out { out };
+  JsonPrinter<JsonNode, JsonStreamOutput>(cfg, stream_out).print(json);
 }
 std::string print(const JsonValue& json) {
-  std::stringstream ss;
-  print_impl(json, ss);
-  return ss.str();
+  std::string out;
+  print(json, out, {});
+  return out;
+}
+std::string print(const JsonNode& json) {
+  std::string out;
+  print(json, out, {});
+  return out;
+}
+std::string print(const JsonDocument& doc) {
+  return print(doc.root());
 }
 
 } // namespace json
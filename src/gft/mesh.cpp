@@ -7,6 +7,7 @@
 #include "gft/mesh.hpp"
 #include "gft/assert.hpp"
 #include "gft/log.hpp"
+#include "gft/util.hpp"
 
 namespace liong {
 namespace mesh {
@@ -365,9 +366,13 @@ bool try_parse_obj(const std::string& obj, Mesh& mesh) {
   return parser.try_parse(mesh);
 }
 Mesh load_obj(const char* path) {
-  auto txt = util::load_text(path);
+  // Parse straight from the page cache instead of copying the text first.
+  util::MappedFile mapped_file(path,
+    util::L_MAPPED_FILE_ACCESS_HINT_SEQUENTIAL);
+  const char* beg = (const char*)mapped_file.data();
+  ObjParser parser(beg, beg + mapped_file.size());
   Mesh mesh{};
-  L_ASSERT(try_parse_obj(txt, mesh));
+  L_ASSERT(parser.try_parse(mesh));
   return mesh;
 }
 
@@ -0,0 +1,260 @@
+// QOI (Quite OK Image) codec.
+// @PENGUINLIONG
+#include <cstring>
+#include <iterator>
+#include "gft/assert.hpp"
+#include "gft/log.hpp"
+#include "gft/util.hpp"
+
+namespace liong {
+namespace util {
+
+namespace {
+
+const size_t QOI_HEADER_SIZE = 14;
+const uint8_t QOI_END_MARKER[8] = { 0, 0, 0, 0, 0, 0, 0, 1 };
+// Same limit as the reference implementation, so that malformed headers can't
+// request huge allocations.
+const uint64_t QOI_MAX_NPX = 400000000;
+
+const uint8_t QOI_OP_INDEX = 0x00;
+const uint8_t QOI_OP_DIFF = 0x40;
+const uint8_t QOI_OP_LUMA = 0x80;
+const uint8_t QOI_OP_RUN = 0xC0;
+const uint8_t QOI_OP_RGB = 0xFE;
+const uint8_t QOI_OP_RGBA = 0xFF;
+const uint8_t QOI_OP_MASK = 0xC0;
+
+inline uint32_t qoi_hash(uint32_t px) {
+  uint32_t r = px & 0xFF;
+  uint32_t g = (px >> 8) & 0xFF;
+  uint32_t b = (px >> 16) & 0xFF;
+  uint32_t a = px >> 24;
+  return (r * 3 + g * 5 + b * 7 + a * 11) & 63;
+}
+
+// Pixels are encoded row by row so that rows of floats can be packed on the
+// fly.
+struct QoiEncoder {
+  std::vector<uint8_t> out;
+  uint32_t index[64];
+  uint32_t prev;
+  uint32_t run;
+
+  QoiEncoder(uint32_t w, uint32_t h) : out(), index(), prev(0xFF000000),
+    run(0)
+  {
+    // Rendered frames usually compress to less than half of the raw size.
+    out.reserve(QOI_HEADER_SIZE + (size_t)w * h * 2);
+    out.resize(QOI_HEADER_SIZE);
+    uint8_t* dst = out.data();
+    std::memcpy(dst, "qoif", 4);
+    for (size_t i = 0; i < 4; ++i) {
+      dst[4 + i] = (uint8_t)(w >> (24 - i * 8));
+      dst[8 + i] = (uint8_t)(h >> (24 - i * 8));
+    }
+    // 4 channels in sRGB with linear alpha.
+    dst[12] = 4;
+    dst[13] = 0;
+  }
+
+  void encode_row(const uint32_t* pxs, size_t npx) {
+    // Every pixel takes at most 5 bytes.
+    size_t offset = out.size();
+    out.resize(offset + npx * 5);
+    uint8_t* dst = out.data() + offset;
+
+    for (size_t i = 0; i < npx; ++i) {
+      uint32_t px = pxs[i];
+      if (px == prev) {
+        if (++run == 62) {
+          *dst++ = QOI_OP_RUN | 61;
+          run = 0;
+        }
+        continue;
+      }
+      if (run > 0) {
+        *dst++ = QOI_OP_RUN | (uint8_t)(run - 1);
+        run = 0;
+      }
+
+      uint32_t h = qoi_hash(px);
+      if (index[h] == px) {
+        *dst++ = QOI_OP_INDEX | (uint8_t)h;
+      } else {
+        index[h] = px;
+        if ((px ^ prev) >> 24 == 0) {
+          // Channel differences wrap around.
+          int32_t vr = (int8_t)(uint8_t)(px - prev);
+          int32_t vg = (int8_t)(uint8_t)((px >> 8) - (prev >> 8));
+          int32_t vb = (int8_t)(uint8_t)((px >> 16) - (prev >> 16));
+          int32_t vg_r = vr - vg;
+          int32_t vg_b = vb - vg;
+          if (vr >= -2 && vr <= 1 && vg >= -2 && vg <= 1 && vb >= -2 &&
+            vb <= 1)
+          {
+            *dst++ = QOI_OP_DIFF | (uint8_t)((vr + 2) << 4 | (vg + 2) << 2 |
+              (vb + 2));
+          } else if (vg_r >= -8 && vg_r <= 7 && vg >= -32 && vg <= 31 &&
+            vg_b >= -8 && vg_b <= 7)
+          {
+            *dst++ = QOI_OP_LUMA | (uint8_t)(vg + 32);
+            *dst++ = (uint8_t)((vg_r + 8) << 4 | (vg_b + 8));
+          } else {
+            *dst++ = QOI_OP_RGB;
+            *dst++ = (uint8_t)px;
+            *dst++ = (uint8_t)(px >> 8);
+            *dst++ = (uint8_t)(px >> 16);
+          }
+        } else {
+          *dst++ = QOI_OP_RGBA;
+          std::memcpy(dst, &px, sizeof(px));
+          dst += sizeof(px);
+        }
+      }
+      prev = px;
+    }
+    out.resize(dst - out.data());
+  }
+
+  std::vector<uint8_t> finish() {
+    if (run > 0) {
+      out.push_back(QOI_OP_RUN | (uint8_t)(run - 1));
+      run = 0;
+    }
+    out.insert(out.end(), std::begin(QOI_END_MARKER), std::end(QOI_END_MARKER));
+    return std::move(out);
+  }
+};
+
+} // namespace
+
+std::vector<uint8_t> encode_qoi(const uint32_t* pxs, uint32_t w, uint32_t h) {
+  QoiEncoder encoder(w, h);
+  for (size_t i = 0; i < h; ++i) {
+    encoder.encode_row(pxs + i * w, w);
+  }
+  return encoder.finish();
+}
+std::vector<uint8_t> encode_qoi(const float* pxs, uint32_t w, uint32_t h) {
+  QoiEncoder encoder(w, h);
+  std::vector<uint32_t> row(w);
+  for (size_t i = 0; i < h; ++i) {
+    pack_rgba8(pxs + i * w * 4, w, row.data());
+    encoder.encode_row(row.data(), w);
+  }
+  return encoder.finish();
+}
+bool decode_qoi(const void* data, size_t size, Rgba8Image& out) {
+  const uint8_t* src = (const uint8_t*)data;
+  if (size < QOI_HEADER_SIZE + sizeof(QOI_END_MARKER) ||
+    std::memcmp(src, "qoif", 4) != 0)
+  {
+    L_ERROR("invalid qoi header");
+    return false;
+  }
+  uint32_t w = 0;
+  uint32_t h = 0;
+  for (size_t i = 0; i < 4; ++i) {
+    w = (w << 8) | src[4 + i];
+    h = (h << 8) | src[8 + i];
+  }
+  uint8_t nchannel = src[12];
+  uint64_t npx = (uint64_t)w * h;
+  if ((nchannel != 3 && nchannel != 4) || npx > QOI_MAX_NPX) {
+    L_ERROR("invalid qoi header");
+    return false;
+  }
+
+  out.width = w;
+  out.height = h;
+  out.pxs.resize(npx);
+  uint32_t* dst = out.pxs.data();
+
+  uint32_t index[64] = {};
+  uint32_t px = 0xFF000000;
+  // Ops never overlap the end marker.
+  const uint8_t* end = src + size - sizeof(QOI_END_MARKER);
+  src += QOI_HEADER_SIZE;
+  for (size_t i = 0; i < npx;) {
+    if (src >= end) {
+      L_ERROR("unexpected end of qoi image");
+      return false;
+    }
+    uint8_t op = *src++;
+    if (op == QOI_OP_RGB) {
+      if (end - src < 3) {
+        L_ERROR("unexpected end of qoi image");
+        return false;
+      }
+      px = (px & 0xFF000000) | (uint32_t)src[0] | ((uint32_t)src[1] << 8) |
+        ((uint32_t)src[2] << 16);
+      src += 3;
+    } else if (op == QOI_OP_RGBA) {
+      if (end - src < 4) {
+        L_ERROR("unexpected end of qoi image");
+        return false;
+      }
+      std::memcpy(&px, src, sizeof(px));
+      src += 4;
+    } else if ((op & QOI_OP_MASK) == QOI_OP_INDEX) {
+      px = index[op];
+    } else if ((op & QOI_OP_MASK) == QOI_OP_DIFF) {
+      uint32_t r = (px + ((op >> 4) & 3) - 2) & 0xFF;
+      uint32_t g = ((px >> 8) + ((op >> 2) & 3) - 2) & 0xFF;
+      uint32_t b = ((px >> 16) + (op & 3) - 2) & 0xFF;
+      px = (px & 0xFF000000) | r | (g << 8) | (b << 16);
+    } else if ((op & QOI_OP_MASK) == QOI_OP_LUMA) {
+      if (src >= end) {
+        L_ERROR("unexpected end of qoi image");
+        return false;
+      }
+      uint8_t op2 = *src++;
+      uint32_t vg = (op & 0x3F) - 32;
+      uint32_t r = (px + vg - 8 + ((op2 >> 4) & 0xF)) & 0xFF;
+      uint32_t g = ((px >> 8) + vg) & 0xFF;
+      uint32_t b = ((px >> 16) + vg - 8 + (op2 & 0xF)) & 0xFF;
+      px = (px & 0xFF000000) | r | (g << 8) | (b << 16);
+    } else {
+      // Runs are cut at the end of the image as in the reference decoder,
+      // which also indexes the color again.
+      size_t run = std::min<size_t>((op & 0x3F) + 1, npx - i);
+      index[qoi_hash(px)] = px;
+      std::fill(dst + i, dst + i + run, px);
+      i += run;
+      continue;
+    }
+    index[qoi_hash(px)] = px;
+    dst[i++] = px;
+  }
+  return true;
+}
+void save_qoi(
+  const uint32_t* pxs,
+  uint32_t w,
+  uint32_t h,
+  const char* path
+) {
+  std::vector<uint8_t> data = encode_qoi(pxs, w, h);
+  save_file(path, data.data(), data.size());
+}
+void save_qoi(
+  const float* pxs,
+  uint32_t w,
+  uint32_t h,
+  const char* path
+) {
+  std::vector<uint8_t> data = encode_qoi(pxs, w, h);
+  save_file(path, data.data(), data.size());
+}
+Rgba8Image load_qoi(const char* path) {
+  std::vector<uint8_t> data = load_file(path);
+  Rgba8Image out {};
+  if (!decode_qoi(data.data(), data.size(), out)) {
+    L_THROW("failed to decode qoi image: ", path);
+  }
+  return out;
+}
+
+} // namespace util
+} // namespace liong
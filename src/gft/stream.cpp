@@ -1,6 +1,8 @@
+#include <algorithm>
 #include <cstdlib>
 #include "gft/stream.hpp"
 #include "gft/assert.hpp"
+#include "gft/util.hpp"
 
 namespace liong {
 namespace stream {
@@ -12,6 +14,9 @@ ReadStream& ReadStream::skip(size_t n) {
 }
 void ReadStream::peek_data(void* out, size_t size) {
   L_ASSERT(size_remain() >= size);
+  if (size == 0) {
+    return;
+  }
   const void* buf = (const uint8_t*)data_ + offset_;
   std::memcpy(out, buf, size);
 }
@@ -20,11 +25,161 @@ void ReadStream::extract_data(void* out, size_t size) {
   offset_ += size;
 }
 
-void WriteStream::append_data(const void* data, size_t size) {
-  size_t offset = data_.size();
-  data_.resize(offset + size);
+void WriteStream::grow(size_t min_capacity) {
+  // Growing the vector value-initializes the new bytes, which is amortized
+  // over the appends by doubling the capacity.
+  size_t capacity = std::max<size_t>(data_.size() * 2, 64);
+  data_.resize(std::max(capacity, min_capacity));
+}
+void WriteStream::reserve(size_t capacity) {
+  if (capacity > data_.size()) {
+    data_.resize(capacity);
+  }
+}
+void WriteStream::patch_data(size_t offset, const void* data, size_t size) {
+  L_ASSERT(offset <= size_ && size <= size_ - offset,
+    "patch is out of the written range");
+  if (size == 0) {
+    return;
+  }
   std::memcpy(data_.data() + offset, data, size);
 }
 
+MappedReadStream::MappedReadStream(
+  std::shared_ptr<const util::MappedFile>&& mapped_file
+) :
+  ReadStream(mapped_file->data(), mapped_file->size()),
+  mapped_file_(std::move(mapped_file)) {}
+MappedReadStream::MappedReadStream(const char* path) :
+  MappedReadStream(std::make_shared<util::MappedFile>(path)) {}
+
+FileReadStream::FileReadStream(const char* path, size_t buffer_size) :
+  f_(path, std::ios::ate | std::ios::binary | std::ios::in),
+  buffer_(),
+  buffer_offset_(0),
+  buffer_size_(0),
+  size_(0),
+  offset_(0)
+{
+  if (!f_.is_open()) {
+    L_THROW("unable to open file: ", path);
+  }
+  L_ASSERT(buffer_size > 0);
+  std::streamoff size = f_.tellg();
+  if (size < 0) {
+    L_THROW("unable to get file size: ", path);
+  }
+  size_ = (uint64_t)size;
+  f_.seekg(0, std::ios::beg);
+  buffer_.resize(buffer_size);
+}
+void FileReadStream::fill_buffer(size_t size) {
+  if (buffer_size_ >= size) {
+    return;
+  }
+  // Move the remaining data to the front and fill up the rest.
+  std::memmove(buffer_.data(), buffer_.data() + buffer_offset_, buffer_size_);
+  buffer_offset_ = 0;
+  size_t nread = (size_t)std::min<uint64_t>(buffer_.size() - buffer_size_,
+    size_remain() - buffer_size_);
+  f_.read((char*)buffer_.data() + buffer_size_, nread);
+  if (f_.gcount() != (std::streamsize)nread) {
+    L_THROW("failed to read file");
+  }
+  buffer_size_ += nread;
+}
+void FileReadStream::peek_data(void* out, size_t size) {
+  L_ASSERT(size_remain() >= size);
+  L_ASSERT(size <= buffer_.size(), "peek is larger than the buffer");
+  if (size == 0) {
+    return;
+  }
+  fill_buffer(size);
+  std::memcpy(out, buffer_.data() + buffer_offset_, size);
+}
+void FileReadStream::extract_data(void* out, size_t size) {
+  L_ASSERT(size_remain() >= size);
+  if (size == 0) {
+    return;
+  }
+  if (size <= buffer_.size()) {
+    fill_buffer(size);
+    std::memcpy(out, buffer_.data() + buffer_offset_, size);
+    buffer_offset_ += size;
+    buffer_size_ -= size;
+  } else {
+    // Drain the buffer and read the rest directly.
+    size_t nbuffered = buffer_size_;
+    std::memcpy(out, buffer_.data() + buffer_offset_, nbuffered);
+    buffer_offset_ = 0;
+    buffer_size_ = 0;
+    f_.read((char*)out + nbuffered, size - nbuffered);
+    if (f_.gcount() != (std::streamsize)(size - nbuffered)) {
+      L_THROW("failed to read file");
+    }
+  }
+  offset_ += size;
+}
+FileReadStream& FileReadStream::skip(uint64_t n) {
+  L_ASSERT(size_remain() >= n);
+  if (n <= buffer_size_) {
+    buffer_offset_ += n;
+    buffer_size_ -= n;
+  } else {
+    f_.seekg(offset_ + n, std::ios::beg);
+    buffer_offset_ = 0;
+    buffer_size_ = 0;
+  }
+  offset_ += n;
+  return *this;
+}
+
+FileWriteStream::FileWriteStream(const char* path, size_t buffer_size) :
+  f_(path, std::ios::trunc | std::ios::out | std::ios::binary),
+  buffer_(),
+  buffer_size_(0),
+  size_(0)
+{
+  if (!f_.is_open()) {
+    L_THROW("unable to open file: ", path);
+  }
+  L_ASSERT(buffer_size > 0);
+  buffer_.resize(buffer_size);
+}
+FileWriteStream::~FileWriteStream() {
+  if (f_.is_open() && buffer_size_ > 0) {
+    f_.write((const char*)buffer_.data(), buffer_size_);
+  }
+}
+void FileWriteStream::append_data(const void* data, size_t size) {
+  if (size == 0) {
+    return;
+  }
+  if (buffer_.size() - buffer_size_ < size) {
+    flush();
+  }
+  if (size < buffer_.size()) {
+    std::memcpy(buffer_.data() + buffer_size_, data, size);
+    buffer_size_ += size;
+  } else {
+    // Write large data directly.
+    f_.write((const char*)data, size);
+    if (!f_.good()) {
+      L_THROW("failed to write file");
+    }
+  }
+  size_ += size;
+}
+void FileWriteStream::flush() {
+  if (buffer_size_ > 0) {
+    f_.write((const char*)buffer_.data(), buffer_size_);
+    buffer_size_ = 0;
+  }
+  f_.flush();
+  if (!f_.good()) {
+    L_THROW("failed to write file");
+  }
+}
+
 } // namespace stream
 } // namespace liong
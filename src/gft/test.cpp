@@ -1,6 +1,9 @@
+#include <algorithm>
 #include <exception>
+#include <limits>
 #include "gft/test.hpp"
 #include "gft/log.hpp"
+#include "gft/util.hpp"
 
 namespace liong {
 
@@ -23,22 +26,42 @@ int TestRegistry::reg(
   const std::string& name,
   std::function<void()>&& func
 ) {
-  tests.emplace(name, Entry { func });
+  tests.emplace(name, Entry { func, false });
+  return 0;
+}
+int TestRegistry::reg_bench(
+  const std::string& name,
+  std::function<void()>&& func
+) {
+  tests.emplace(name, Entry { func, true });
   return 0;
 }
 
 TestReport TestRegistry::run_all() {
+  return run_all(false);
+}
+TestReport TestRegistry::run_all(bool should_run_benches) {
   const auto& tests = get_inst().tests;
 
+  size_t ntest = 0;
+  for (const auto& pair : tests) {
+    if (should_run_benches || !pair.second.is_bench) {
+      ++ntest;
+    }
+  }
+
   TestReport out {};
-  if (tests.empty()) {
+  if (ntest == 0) {
     L_INFO("no test to run");
     return out;
   } else {
-    L_INFO("scheduling ", tests.size(), " tests");
+    L_INFO("scheduling ", ntest, " tests");
   }
 
   for (const auto& pair : tests) {
+    if (!should_run_benches && pair.second.is_bench) {
+      continue;
+    }
     L_INFO("[", pair.first, "]");
     log::push_indent();
     try {
@@ -59,6 +82,18 @@ TestReport TestRegistry::run_all() {
   return out;
 }
 
+double bench_us(size_t nrun, const std::function<void()>& f) {
+  util::Timer timer {};
+  double best_us = std::numeric_limits<double>::max();
+  for (size_t i = 0; i < nrun; ++i) {
+    timer.tic();
+    f();
+    timer.toc();
+    best_us = std::min(best_us, timer.us());
+  }
+  return best_us;
+}
+
 } // namespace test
 
 } // namespace liong
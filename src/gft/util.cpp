@@ -1,33 +1,198 @@
 #include "gft/util.hpp"
 #include "gft/assert.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <memory>
 #include <thread>
+#include <utility>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#undef NOMINMAX
+#undef WIN32_LEAN_AND_MEAN
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // defined(_WIN32)
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define L_HAS_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#else
+#define L_HAS_IO_URING 0
+#endif // defined(__linux__) && __has_include(<linux/io_uring.h>)
+#if defined(__x86_64__) || defined(_M_X64)
+#define L_HAS_CRC32_PCLMUL 1
+#include <emmintrin.h>
+#include <wmmintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define L_CRC32_PCLMUL_TARGET
+#else
+#define L_CRC32_PCLMUL_TARGET __attribute__((target("pclmul,sse2")))
+#endif // defined(_MSC_VER)
+#else
+#define L_HAS_CRC32_PCLMUL 0
+#endif // defined(__x86_64__) || defined(_M_X64)
 
 namespace liong {
 
 namespace util {
 
-std::vector<uint8_t> load_file(const char* path) {
+uint64_t get_file_size(const char* path) {
+#if defined(_WIN32)
+  WIN32_FILE_ATTRIBUTE_DATA attrs;
+  if (!GetFileAttributesExA(path, GetFileExInfoStandard, &attrs)) {
+    L_THROW("unable to get file size: ", path);
+  }
+  return ((uint64_t)attrs.nFileSizeHigh << 32) | attrs.nFileSizeLow;
+#else
+  struct stat st;
+  if (stat(path, &st) != 0) {
+    L_THROW("unable to get file size: ", path);
+  }
+  return (uint64_t)st.st_size;
+#endif // defined(_WIN32)
+}
+
+#if !defined(_WIN32)
+// Read `size` bytes at `offset` of the file, retrying on short reads. Returns
+// the number of bytes read, which is less than `size` only at the end of file.
+// Returns -1 on failure.
+ssize_t pread_all(int fd, void* out, size_t size, uint64_t offset) {
+  size_t nread = 0;
+  while (nread < size) {
+    ssize_t n = pread(fd, (uint8_t*)out + nread, size - nread,
+      (off_t)(offset + nread));
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      return -1;
+    }
+    if (n == 0) { break; }
+    nread += n;
+  }
+  return (ssize_t)nread;
+}
+#endif // !defined(_WIN32)
+
+size_t load_file(
+  const char* path,
+  void* out,
+  size_t out_size,
+  const LoadFileConfig& cfg
+) {
+#if defined(_WIN32)
   std::ifstream f(path, std::ios::ate | std::ios::binary | std::ios::in);
-  L_ASSERT(f.is_open(), "unable to open file: ", path);
+  if (!f.is_open()) {
+    L_THROW("unable to open file: ", path);
+  }
   size_t size = f.tellg();
-  f.seekg(std::ios::beg);
-  std::vector<uint8_t> buf;
+  if (out_size < size) {
+    L_THROW("buffer is too small for file: ", path);
+  }
+  f.seekg(0, std::ios::beg);
+  f.read((char*)out, size);
+  if (f.gcount() != (std::streamsize)size) {
+    L_THROW("failed to read file: ", path);
+  }
+  return size;
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    L_THROW("unable to open file: ", path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    L_THROW("unable to get file size: ", path);
+  }
+  size_t size = (size_t)st.st_size;
+  if (out_size < size) {
+    close(fd);
+    L_THROW("buffer is too small for file: ", path);
+  }
+
+  // Direct I/O requires the buffer, offsets and sizes to be aligned to the
+  // logical block size; 4KB is safe in practice. The unaligned tail is read
+  // with buffered I/O.
+  const size_t DIRECT_IO_ALIGNMENT = 4096;
+  int direct_fd = -1;
+  size_t direct_size = 0;
+#if defined(O_DIRECT)
+  if (cfg.direct_io && (uintptr_t)out % DIRECT_IO_ALIGNMENT == 0) {
+    direct_fd = open(path, O_RDONLY | O_DIRECT);
+    if (direct_fd >= 0) {
+      direct_size = align_down(size, DIRECT_IO_ALIGNMENT);
+    }
+  }
+#endif // defined(O_DIRECT)
+
+  size_t chunk_size = std::max(
+    align_up(cfg.chunk_size, DIRECT_IO_ALIGNMENT), DIRECT_IO_ALIGNMENT);
+  size_t nchunk = div_up(size, chunk_size);
+  std::atomic<bool> is_failed { false };
+  auto read_chunk = [&](size_t i) {
+    size_t offset = i * chunk_size;
+    size_t end = std::min(offset + chunk_size, size);
+    uint8_t* dst = (uint8_t*)out + offset;
+    if (offset < direct_size) {
+      size_t direct_end = std::min(end, direct_size);
+      ssize_t n = pread_all(direct_fd, dst, direct_end - offset, offset);
+      if (n >= 0) {
+        offset += n;
+        dst += n;
+      }
+      // Anything left, e.g. if the file system rejected direct I/O after all,
+      // is read with buffered I/O.
+    }
+    if (offset < end &&
+      pread_all(fd, dst, end - offset, offset) != (ssize_t)(end - offset))
+    {
+      is_failed = true;
+    }
+  };
+  if (cfg.thread_pool != nullptr && nchunk > 1) {
+    cfg.thread_pool->parallel_for(nchunk, read_chunk);
+  } else {
+    for (size_t i = 0; i < nchunk; ++i) {
+      read_chunk(i);
+    }
+  }
+
+  if (direct_fd >= 0) {
+    close(direct_fd);
+  }
+  close(fd);
+  if (is_failed) {
+    L_THROW("failed to read file: ", path);
+  }
+  return size;
+#endif // defined(_WIN32)
+}
+std::vector<uint8_t> load_file(const char* path, const LoadFileConfig& cfg) {
+  std::vector<uint8_t> buf(get_file_size(path));
+  size_t size = load_file(path, buf.data(), buf.size(), cfg);
+  // The file might have been truncated in the meantime.
   buf.resize(size);
-  f.read((char*)buf.data(), size);
-  f.close();
   return buf;
 }
+std::vector<uint8_t> load_file(const char* path) {
+  return load_file(path, {});
+}
 std::string load_text(const char* path) {
-  std::ifstream f(path, std::ios::ate | std::ios::binary | std::ios::in);
-  L_ASSERT(f.is_open(), "unable to open file: ", path);
-  size_t size = f.tellg();
-  f.seekg(std::ios::beg);
   std::string buf;
-  buf.reserve(size + 1);
+  buf.resize(get_file_size(path));
+  size_t size = load_file(path, buf.data(), buf.size(), {});
   buf.resize(size);
-  f.read((char*)buf.data(), size);
-  f.close();
   return buf;
 }
 void save_file(const char* path, const void* data, size_t size) {
@@ -43,60 +208,909 @@ void save_text(const char* path, const std::string& txt) {
   f.close();
 }
 
-// Save an array of 8-bit unsigned int colors with RGBA channels packed from LSB
-// to MSB in a 32-bit unsigned int into a bitmap file.
-void save_bmp(
-  const uint32_t* pxs,
-  uint32_t w,
-  uint32_t h,
-  const char* path
-) {
-  std::fstream f(path, std::ios::out | std::ios::binary | std::ios::trunc);
-  f.write("BM", 2);
+namespace {
+
+// `out` doesn't have to be aligned, e.g. pixels in a bitmap file start at an
+// offset of 122 bytes.
+void pack_rgba8(const float* pxs, size_t npx, uint8_t* out) {
+  size_t i = 0;
+#if defined(__x86_64__) || defined(_M_X64)
+  // SSE2 is always available on x86-64. Four pixels are converted at a time
+  // and narrowed with saturation, which is exact after clamping.
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 scale = _mm_set1_ps(255.0f);
+  auto cvt = [&](const float* px) {
+    // `_mm_max_ps` returns the second operand on NaN.
+    __m128 v = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(px), zero), one);
+    return _mm_cvttps_epi32(_mm_mul_ps(v, scale));
+  };
+  for (; i + 4 <= npx; i += 4) {
+    const float* px = pxs + i * 4;
+    __m128i lo = _mm_packs_epi32(cvt(px), cvt(px + 4));
+    __m128i hi = _mm_packs_epi32(cvt(px + 8), cvt(px + 12));
+    _mm_storeu_si128((__m128i*)(out + i * 4), _mm_packus_epi16(lo, hi));
+  }
+#endif // defined(__x86_64__) || defined(_M_X64)
+  auto cvt1 = [](float x) {
+    return (uint8_t)((x > 0.0f ? (x < 1.0f ? x : 1.0f) : 0.0f) * 255.0f);
+  };
+  for (i *= 4; i < npx * 4; ++i) {
+    out[i] = cvt1(pxs[i]);
+  }
+}
+
+} // namespace
+
+void pack_rgba8(const float* pxs, size_t npx, uint32_t* out) {
+  pack_rgba8(pxs, npx, (uint8_t*)out);
+}
+
+namespace {
+
+const size_t BMP_HEADER_SIZE = 14 + 108;
+
+// Resize `out` to the file content with the headers filled in. Rows of pixels
+// follow the headers bottom-up. Existing storage is reused.
+uint8_t* alloc_bmp(uint32_t w, uint32_t h, std::vector<uint8_t>& out) {
   uint32_t img_size = w * h * sizeof(uint32_t);
-  uint32_t bmfile_hdr[] = { 14 + 108 + img_size, 0, 14 + 108 };
-  f.write((const char*)bmfile_hdr, sizeof(bmfile_hdr));
+  out.resize(BMP_HEADER_SIZE + img_size);
+  uint8_t* dst = out.data();
+  std::memcpy(dst, "BM", 2);
+  uint32_t bmfile_hdr[] = { (uint32_t)BMP_HEADER_SIZE + img_size, 0,
+    (uint32_t)BMP_HEADER_SIZE };
+  std::memcpy(dst + 2, bmfile_hdr, sizeof(bmfile_hdr));
   uint32_t bmcore_hdr[] = {
     108, w, h, 1 | (32 << 16), 3, img_size, 2835, 2835, 0, 0,
     0x000000FF, 0x0000FF00, 0x00FF0000, 0xFF000000, 0x57696E20,
     0,0,0,0,0,0,0,0,0,0,0,0,
   };
-  f.write((const char*)bmcore_hdr, sizeof(bmcore_hdr));
-  uint32_t buf;
-  for (auto i = 0; i < h; ++i) {
-    for (auto j = 0; j < w; ++j) {
-      buf = pxs[(h - i - 1) * w + j];
-      f.write((const char*)&buf, sizeof(uint32_t));
-    }
+  std::memcpy(dst + 14, bmcore_hdr, sizeof(bmcore_hdr));
+  return dst + BMP_HEADER_SIZE;
+}
+
+// Colors are 8-bit unsigned ints with RGBA channels packed from LSB to MSB in a
+// 32-bit unsigned int.
+void encode_bmp(
+  const uint32_t* pxs,
+  uint32_t w,
+  uint32_t h,
+  std::vector<uint8_t>& out
+) {
+  uint8_t* dst = alloc_bmp(w, h, out);
+  size_t row_size = (size_t)w * sizeof(uint32_t);
+  for (size_t i = 0; i < h; ++i) {
+    std::memcpy(dst + i * row_size, pxs + (h - i - 1) * (size_t)w, row_size);
+  }
+}
+// Colors are 32-bit floating points with RGBA channels.
+void encode_bmp(
+  const float* pxs,
+  uint32_t w,
+  uint32_t h,
+  std::vector<uint8_t>& out
+) {
+  uint8_t* dst = alloc_bmp(w, h, out);
+  size_t row_size = (size_t)w * sizeof(uint32_t);
+  for (size_t i = 0; i < h; ++i) {
+    pack_rgba8(pxs + (h - i - 1) * (size_t)w * 4, w, dst + i * row_size);
   }
-  f.flush();
-  f.close();
 }
-// Save an array of 32-bit floating point colors with RGBA channels into a
-// bitmap file.
+
+} // namespace
+
+std::vector<uint8_t> encode_bmp(const uint32_t* pxs, uint32_t w, uint32_t h) {
+  std::vector<uint8_t> out;
+  encode_bmp(pxs, w, h, out);
+  return out;
+}
+std::vector<uint8_t> encode_bmp(const float* pxs, uint32_t w, uint32_t h) {
+  std::vector<uint8_t> out;
+  encode_bmp(pxs, w, h, out);
+  return out;
+}
+void save_bmp(
+  const uint32_t* pxs,
+  uint32_t w,
+  uint32_t h,
+  const char* path
+) {
+  std::vector<uint8_t> data = encode_bmp(pxs, w, h);
+  save_file(path, data.data(), data.size());
+}
 void save_bmp(
   const float* pxs,
   uint32_t w,
   uint32_t h,
   const char* path
 ) {
-  std::vector<uint32_t> packed_pxs;
-  packed_pxs.resize(w * h * 4);
-  size_t npx = (size_t)w * (size_t)h;
-  for (size_t i = 0; i < npx; ++i) {
-    uint32_t r = (uint32_t)((float)pxs[i * 4 + 0] * 255.0f);
-    uint32_t g = (uint32_t)((float)pxs[i * 4 + 1] * 255.0f);
-    uint32_t b = (uint32_t)((float)pxs[i * 4 + 2] * 255.0f);
-    uint32_t a = (uint32_t)((float)pxs[i * 4 + 3] * 255.0f);
-    packed_pxs[i] = (r << 0) | (g << 8) | (b << 16) | (a << 24);
+  std::vector<uint8_t> data = encode_bmp(pxs, w, h);
+  save_file(path, data.data(), data.size());
+}
+
+MappedFile::MappedFile(const char* path) :
+  data_(nullptr),
+  size_(0),
+  handle_(nullptr)
+{
+#if defined(_WIN32)
+  HANDLE file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr,
+    OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+  if (file == INVALID_HANDLE_VALUE) {
+    L_THROW("unable to open file: ", path);
+  }
+  LARGE_INTEGER size;
+  if (!GetFileSizeEx(file, &size)) {
+    CloseHandle(file);
+    L_THROW("unable to get file size: ", path);
   }
-  save_bmp(packed_pxs.data(), w, h, path);
+  size_ = (size_t)size.QuadPart;
+  if (size_ > 0) {
+    handle_ = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    // The mapping object keeps its own reference to the file.
+    CloseHandle(file);
+    if (handle_ == nullptr) {
+      L_THROW("unable to map file: ", path);
+    }
+    data_ = MapViewOfFile(handle_, FILE_MAP_READ, 0, 0, 0);
+    if (data_ == nullptr) {
+      CloseHandle(handle_);
+      handle_ = nullptr;
+      L_THROW("unable to map file: ", path);
+    }
+  } else {
+    CloseHandle(file);
+  }
+#else
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    L_THROW("unable to open file: ", path);
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    close(fd);
+    L_THROW("unable to get file size: ", path);
+  }
+  size_ = (size_t)st.st_size;
+  // Empty files cannot be mapped.
+  if (size_ > 0) {
+    void* data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping keeps its own reference to the file.
+    close(fd);
+    if (data == MAP_FAILED) {
+      L_THROW("unable to map file: ", path);
+    }
+    data_ = data;
+  } else {
+    close(fd);
+  }
+#endif // defined(_WIN32)
+}
+MappedFile::MappedFile(const char* path, MappedFileAccessHint hint) :
+  MappedFile(path)
+{
+  advise(hint);
+}
+MappedFile::MappedFile(MappedFile&& b) :
+  data_(std::exchange(b.data_, nullptr)),
+  size_(std::exchange(b.size_, 0)),
+  handle_(std::exchange(b.handle_, nullptr)) {}
+MappedFile& MappedFile::operator=(MappedFile&& b) {
+  if (this != &b) {
+    release();
+    data_ = std::exchange(b.data_, nullptr);
+    size_ = std::exchange(b.size_, 0);
+    handle_ = std::exchange(b.handle_, nullptr);
+  }
+  return *this;
+}
+void MappedFile::advise(MappedFileAccessHint hint) const {
+  advise(hint, 0, size_);
+}
+void MappedFile::advise(
+  MappedFileAccessHint hint,
+  size_t offset,
+  size_t size
+) const {
+  L_ASSERT(offset <= size_ && size <= size_ - offset,
+    "advised range is out of the mapping");
+  if (data_ == nullptr || size == 0) {
+    return;
+  }
+#if defined(_WIN32)
+  // There is no equivalent of access pattern hints for file mappings.
+  (void)hint;
+#else
+  int advice = POSIX_MADV_NORMAL;
+  switch (hint) {
+  case L_MAPPED_FILE_ACCESS_HINT_NORMAL: advice = POSIX_MADV_NORMAL; break;
+  case L_MAPPED_FILE_ACCESS_HINT_SEQUENTIAL:
+    advice = POSIX_MADV_SEQUENTIAL;
+    break;
+  case L_MAPPED_FILE_ACCESS_HINT_RANDOM: advice = POSIX_MADV_RANDOM; break;
+  case L_MAPPED_FILE_ACCESS_HINT_WILL_NEED:
+    advice = POSIX_MADV_WILLNEED;
+    break;
+  default: L_PANIC("unknown mapped file access hint");
+  }
+  // The advised range has to start at a page boundary.
+  static const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+  size_t beg = align_down(offset, page_size);
+  posix_madvise((uint8_t*)const_cast<void*>(data_) + beg,
+    offset + size - beg, advice);
+#endif // defined(_WIN32)
+}
+void MappedFile::release() {
+  if (data_ != nullptr) {
+#if defined(_WIN32)
+    UnmapViewOfFile(data_);
+    CloseHandle(handle_);
+#else
+    munmap(const_cast<void*>(data_), size_);
+#endif // defined(_WIN32)
+  }
+  data_ = nullptr;
+  size_ = 0;
+  handle_ = nullptr;
 }
 
 void sleep_for_us(uint64_t t) {
   std::this_thread::sleep_for(std::chrono::microseconds(t));
 }
 
+ThreadPool::ThreadPool(size_t nthread) : is_stopping_(false) {
+  if (nthread == 0) {
+    nthread = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+  }
+  threads_.reserve(nthread);
+  for (size_t i = 0; i < nthread; ++i) {
+    threads_.emplace_back([this]() { run_worker(); });
+  }
+}
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    is_stopping_ = true;
+  }
+  cv_.notify_all();
+  for (std::thread& thread : threads_) {
+    thread.join();
+  }
+}
+void ThreadPool::run_worker() {
+  for (;;) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return is_stopping_ || !tasks_.empty(); });
+      if (tasks_.empty()) { return; }
+      task = std::move(tasks_.front());
+      tasks_.pop_front();
+    }
+    task();
+  }
+}
+void ThreadPool::submit(std::function<void()>&& task) {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    tasks_.emplace_back(std::move(task));
+  }
+  cv_.notify_one();
+}
+void ThreadPool::parallel_for(
+  size_t n,
+  const std::function<void(size_t)>& f
+) {
+  if (n == 0) { return; }
+
+  // Helpers might be scheduled after all the work is done and this call has
+  // returned, so the state is shared with them. `f` is only accessed while
+  // there are indices left, which keeps this call waiting.
+  struct State {
+    const std::function<void(size_t)>* f;
+    size_t n;
+    std::atomic<size_t> next;
+    std::atomic<size_t> ndone;
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::exception_ptr exception;
+  };
+  std::shared_ptr<State> state = std::make_shared<State>();
+  state->f = &f;
+  state->n = n;
+  state->next = 0;
+  state->ndone = 0;
+
+  auto work = [](State& state) {
+    for (;;) {
+      size_t i = state.next.fetch_add(1);
+      if (i >= state.n) { break; }
+      try {
+        (*state.f)(i);
+      } catch (...) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        if (state.exception == nullptr) {
+          state.exception = std::current_exception();
+        }
+      }
+      if (state.ndone.fetch_add(1) + 1 == state.n) {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.cv.notify_all();
+      }
+    }
+  };
+
+  size_t nhelper = std::min(nthread(), n - 1);
+  for (size_t i = 0; i < nhelper; ++i) {
+    submit([state, work]() { work(*state); });
+  }
+  work(*state);
+
+  std::unique_lock<std::mutex> lock(state->mutex);
+  state->cv.wait(lock, [&]() { return state->ndone == n; });
+  if (state->exception != nullptr) {
+    std::rethrow_exception(state->exception);
+  }
+}
+ThreadPool& ThreadPool::global() {
+  static ThreadPool pool;
+  return pool;
+}
+
+struct AsyncIoRequest {
+  std::string path;
+  bool is_write;
+  // Truncate the file on open. Only for writes.
+  bool truncate;
+  uint8_t* data;
+  size_t size;
+  uint64_t offset;
+  AsyncIoCallback callback;
+#if !defined(_WIN32)
+  int fd;
+#endif // !defined(_WIN32)
+#if L_HAS_IO_URING
+  size_t ntransferred;
+  struct iovec iov;
+#endif // L_HAS_IO_URING
+};
+
+class AsyncIoQueue {
+public:
+  virtual ~AsyncIoQueue() {}
+  // Take the ownership of `req` and call back once it's complete. The callback
+  // is called on the submitting thread if the file can't be opened.
+  virtual void submit(std::unique_ptr<AsyncIoRequest>&& req) = 0;
+};
+
+namespace {
+
+#if !defined(_WIN32)
+// Returns the file descriptor, or a negative error code.
+int open_async_io_file(const AsyncIoRequest& req) {
+  int flags = O_RDONLY;
+  if (req.is_write) {
+    flags = O_WRONLY | O_CREAT | (req.truncate ? O_TRUNC : 0);
+  }
+  int fd = open(req.path.c_str(), flags | O_CLOEXEC, 0644);
+  return fd >= 0 ? fd : -errno;
+}
+ssize_t pwrite_all(int fd, const void* data, size_t size, uint64_t offset) {
+  size_t nwritten = 0;
+  while (nwritten < size) {
+    ssize_t n = pwrite(fd, (const uint8_t*)data + nwritten, size - nwritten,
+      (off_t)(offset + nwritten));
+    if (n < 0) {
+      if (errno == EINTR) { continue; }
+      return -1;
+    }
+    nwritten += n;
+  }
+  return (ssize_t)nwritten;
+}
+#endif // !defined(_WIN32)
+
+// Serve the request with blocking I/O.
+int64_t transfer_async_io_request(const AsyncIoRequest& req) {
+#if defined(_WIN32)
+  if (req.is_write) {
+    std::ios::openmode mode = std::ios::binary | std::ios::out;
+    // Open with `in` as well to keep the existing content.
+    std::fstream f(req.path, mode | (req.truncate ? std::ios::trunc : std::ios::in));
+    if (!f.is_open()) {
+      f.open(req.path, mode);
+    }
+    if (!f.is_open()) { return -1; }
+    f.seekp(req.offset);
+    f.write((const char*)req.data, req.size);
+    return f.good() ? (int64_t)req.size : -1;
+  } else {
+    std::ifstream f(req.path, std::ios::binary | std::ios::in);
+    if (!f.is_open()) { return -1; }
+    f.seekg(req.offset);
+    f.read((char*)req.data, req.size);
+    return f.bad() ? -1 : (int64_t)f.gcount();
+  }
+#else
+  int fd = open_async_io_file(req);
+  if (fd < 0) { return fd; }
+  ssize_t n = req.is_write ?
+    pwrite_all(fd, req.data, req.size, req.offset) :
+    pread_all(fd, req.data, req.size, req.offset);
+  int64_t res = n < 0 ? -errno : (int64_t)n;
+  close(fd);
+  return res;
+#endif // defined(_WIN32)
+}
+
+class ThreadPoolAsyncIoQueue : public AsyncIoQueue {
+  ThreadPool thread_pool_;
+
+public:
+  ThreadPoolAsyncIoQueue(uint32_t nthread) : thread_pool_(nthread) {}
+  // Queued requests are served before the threads are joined.
+  virtual ~ThreadPoolAsyncIoQueue() {}
+
+  virtual void submit(std::unique_ptr<AsyncIoRequest>&& req) override {
+    std::shared_ptr<AsyncIoRequest> req2(std::move(req));
+    thread_pool_.submit([req2]() {
+      req2->callback(transfer_async_io_request(*req2));
+    });
+  }
+};
+
+#if L_HAS_IO_URING
+// A minimal io_uring driver over the raw system calls. Requests are pushed to
+// the submission queue under a lock and reaped by a dedicated completion
+// thread, which resubmits short transfers until the request is complete.
+class IoUringAsyncIoQueue : public AsyncIoQueue {
+  int fd_;
+  void* sq_ring_;
+  size_t sq_ring_size_;
+  void* cq_ring_;
+  size_t cq_ring_size_;
+  struct io_uring_sqe* sqes_;
+  size_t sqes_size_;
+
+  uint32_t* sq_head_;
+  uint32_t* sq_tail_;
+  uint32_t sq_mask_;
+  uint32_t* sq_array_;
+  uint32_t* cq_head_;
+  uint32_t* cq_tail_;
+  uint32_t cq_mask_;
+  struct io_uring_cqe* cqes_;
+
+  uint32_t nentry_;
+  uint32_t ninflight_;
+  // Requests submitted from callbacks when the queue is full. They are pushed
+  // as earlier requests complete.
+  std::deque<AsyncIoRequest*> deferred_reqs_;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::thread completion_thread_;
+
+  IoUringAsyncIoQueue() :
+    fd_(-1),
+    sq_ring_(MAP_FAILED),
+    sq_ring_size_(0),
+    cq_ring_(MAP_FAILED),
+    cq_ring_size_(0),
+    sqes_((struct io_uring_sqe*)MAP_FAILED),
+    sqes_size_(0),
+    ninflight_(0) {}
+
+  static int io_uring_enter(
+    int fd,
+    uint32_t to_submit,
+    uint32_t min_complete,
+    uint32_t flags
+  ) {
+    return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete,
+      flags, nullptr, 0);
+  }
+
+  bool init(uint32_t queue_depth) {
+    struct io_uring_params params {};
+    fd_ = (int)syscall(__NR_io_uring_setup, queue_depth, &params);
+    if (fd_ < 0) { return false; }
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_ring_size_ = params.cq_off.cqes +
+      params.cq_entries * sizeof(struct io_uring_cqe);
+    bool is_single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (is_single_mmap) {
+      sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE,
+      MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) { return false; }
+    if (!is_single_mmap) {
+      cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE,
+        MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+      if (cq_ring_ == MAP_FAILED) { return false; }
+    }
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = (struct io_uring_sqe*)mmap(nullptr, sqes_size_,
+      PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_,
+      IORING_OFF_SQES);
+    if (sqes_ == MAP_FAILED) { return false; }
+
+    uint8_t* sq = (uint8_t*)sq_ring_;
+    uint8_t* cq = (uint8_t*)(is_single_mmap ? sq_ring_ : cq_ring_);
+    sq_head_ = (uint32_t*)(sq + params.sq_off.head);
+    sq_tail_ = (uint32_t*)(sq + params.sq_off.tail);
+    sq_mask_ = *(uint32_t*)(sq + params.sq_off.ring_mask);
+    sq_array_ = (uint32_t*)(sq + params.sq_off.array);
+    cq_head_ = (uint32_t*)(cq + params.cq_off.head);
+    cq_tail_ = (uint32_t*)(cq + params.cq_off.tail);
+    cq_mask_ = *(uint32_t*)(cq + params.cq_off.ring_mask);
+    cqes_ = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+    // The completion queue is at least as large as the submission queue so
+    // it never overflows as long as `ninflight_` is bounded by `nentry_`.
+    nentry_ = params.sq_entries;
+
+    completion_thread_ = std::thread([this]() { run_completion(); });
+    return true;
+  }
+
+  // Push a submission queue entry for the remaining part of `req`, or a no-op
+  // to stop the completion thread if `req` is null. `mutex_` must be held. Each
+  // of the at most `nentry_` requests in flight holds no more than one entry,
+  // so the slot is free.
+  void push_sqe(AsyncIoRequest* req) {
+    uint32_t tail = *sq_tail_;
+    uint32_t idx = tail & sq_mask_;
+    struct io_uring_sqe* sqe = &sqes_[idx];
+    std::memset(sqe, 0, sizeof(*sqe));
+    if (req == nullptr) {
+      sqe->opcode = IORING_OP_NOP;
+      sqe->user_data = 0;
+    } else {
+      req->iov.iov_base = req->data + req->ntransferred;
+      req->iov.iov_len = req->size - req->ntransferred;
+      sqe->opcode = req->is_write ? IORING_OP_WRITEV : IORING_OP_READV;
+      sqe->fd = req->fd;
+      sqe->addr = (uint64_t)(uintptr_t)&req->iov;
+      sqe->len = 1;
+      sqe->off = req->offset + req->ntransferred;
+      sqe->user_data = (uint64_t)(uintptr_t)req;
+    }
+    sq_array_[idx] = idx;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+  }
+  // Number of pushed entries not yet consumed by the kernel. `mutex_` must be
+  // held.
+  uint32_t count_unsubmitted_sqes() const {
+    return *sq_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+  }
+  // Submit the pushed entries to the kernel. The kernel refuses new entries
+  // when it's short of resources or completions are piling up, so the lock is
+  // released before retrying to let the completion thread reap. Not to be
+  // called on the completion thread, which submits in its own loop.
+  void submit_sqes(std::unique_lock<std::mutex>& lock) {
+    for (;;) {
+      uint32_t nsqe = count_unsubmitted_sqes();
+      if (nsqe == 0) { return; }
+      if (io_uring_enter(fd_, nsqe, 0, 0) >= 0 || errno == EINTR) { continue; }
+      if (errno != EAGAIN && errno != EBUSY) {
+        L_PANIC("failed to submit io_uring request: ", strerror(errno));
+      }
+      lock.unlock();
+      std::this_thread::yield();
+      lock.lock();
+    }
+  }
+
+  void complete(AsyncIoRequest* req, int64_t res) {
+    std::unique_ptr<AsyncIoRequest> req2(req);
+    close(req2->fd);
+    req2->callback(res);
+    std::lock_guard<std::mutex> lock(mutex_);
+    --ninflight_;
+    // Deferred requests take the slot before anyone waiting in `submit`.
+    if (!deferred_reqs_.empty()) {
+      ++ninflight_;
+      push_sqe(deferred_reqs_.front());
+      deferred_reqs_.pop_front();
+    }
+    cv_.notify_all();
+  }
+
+  void run_completion() {
+    for (;;) {
+      // Entries pushed on this thread are submitted along with the wait. If
+      // the kernel refuses them, they are retried after the completions are
+      // reaped.
+      uint32_t nsqe;
+      {
+        std::lock_guard<std::mutex> lock(mutex_);
+        nsqe = count_unsubmitted_sqes();
+      }
+      if (io_uring_enter(fd_, nsqe, 1, IORING_ENTER_GETEVENTS) < 0 &&
+        errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+        L_PANIC("failed to wait for io_uring completion: ", strerror(errno));
+      }
+      uint32_t head = *cq_head_;
+      uint32_t tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+      // Requests are filled in before their submission under `mutex_`, and
+      // the kernel orders the completion after that. Synchronize on the lock
+      // as well so the ordering is visible to race detectors.
+      { std::lock_guard<std::mutex> lock(mutex_); }
+      bool is_stopping = false;
+      for (; head != tail; ++head) {
+        const struct io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        AsyncIoRequest* req = (AsyncIoRequest*)(uintptr_t)cqe.user_data;
+        int32_t res = cqe.res;
+        // Release the slot before the callback so that requests submitted
+        // from callbacks don't stall.
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+
+        if (req == nullptr) {
+          is_stopping = true;
+        } else if (res == -EINTR || res == -EAGAIN) {
+          std::lock_guard<std::mutex> lock(mutex_);
+          push_sqe(req);
+        } else if (res < 0) {
+          complete(req, res);
+        } else {
+          req->ntransferred += res;
+          if (res == 0 || req->ntransferred >= req->size) {
+            complete(req, (int64_t)req->ntransferred);
+          } else {
+            std::lock_guard<std::mutex> lock(mutex_);
+            push_sqe(req);
+          }
+        }
+      }
+      if (is_stopping) { return; }
+    }
+  }
+
+public:
+  static std::unique_ptr<IoUringAsyncIoQueue> create(uint32_t queue_depth) {
+    std::unique_ptr<IoUringAsyncIoQueue> out(new IoUringAsyncIoQueue);
+    if (!out->init(std::max<uint32_t>(queue_depth, 1))) {
+      return nullptr;
+    }
+    return out;
+  }
+  virtual ~IoUringAsyncIoQueue() {
+    if (completion_thread_.joinable()) {
+      std::unique_lock<std::mutex> lock(mutex_);
+      cv_.wait(lock, [this]() { return ninflight_ == 0; });
+      push_sqe(nullptr);
+      submit_sqes(lock);
+      lock.unlock();
+      completion_thread_.join();
+    }
+    if (sqes_ != MAP_FAILED) { munmap(sqes_, sqes_size_); }
+    if (cq_ring_ != MAP_FAILED) { munmap(cq_ring_, cq_ring_size_); }
+    if (sq_ring_ != MAP_FAILED) { munmap(sq_ring_, sq_ring_size_); }
+    if (fd_ >= 0) { close(fd_); }
+  }
+
+  virtual void submit(std::unique_ptr<AsyncIoRequest>&& req) override {
+    int fd = open_async_io_file(*req);
+    if (fd < 0) {
+      req->callback(fd);
+      return;
+    }
+    req->fd = fd;
+    req->ntransferred = 0;
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    // A request submitted from a callback on the completion thread can't wait
+    // for completions, so it's deferred if the queue is full. Either way it's
+    // submitted by the completion thread once the callback returns.
+    if (std::this_thread::get_id() == completion_thread_.get_id()) {
+      if (ninflight_ < nentry_) {
+        ++ninflight_;
+        push_sqe(req.release());
+      } else {
+        deferred_reqs_.push_back(req.release());
+      }
+      return;
+    }
+    cv_.wait(lock, [this]() { return ninflight_ < nentry_; });
+    ++ninflight_;
+    push_sqe(req.release());
+    submit_sqes(lock);
+  }
+};
+#endif // L_HAS_IO_URING
+
+} // namespace
+
+AsyncIo::AsyncIo() : AsyncIo(AsyncIoConfig {}) {}
+AsyncIo::AsyncIo(const AsyncIoConfig& cfg) : is_io_uring_(false) {
+#if L_HAS_IO_URING
+  if (cfg.use_io_uring) {
+    queue_ = IoUringAsyncIoQueue::create(cfg.queue_depth);
+    is_io_uring_ = queue_ != nullptr;
+  }
+#endif // L_HAS_IO_URING
+  if (queue_ == nullptr) {
+    queue_ = std::make_unique<ThreadPoolAsyncIoQueue>(
+      std::max<uint32_t>(cfg.nthread, 1));
+  }
+}
+AsyncIo::~AsyncIo() {}
+
+void AsyncIo::read(
+  const char* path,
+  void* out,
+  size_t size,
+  uint64_t offset,
+  AsyncIoCallback&& callback
+) {
+  std::unique_ptr<AsyncIoRequest> req = std::make_unique<AsyncIoRequest>();
+  req->path = path;
+  req->is_write = false;
+  req->truncate = false;
+  req->data = (uint8_t*)out;
+  req->size = size;
+  req->offset = offset;
+  req->callback = std::move(callback);
+  queue_->submit(std::move(req));
+}
+std::future<int64_t> AsyncIo::read(
+  const char* path,
+  void* out,
+  size_t size,
+  uint64_t offset
+) {
+  std::shared_ptr<std::promise<int64_t>> promise =
+    std::make_shared<std::promise<int64_t>>();
+  std::future<int64_t> out_future = promise->get_future();
+  read(path, out, size, offset, [promise](int64_t res) {
+    promise->set_value(res);
+  });
+  return out_future;
+}
+void AsyncIo::write(
+  const char* path,
+  const void* data,
+  size_t size,
+  uint64_t offset,
+  AsyncIoCallback&& callback
+) {
+  std::unique_ptr<AsyncIoRequest> req = std::make_unique<AsyncIoRequest>();
+  req->path = path;
+  req->is_write = true;
+  req->truncate = false;
+  req->data = (uint8_t*)data;
+  req->size = size;
+  req->offset = offset;
+  req->callback = std::move(callback);
+  queue_->submit(std::move(req));
+}
+std::future<int64_t> AsyncIo::write(
+  const char* path,
+  const void* data,
+  size_t size,
+  uint64_t offset
+) {
+  std::shared_ptr<std::promise<int64_t>> promise =
+    std::make_shared<std::promise<int64_t>>();
+  std::future<int64_t> out_future = promise->get_future();
+  write(path, data, size, offset, [promise](int64_t res) {
+    promise->set_value(res);
+  });
+  return out_future;
+}
+
+std::future<std::vector<uint8_t>> AsyncIo::load_file(const char* path) {
+  std::shared_ptr<std::promise<std::vector<uint8_t>>> promise =
+    std::make_shared<std::promise<std::vector<uint8_t>>>();
+  std::future<std::vector<uint8_t>> out_future = promise->get_future();
+  std::shared_ptr<std::vector<uint8_t>> buf;
+  try {
+    buf = std::make_shared<std::vector<uint8_t>>(get_file_size(path));
+  } catch (...) {
+    promise->set_exception(std::current_exception());
+    return out_future;
+  }
+  std::string path2 = path;
+  read(path, buf->data(), buf->size(), 0, [promise, buf, path2](int64_t res) {
+    if (res != (int64_t)buf->size()) {
+      promise->set_exception(std::make_exception_ptr(AssertionFailedException(
+        __FILE__, __LINE__, format("failed to read file: ", path2))));
+      return;
+    }
+    promise->set_value(std::move(*buf));
+  });
+  return out_future;
+}
+std::future<void> AsyncIo::save_file(
+  const char* path,
+  const void* data,
+  size_t size
+) {
+  std::shared_ptr<std::promise<void>> promise =
+    std::make_shared<std::promise<void>>();
+  std::future<void> out_future = promise->get_future();
+  std::unique_ptr<AsyncIoRequest> req = std::make_unique<AsyncIoRequest>();
+  req->path = path;
+  req->is_write = true;
+  req->truncate = true;
+  req->data = (uint8_t*)data;
+  req->size = size;
+  req->offset = 0;
+  std::string path2 = path;
+  req->callback = [promise, size, path2](int64_t res) {
+    if (res != (int64_t)size) {
+      promise->set_exception(std::make_exception_ptr(AssertionFailedException(
+        __FILE__, __LINE__, format("failed to write file: ", path2))));
+      return;
+    }
+    promise->set_value();
+  };
+  queue_->submit(std::move(req));
+  return out_future;
+}
+
+AsyncBmpWriter::AsyncBmpWriter() : AsyncBmpWriter(AsyncBmpWriterConfig {}) {}
+AsyncBmpWriter::AsyncBmpWriter(const AsyncBmpWriterConfig& cfg) :
+  aio_(cfg.io_cfg),
+  max_nframe_in_flight_(std::max<uint32_t>(cfg.max_nframe_in_flight, 1)) {}
+AsyncBmpWriter::~AsyncBmpWriter() {
+  for (Frame& frame : frames_) {
+    frame.future.wait();
+  }
+}
+std::vector<uint8_t> AsyncBmpWriter::acquire_frame_data() {
+  // Release the frames already written, and wait for the earliest one if
+  // there are too many in flight. Their storage is reused for the next frame
+  // to save the page faults of fresh allocations.
+  std::vector<uint8_t> out;
+  while (!frames_.empty()) {
+    std::future<void>& future = frames_.front().future;
+    if (frames_.size() < max_nframe_in_flight_ &&
+      future.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+      break;
+    }
+    Frame frame = std::move(frames_.front());
+    frames_.pop_front();
+    frame.future.get();
+    out = std::move(frame.data);
+  }
+  return out;
+}
+void AsyncBmpWriter::push_frame(std::vector<uint8_t>&& data, const char* path) {
+  frames_.emplace_back();
+  Frame& frame = frames_.back();
+  frame.data = std::move(data);
+  frame.future = aio_.save_file(path, frame.data.data(), frame.data.size());
+}
+void AsyncBmpWriter::save_bmp(
+  const uint32_t* pxs,
+  uint32_t w,
+  uint32_t h,
+  const char* path
+) {
+  std::vector<uint8_t> data = acquire_frame_data();
+  encode_bmp(pxs, w, h, data);
+  push_frame(std::move(data), path);
+}
+void AsyncBmpWriter::save_bmp(
+  const float* pxs,
+  uint32_t w,
+  uint32_t h,
+  const char* path
+) {
+  std::vector<uint8_t> data = acquire_frame_data();
+  encode_bmp(pxs, w, h, data);
+  push_frame(std::move(data), path);
+}
+void AsyncBmpWriter::wait() {
+  while (!frames_.empty()) {
+    Frame frame = std::move(frames_.front());
+    frames_.pop_front();
+    frame.future.get();
+  }
+}
+
 bool starts_with(const std::string& start, const std::string& str) {
   if (str.size() < start.size()) { return false; }
   for (size_t i = 0; i < start.size(); ++i) {
@@ -165,82 +1179,258 @@ std::string trim(const std::string& str) {
   return std::string(beg, end);
 }
 
-/*
-** The crc32 is licensed under the Apache License, Version 2.0, and a copy of the license is included in this file.
-**
-** Author:Wang Yaofu voipman@qq.com
-** Description: The source file of class crc32.
-**  CRC32 implementation according to IEEE standards.
-**  Polynomials are represented in LSB-first form
-**  following parameters:
-**    Width                      : 32 bit
-**    Poly                       : 0xedb88320
-**    Output for "123456789"     : 0xCBF43926
-*/
+// CRC32 according to IEEE 802.3, with the polynomial 0xEDB88320 represented
+// in LSB-first form. The crc32 of "123456789" is 0xCBF43926.
+//
+// Data is processed 8 bytes at a time with slice-by-8 tables, or 64 bytes at
+// a time by folding with carry-less multiplication (PCLMULQDQ) on x86-64 when
+// the processor supports it.
+struct Crc32Tables {
+  uint32_t lut[8][256];
+};
+constexpr Crc32Tables make_crc32_tables() {
+  Crc32Tables out {};
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t x = i;
+    for (uint32_t j = 0; j < 8; ++j) {
+      x = (x >> 1) ^ ((x & 1) != 0 ? 0xEDB88320 : 0);
+    }
+    out.lut[0][i] = x;
+  }
+  for (uint32_t i = 0; i < 256; ++i) {
+    for (uint32_t k = 1; k < 8; ++k) {
+      uint32_t x = out.lut[k - 1][i];
+      out.lut[k][i] = (x >> 8) ^ out.lut[0][x & 0xFF];
+    }
+  }
+  return out;
+}
+constexpr Crc32Tables CRC32_TABLES = make_crc32_tables();
+
+// `crc` is the inverted crc32 state in the following kernels.
+uint32_t crc32_update_slice8(uint32_t crc, const uint8_t* data, size_t size) {
+  const auto& lut = CRC32_TABLES.lut;
+  while (size >= 8) {
+    uint32_t lo;
+    uint32_t hi;
+    std::memcpy(&lo, data, sizeof(uint32_t));
+    std::memcpy(&hi, data + 4, sizeof(uint32_t));
+    lo ^= crc;
+    crc = lut[7][lo & 0xFF] ^ lut[6][(lo >> 8) & 0xFF] ^
+      lut[5][(lo >> 16) & 0xFF] ^ lut[4][lo >> 24] ^
+      lut[3][hi & 0xFF] ^ lut[2][(hi >> 8) & 0xFF] ^
+      lut[1][(hi >> 16) & 0xFF] ^ lut[0][hi >> 24];
+    data += 8;
+    size -= 8;
+  }
+  for (size_t i = 0; i < size; ++i) {
+    crc = lut[0][(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#if L_HAS_CRC32_PCLMUL
+// Fold 128-bit lanes with carry-less multiplication as described in Intel's
+// "Fast CRC Computation for Generic Polynomials Using PCLMULQDQ Instruction".
+// `size` must be a multiple of 16 and at least 64.
+L_CRC32_PCLMUL_TARGET
+uint32_t crc32_update_pclmul(uint32_t crc, const uint8_t* data, size_t size) {
+  // Bit-reflected folding constants x^(4*128+32) mod P, x^(4*128-32) mod P,
+  // x^(128+32) mod P, x^(128-32) mod P, x^64 mod P, and the Barrett reduction
+  // constants P and floor(x^64 / P).
+  alignas(16) static const uint64_t K1K2[] = { 0x0154442bd4, 0x01c6e41596 };
+  alignas(16) static const uint64_t K3K4[] = { 0x01751997d0, 0x00ccaa009e };
+  alignas(16) static const uint64_t K5K0[] = { 0x0163cd6124, 0x0000000000 };
+  alignas(16) static const uint64_t POLY[] = { 0x01db710641, 0x01f7011641 };
+
+  __m128i x0, x1, x2, x3, x4, x5, x6, x7, x8;
+
+  x1 = _mm_loadu_si128((const __m128i*)(data + 0x00));
+  x2 = _mm_loadu_si128((const __m128i*)(data + 0x10));
+  x3 = _mm_loadu_si128((const __m128i*)(data + 0x20));
+  x4 = _mm_loadu_si128((const __m128i*)(data + 0x30));
+  x1 = _mm_xor_si128(x1, _mm_cvtsi32_si128((int)crc));
+  data += 64;
+  size -= 64;
+
+  // Fold 4 lanes in parallel.
+  x0 = _mm_load_si128((const __m128i*)K1K2);
+  while (size >= 64) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x6 = _mm_clmulepi64_si128(x2, x0, 0x00);
+    x7 = _mm_clmulepi64_si128(x3, x0, 0x00);
+    x8 = _mm_clmulepi64_si128(x4, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x2 = _mm_clmulepi64_si128(x2, x0, 0x11);
+    x3 = _mm_clmulepi64_si128(x3, x0, 0x11);
+    x4 = _mm_clmulepi64_si128(x4, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x5),
+      _mm_loadu_si128((const __m128i*)(data + 0x00)));
+    x2 = _mm_xor_si128(_mm_xor_si128(x2, x6),
+      _mm_loadu_si128((const __m128i*)(data + 0x10)));
+    x3 = _mm_xor_si128(_mm_xor_si128(x3, x7),
+      _mm_loadu_si128((const __m128i*)(data + 0x20)));
+    x4 = _mm_xor_si128(_mm_xor_si128(x4, x8),
+      _mm_loadu_si128((const __m128i*)(data + 0x30)));
+    data += 64;
+    size -= 64;
+  }
+
+  // Fold the 4 lanes into one.
+  x0 = _mm_load_si128((const __m128i*)K3K4);
+  for (__m128i x : { x2, x3, x4 }) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1, x), x5);
+  }
+  while (size >= 16) {
+    x5 = _mm_clmulepi64_si128(x1, x0, 0x00);
+    x1 = _mm_clmulepi64_si128(x1, x0, 0x11);
+    x1 = _mm_xor_si128(_mm_xor_si128(x1,
+      _mm_loadu_si128((const __m128i*)data)), x5);
+    data += 16;
+    size -= 16;
+  }
+
+  // Fold 128 bits to 64 bits.
+  x2 = _mm_clmulepi64_si128(x1, x0, 0x10);
+  x3 = _mm_setr_epi32(~0, 0, ~0, 0);
+  x1 = _mm_srli_si128(x1, 8);
+  x1 = _mm_xor_si128(x1, x2);
+
+  x0 = _mm_loadl_epi64((const __m128i*)K5K0);
+  x2 = _mm_srli_si128(x1, 4);
+  x1 = _mm_and_si128(x1, x3);
+  x1 = _mm_clmulepi64_si128(x1, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+
+  // Barrett reduction to 32 bits.
+  x0 = _mm_load_si128((const __m128i*)POLY);
+  x2 = _mm_and_si128(x1, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x10);
+  x2 = _mm_and_si128(x2, x3);
+  x2 = _mm_clmulepi64_si128(x2, x0, 0x00);
+  x1 = _mm_xor_si128(x1, x2);
+  return (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(x1, 4));
+}
+
+bool is_pclmul_supported() {
+#if defined(_MSC_VER)
+  int info[4];
+  __cpuid(info, 1);
+  return (info[2] & (1 << 1)) != 0;
+#else
+  return __builtin_cpu_supports("pclmul");
+#endif // defined(_MSC_VER)
+}
+#endif // L_HAS_CRC32_PCLMUL
+
+uint32_t crc32_update(uint32_t crc, const void* data, size_t size) {
+  const uint8_t* cur = (const uint8_t*)data;
+  crc = ~crc;
+#if L_HAS_CRC32_PCLMUL
+  static const bool IS_PCLMUL_SUPPORTED = is_pclmul_supported();
+  if (IS_PCLMUL_SUPPORTED && size >= 64) {
+    size_t folded_size = size & ~(size_t)15;
+    crc = crc32_update_pclmul(crc, cur, folded_size);
+    cur += folded_size;
+    size -= folded_size;
+  }
+#endif // L_HAS_CRC32_PCLMUL
+  crc = crc32_update_slice8(crc, cur, size);
+  return ~crc;
+}
 uint32_t crc32(const void* data, size_t size) {
-  static uint32_t LUT[] = {
-    0x00000000L, 0x77073096L, 0xee0e612cL, 0x990951baL, 0x076dc419L,
-    0x706af48fL, 0xe963a535L, 0x9e6495a3L, 0x0edb8832L, 0x79dcb8a4L,
-    0xe0d5e91eL, 0x97d2d988L, 0x09b64c2bL, 0x7eb17cbdL, 0xe7b82d07L,
-    0x90bf1d91L, 0x1db71064L, 0x6ab020f2L, 0xf3b97148L, 0x84be41deL,
-    0x1adad47dL, 0x6ddde4ebL, 0xf4d4b551L, 0x83d385c7L, 0x136c9856L,
-    0x646ba8c0L, 0xfd62f97aL, 0x8a65c9ecL, 0x14015c4fL, 0x63066cd9L,
-    0xfa0f3d63L, 0x8d080df5L, 0x3b6e20c8L, 0x4c69105eL, 0xd56041e4L,
-    0xa2677172L, 0x3c03e4d1L, 0x4b04d447L, 0xd20d85fdL, 0xa50ab56bL,
-    0x35b5a8faL, 0x42b2986cL, 0xdbbbc9d6L, 0xacbcf940L, 0x32d86ce3L,
-    0x45df5c75L, 0xdcd60dcfL, 0xabd13d59L, 0x26d930acL, 0x51de003aL,
-    0xc8d75180L, 0xbfd06116L, 0x21b4f4b5L, 0x56b3c423L, 0xcfba9599L,
-    0xb8bda50fL, 0x2802b89eL, 0x5f058808L, 0xc60cd9b2L, 0xb10be924L,
-    0x2f6f7c87L, 0x58684c11L, 0xc1611dabL, 0xb6662d3dL, 0x76dc4190L,
-    0x01db7106L, 0x98d220bcL, 0xefd5102aL, 0x71b18589L, 0x06b6b51fL,
-    0x9fbfe4a5L, 0xe8b8d433L, 0x7807c9a2L, 0x0f00f934L, 0x9609a88eL,
-    0xe10e9818L, 0x7f6a0dbbL, 0x086d3d2dL, 0x91646c97L, 0xe6635c01L,
-    0x6b6b51f4L, 0x1c6c6162L, 0x856530d8L, 0xf262004eL, 0x6c0695edL,
-    0x1b01a57bL, 0x8208f4c1L, 0xf50fc457L, 0x65b0d9c6L, 0x12b7e950L,
-    0x8bbeb8eaL, 0xfcb9887cL, 0x62dd1ddfL, 0x15da2d49L, 0x8cd37cf3L,
-    0xfbd44c65L, 0x4db26158L, 0x3ab551ceL, 0xa3bc0074L, 0xd4bb30e2L,
-    0x4adfa541L, 0x3dd895d7L, 0xa4d1c46dL, 0xd3d6f4fbL, 0x4369e96aL,
-    0x346ed9fcL, 0xad678846L, 0xda60b8d0L, 0x44042d73L, 0x33031de5L,
-    0xaa0a4c5fL, 0xdd0d7cc9L, 0x5005713cL, 0x270241aaL, 0xbe0b1010L,
-    0xc90c2086L, 0x5768b525L, 0x206f85b3L, 0xb966d409L, 0xce61e49fL,
-    0x5edef90eL, 0x29d9c998L, 0xb0d09822L, 0xc7d7a8b4L, 0x59b33d17L,
-    0x2eb40d81L, 0xb7bd5c3bL, 0xc0ba6cadL, 0xedb88320L, 0x9abfb3b6L,
-    0x03b6e20cL, 0x74b1d29aL, 0xead54739L, 0x9dd277afL, 0x04db2615L,
-    0x73dc1683L, 0xe3630b12L, 0x94643b84L, 0x0d6d6a3eL, 0x7a6a5aa8L,
-    0xe40ecf0bL, 0x9309ff9dL, 0x0a00ae27L, 0x7d079eb1L, 0xf00f9344L,
-    0x8708a3d2L, 0x1e01f268L, 0x6906c2feL, 0xf762575dL, 0x806567cbL,
-    0x196c3671L, 0x6e6b06e7L, 0xfed41b76L, 0x89d32be0L, 0x10da7a5aL,
-    0x67dd4accL, 0xf9b9df6fL, 0x8ebeeff9L, 0x17b7be43L, 0x60b08ed5L,
-    0xd6d6a3e8L, 0xa1d1937eL, 0x38d8c2c4L, 0x4fdff252L, 0xd1bb67f1L,
-    0xa6bc5767L, 0x3fb506ddL, 0x48b2364bL, 0xd80d2bdaL, 0xaf0a1b4cL,
-    0x36034af6L, 0x41047a60L, 0xdf60efc3L, 0xa867df55L, 0x316e8eefL,
-    0x4669be79L, 0xcb61b38cL, 0xbc66831aL, 0x256fd2a0L, 0x5268e236L,
-    0xcc0c7795L, 0xbb0b4703L, 0x220216b9L, 0x5505262fL, 0xc5ba3bbeL,
-    0xb2bd0b28L, 0x2bb45a92L, 0x5cb36a04L, 0xc2d7ffa7L, 0xb5d0cf31L,
-    0x2cd99e8bL, 0x5bdeae1dL, 0x9b64c2b0L, 0xec63f226L, 0x756aa39cL,
-    0x026d930aL, 0x9c0906a9L, 0xeb0e363fL, 0x72076785L, 0x05005713L,
-    0x95bf4a82L, 0xe2b87a14L, 0x7bb12baeL, 0x0cb61b38L, 0x92d28e9bL,
-    0xe5d5be0dL, 0x7cdcefb7L, 0x0bdbdf21L, 0x86d3d2d4L, 0xf1d4e242L,
-    0x68ddb3f8L, 0x1fda836eL, 0x81be16cdL, 0xf6b9265bL, 0x6fb077e1L,
-    0x18b74777L, 0x88085ae6L, 0xff0f6a70L, 0x66063bcaL, 0x11010b5cL,
-    0x8f659effL, 0xf862ae69L, 0x616bffd3L, 0x166ccf45L, 0xa00ae278L,
-    0xd70dd2eeL, 0x4e048354L, 0x3903b3c2L, 0xa7672661L, 0xd06016f7L,
-    0x4969474dL, 0x3e6e77dbL, 0xaed16a4aL, 0xd9d65adcL, 0x40df0b66L,
-    0x37d83bf0L, 0xa9bcae53L, 0xdebb9ec5L, 0x47b2cf7fL, 0x30b5ffe9L,
-    0xbdbdf21cL, 0xcabac28aL, 0x53b39330L, 0x24b4a3a6L, 0xbad03605L,
-    0xcdd70693L, 0x54de5729L, 0x23d967bfL, 0xb3667a2eL, 0xc4614ab8L,
-    0x5d681b02L, 0x2a6f2b94L, 0xb40bbe37L, 0xc30c8ea1L, 0x5a05df1bL,
-    0x2d02ef8dL
-  };
-  uint32_t crc32val = 0;
-  crc32val ^= 0xFFFFFFFF;
+  return crc32_update(0, data, size);
+}
+
+// Polynomials modulo P in the same bit-reflected representation as crc32s,
+// where the MSB is the coefficient of x^0. The crc32 of data followed by `n`
+// zero bytes is the crc32 of the data multiplied by x^(8n) modulo P, so crc32s
+// of consecutive data can be combined without touching the data again.
+constexpr uint32_t crc32_multmodp(uint32_t a, uint32_t b) {
+  uint32_t m = (uint32_t)1 << 31;
+  uint32_t p = 0;
+  for (;;) {
+    if ((a & m) != 0) {
+      p ^= b;
+      if ((a & (m - 1)) == 0) { break; }
+    }
+    m >>= 1;
+    b = (b & 1) != 0 ? (b >> 1) ^ 0xEDB88320 : b >> 1;
+  }
+  return p;
+}
+struct Crc32X2nTable {
+  // x^(2^k) modulo P.
+  uint32_t x2n[32];
+};
+constexpr Crc32X2nTable make_crc32_x2n_table() {
+  Crc32X2nTable out {};
+  uint32_t p = (uint32_t)1 << 30; // x^1
+  out.x2n[0] = p;
+  for (uint32_t k = 1; k < 32; ++k) {
+    p = crc32_multmodp(p, p);
+    out.x2n[k] = p;
+  }
+  return out;
+}
+constexpr Crc32X2nTable CRC32_X2N_TABLE = make_crc32_x2n_table();
+// x^(n * 2^k) modulo P.
+uint32_t crc32_x2nmodp(uint64_t n, uint32_t k) {
+  uint32_t p = (uint32_t)1 << 31; // x^0
+  while (n != 0) {
+    if ((n & 1) != 0) {
+      p = crc32_multmodp(CRC32_X2N_TABLE.x2n[k & 31], p);
+    }
+    n >>= 1;
+    ++k;
+  }
+  return p;
+}
 
-  for (size_t i = 0;  i < size;  i++) {
-    uint32_t x = ((const uint8_t*)data)[i];
-    crc32val = LUT[(crc32val ^ x) & 0xFF] ^ ((crc32val >> 8) & 0x00FFFFFF);
+uint32_t crc32_combine(uint32_t crc1, uint32_t crc2, uint64_t size2) {
+  return crc32_multmodp(crc32_x2nmodp(size2, 3), crc1) ^ crc2;
+}
+
+// Chunks of `crc32_parallel` are large enough to amortize the scheduling and
+// the combination.
+constexpr size_t CRC32_PARALLEL_MIN_CHUNK_SIZE = 1024 * 1024;
+
+uint32_t crc32_parallel(const void* data, size_t size) {
+  // Small buffers don't spin up the global pool.
+  if (size <= CRC32_PARALLEL_MIN_CHUNK_SIZE) {
+    return crc32(data, size);
+  }
+  return crc32_parallel(data, size, ThreadPool::global());
+}
+uint32_t crc32_parallel(
+  const void* data,
+  size_t size,
+  ThreadPool& thread_pool
+) {
+  // There is one chunk per participating thread including the calling one.
+  size_t nchunk = std::min(thread_pool.nthread() + 1,
+    div_up(size, CRC32_PARALLEL_MIN_CHUNK_SIZE));
+  if (nchunk <= 1) {
+    return crc32(data, size);
   }
+  size_t chunk_size = align_up(div_up(size, nchunk), 64);
+  nchunk = div_up(size, chunk_size);
 
-  return crc32val ^ 0xFFFFFFFF;
+  std::vector<uint32_t> crcs(nchunk);
+  thread_pool.parallel_for(nchunk, [&](size_t i) {
+    size_t offset = i * chunk_size;
+    crcs[i] = crc32((const uint8_t*)data + offset,
+      std::min(chunk_size, size - offset));
+  });
+
+  uint32_t crc = crcs[0];
+  for (size_t i = 1; i < nchunk; ++i) {
+    size_t offset = i * chunk_size;
+    crc = crc32_combine(crc, crcs[i], std::min(chunk_size, size - offset));
+  }
+  return crc;
 }
 
 } // namespace util
@@ -221,6 +221,11 @@ TextureGpu::TextureGpu(
 ) : TextureGpu(ctxt, width, height, gc) {
   write(pxs);
 }
+TextureGpu::TextureGpu(
+  const scoped::Context& ctxt,
+  const util::Rgba8Image& img,
+  bool gc
+) : TextureGpu(ctxt, img.width, img.height, img.pxs, gc) {}
 void TextureGpu::write(const std::vector<uint32_t>& pxs) {
   const auto& tex_cfg = tex.cfg();
   L_ASSERT(pxs.size() == tex_cfg.width * tex_cfg.height);
@@ -1,8 +1,11 @@
+#include <cstring>
+#include <string_view>
 #include "gft/assert.hpp"
 #include "gft/log.hpp"
 #include "gft/zip.hpp"
 #include "gft/util.hpp"
 #include "gft/stream.hpp"
+#include "gft/deflate.hpp"
 
 namespace liong {
 namespace zip {
@@ -12,19 +15,96 @@ enum ZipSignature {
   L_ZIP_SIGNATURE_DATA_DESCRIPTOR = 0x08074b50,
   L_ZIP_SIGNATURE_CENTRAL_DIRECTORY_FILE_HEADER = 0x02014b50,
   L_ZIP_SIGNATURE_END_OF_CENTRAL_DIRECTORY_RECORD = 0x06054b50,
+  L_ZIP_SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY_RECORD = 0x06064b50,
+  L_ZIP_SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR = 0x07064b50,
 };
 
+enum ZipExtraFieldId {
+  L_ZIP_EXTRA_FIELD_ID_ZIP64 = 0x0001,
+};
+
+// 32-bit fields saturated to this value are stored in the Zip64 extended
+// information extra field, so are 16-bit counts saturated to `0xFFFF`.
+constexpr uint64_t ZIP64_SATURATED = 0xFFFFFFFF;
+
+// Replace the saturated fields with 64-bit values in the Zip64 extended
+// information extra field. Only the saturated fields are present in the extra
+// field, in the order of the parameters. `rel_offset` is null for local file
+// headers. Returns false if the extra field is malformed.
+bool apply_zip64_extra_field(
+  const uint8_t* extra_field,
+  size_t extra_field_size,
+  uint64_t& uncompressed_size,
+  uint64_t& compressed_size,
+  uint64_t* rel_offset
+) {
+  bool is_saturated = uncompressed_size == ZIP64_SATURATED ||
+    compressed_size == ZIP64_SATURATED ||
+    (rel_offset != nullptr && *rel_offset == ZIP64_SATURATED);
+  if (!is_saturated) { return true; }
+
+  stream::ReadStream stream(extra_field, extra_field_size);
+  while (stream.size_remain() >= 4) {
+    uint16_t id = stream.extract<uint16_t>();
+    uint16_t size = stream.extract<uint16_t>();
+    if (stream.size_remain() < size) { break; }
+    if (id != L_ZIP_EXTRA_FIELD_ID_ZIP64) {
+      stream.skip(size);
+      continue;
+    }
+
+    stream::ReadStream zip64_stream(stream.pos(), size);
+    for (uint64_t* field : { &uncompressed_size, &compressed_size, rel_offset }) {
+      if (field == nullptr || *field != ZIP64_SATURATED) { continue; }
+      if (zip64_stream.size_remain() < sizeof(uint64_t)) {
+        L_ERROR("corrupted zip64 extra field");
+        return false;
+      }
+      *field = zip64_stream.extract<uint64_t>();
+    }
+    return true;
+  }
+  L_ERROR("missing zip64 extra field");
+  return false;
+}
+
 struct ZipParser {
   stream::ReadStream stream;
   std::vector<ZipFileRecord> records;
-  std::map<uint32_t, size_t> rel_offset2irecord;
+  std::map<uint64_t, size_t> rel_offset2irecord;
   std::map<std::string, size_t> file_name2irecord;
-  uint32_t cdr_offset;
+  uint64_t cdr_offset;
+  // Sizes in the data descriptor are 64-bit if the local file header has a
+  // Zip64 extra field.
+  bool is_last_record_zip64;
 
-  ZipParser(const void* data, size_t size) : stream(data, size), cdr_offset() {}
+  ZipParser(const void* data, size_t size) :
+    stream(data, size), cdr_offset(), is_last_record_zip64() {}
+
+  static bool check_compression(
+    uint16_t compression_method,
+    uint64_t compressed_size,
+    uint64_t uncompressed_size,
+    uint16_t flags
+  ) {
+    switch (compression_method) {
+    case L_ZIP_COMPRESSION_METHOD_STORE:
+      // Sizes are zeros if deferred to the data descriptor.
+      if (compressed_size != uncompressed_size && (flags & 0x8) == 0) {
+        L_ERROR("stored zip file entry has mismatched sizes");
+        return false;
+      }
+      return true;
+    case L_ZIP_COMPRESSION_METHOD_DEFLATE:
+      return true;
+    default:
+      L_ERROR("unsupported zip compression method: ", compression_method);
+      return false;
+    }
+  }
 
   bool extract_local_file_header() {
-    uint32_t rel_offset = stream.offset() - sizeof(uint32_t);
+    uint64_t rel_offset = stream.offset() - sizeof(uint32_t);
 
     if (stream.size_remain() < 30) {
       L_ERROR("corrupted local file header");
@@ -36,15 +116,8 @@ struct ZipParser {
     uint16_t last_modify_time = stream.extract<uint16_t>();
     uint16_t last_modify_date = stream.extract<uint16_t>();
     uint32_t crc32 = stream.extract<uint32_t>();
-    uint32_t compressed_size = stream.extract<uint32_t>();
-    uint32_t uncompressed_size = stream.extract<uint32_t>();
-    if (compression_method != 0 || compressed_size != uncompressed_size) {
-      L_ERROR("compressed zip is not supported");
-      return false;
-    }
-    if (compressed_size == 0xFFFFFFFF || uncompressed_size == 0xFFFFFFFF) {
-      L_ERROR("zip64 is not supported");
-    }
+    uint64_t compressed_size = stream.extract<uint32_t>();
+    uint64_t uncompressed_size = stream.extract<uint32_t>();
     std::string file_name(stream.extract<uint16_t>(), '\0');
     std::vector<uint8_t> extra_field(stream.extract<uint16_t>());
     if (stream.size_remain() < file_name.size() + extra_field.size()) {
@@ -54,15 +127,52 @@ struct ZipParser {
     stream.extract_data(file_name.data(), file_name.size());
     stream.extract_data(extra_field.data(), extra_field.size());
 
+    is_last_record_zip64 = compressed_size == ZIP64_SATURATED ||
+      uncompressed_size == ZIP64_SATURATED;
+    if (!apply_zip64_extra_field(extra_field.data(), extra_field.size(),
+      uncompressed_size, compressed_size, nullptr))
+    {
+      return false;
+    }
+    if (!check_compression(compression_method, compressed_size,
+      uncompressed_size, flags))
+    {
+      return false;
+    }
+    if (compression_method != L_ZIP_COMPRESSION_METHOD_STORE &&
+      (flags & 0x8) != 0)
+    {
+      // The end of compressed data is unknown until it's decompressed.
+      L_ERROR("compressed zip file entry with data descriptor can only be "
+        "parsed with `ZipParseConfig::central_directory_only`");
+      return false;
+    }
+    if ((flags & 0x8) != 0 && compressed_size == 0 &&
+      !find_stored_data_descriptor(compressed_size))
+    {
+      L_ERROR("cannot find the data descriptor of a stored zip file entry");
+      return false;
+    }
+    if (stream.size_remain() < compressed_size) {
+      L_ERROR("corrupted local file header");
+      return false;
+    }
+
     size_t irecord = records.size();
 
     rel_offset2irecord[rel_offset] = irecord;
 
     ZipFileRecord& record = records.emplace_back();
     record.file_name = file_name;
-    record.data = stream.pos();
+    record.data = compression_method == L_ZIP_COMPRESSION_METHOD_STORE ?
+      stream.pos() : nullptr;
     record.size = uncompressed_size;
     record.crc32 = crc32;
+    record.compression_method = (ZipCompressionMethod)compression_method;
+    record.compressed_data = stream.pos();
+    record.compressed_size = compressed_size;
+    record.local_header_offset = rel_offset;
+    record.is_validated = true;
 
     file_name2irecord[file_name] = irecord;
 
@@ -81,6 +191,40 @@ struct ZipParser {
     return true;
   }
 
+  // Sizes of stored data streamed ahead of its data descriptor are unknown in
+  // the local file header. The data ends at the first data descriptor
+  // signature followed by a compressed size matching the distance travelled.
+  bool find_stored_data_descriptor(uint64_t& compressed_size) const {
+    const uint8_t* beg = (const uint8_t*)stream.pos();
+    const uint8_t* end = beg + stream.size_remain();
+    size_t data_descriptor_size = is_last_record_zip64 ? 24 : 16;
+    const uint8_t* cur = beg;
+    while ((size_t)(end - cur) >= data_descriptor_size) {
+      cur = (const uint8_t*)std::memchr(cur, 0x50,
+        (end - cur) - data_descriptor_size + 1);
+      if (cur == nullptr) { break; }
+
+      uint32_t sig;
+      std::memcpy(&sig, cur, sizeof(sig));
+      if (sig == L_ZIP_SIGNATURE_DATA_DESCRIPTOR) {
+        uint64_t size = 0;
+        if (is_last_record_zip64) {
+          std::memcpy(&size, cur + 8, sizeof(uint64_t));
+        } else {
+          uint32_t size32;
+          std::memcpy(&size32, cur + 8, sizeof(uint32_t));
+          size = size32;
+        }
+        if (size == (uint64_t)(cur - beg)) {
+          compressed_size = size;
+          return true;
+        }
+      }
+      ++cur;
+    }
+    return false;
+  }
+
   bool extract_data_descriptor() {
     if (records.empty()) {
       L_ERROR("cannot apply data descriptor before file entries");
@@ -88,12 +232,20 @@ struct ZipParser {
     }
 
     uint32_t crc32 = stream.extract<uint32_t>();
-    uint32_t compressed_size = stream.extract<uint32_t>();
-    uint32_t uncompressed_size = stream.extract<uint32_t>();
+    uint64_t compressed_size;
+    uint64_t uncompressed_size;
+    if (is_last_record_zip64) {
+      compressed_size = stream.extract<uint64_t>();
+      uncompressed_size = stream.extract<uint64_t>();
+    } else {
+      compressed_size = stream.extract<uint32_t>();
+      uncompressed_size = stream.extract<uint32_t>();
+    }
 
     ZipFileRecord& record = records.back();
     record.crc32 = crc32;
     record.size = uncompressed_size;
+    record.compressed_size = compressed_size;
     return true;
   }
 
@@ -102,29 +254,30 @@ struct ZipParser {
     uint16_t min_version = stream.extract<uint16_t>();
     uint16_t flags = stream.extract<uint16_t>();
     uint16_t compression_method = stream.extract<uint16_t>();
-    if (compression_method != 0) {
-      L_ERROR("compressed zip is not supported");
-      return false;
-    }
     uint16_t last_modify_time = stream.extract<uint16_t>();
     uint16_t last_modify_date = stream.extract<uint16_t>();
     uint32_t crc32 = stream.extract<uint32_t>();
-    uint32_t compressed_size = stream.extract<uint32_t>();
-    uint32_t uncompressed_size = stream.extract<uint32_t>();
+    uint64_t compressed_size = stream.extract<uint32_t>();
+    uint64_t uncompressed_size = stream.extract<uint32_t>();
     std::string file_name(stream.extract<uint16_t>(), '\0');
     std::vector<uint8_t> extra_field(stream.extract<uint16_t>());
     std::string comment(stream.extract<uint16_t>(), '\0');
     uint16_t disk_number = stream.extract<uint16_t>();
-    if (disk_number != 0) {
+    if (disk_number != 0 && disk_number != 0xFFFF) {
       L_ERROR("multi-disk zip file is not supported");
       return false;
     }
     uint16_t internal_attrs = stream.extract<uint16_t>();
     uint32_t external_attrs = stream.extract<uint32_t>();
-    uint32_t rel_offset = stream.extract<uint32_t>();
+    uint64_t rel_offset = stream.extract<uint32_t>();
     stream.extract_data(file_name.data(), file_name.size());
     stream.extract_data(extra_field.data(), extra_field.size());
     stream.extract_data(comment.data(), comment.size());
+    if (!apply_zip64_extra_field(extra_field.data(), extra_field.size(),
+      uncompressed_size, compressed_size, &rel_offset))
+    {
+      return false;
+    }
 
     auto it = rel_offset2irecord.find(rel_offset);
     if (it == rel_offset2irecord.end()) {
@@ -137,7 +290,13 @@ struct ZipParser {
       L_ERROR("zip file name in file entry mismatched the cdr");
       return false;
     }
-    if (record.size != uncompressed_size) {
+    if (record.compression_method != compression_method) {
+      L_ERROR("zip file compression in file entry mismatched the cdr");
+      return false;
+    }
+    if (record.size != uncompressed_size ||
+      record.compressed_size != compressed_size)
+    {
       L_ERROR("zip file size in file entry mismatched the cdr");
       return false;
     }
@@ -207,6 +366,23 @@ struct ZipParser {
           return false;
         }
 
+      } else if (sig ==
+        L_ZIP_SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY_RECORD)
+      {
+        // Counts, sizes and offsets are already known from the records.
+        stream.skip(sizeof(sig));
+        uint64_t size = stream.extract<uint64_t>();
+        if (stream.size_remain() < size) {
+          L_ERROR("corrupted zip64 end of central directory record");
+          return false;
+        }
+        stream.skip(size);
+
+      } else if (sig ==
+        L_ZIP_SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR)
+      {
+        stream.skip(sizeof(sig) + 16);
+
       } else if (sig == L_ZIP_SIGNATURE_END_OF_CENTRAL_DIRECTORY_RECORD) {
         stream.skip(sizeof(sig));
 
@@ -231,97 +407,577 @@ struct ZipParser {
     out &= parse_central_directory_records();
     return out;
   }
+
+  // Search backward for the end of central directory record, which is
+  // followed by a variable-length comment of up to 65535 bytes.
+  bool locate_end_of_central_directory_record(size_t& ecdr_offset) {
+    const uint8_t* data = (const uint8_t*)stream.data();
+    size_t size = stream.size();
+    if (size < 22) {
+      L_ERROR("zip archive is too small");
+      return false;
+    }
+    size_t min_offset = size - 22 > 0xFFFF ? size - 22 - 0xFFFF : 0;
+    for (size_t offset = size - 22 + 1; offset-- > min_offset;) {
+      uint32_t sig;
+      std::memcpy(&sig, data + offset, sizeof(sig));
+      if (sig != L_ZIP_SIGNATURE_END_OF_CENTRAL_DIRECTORY_RECORD) {
+        continue;
+      }
+      uint16_t comment_size;
+      std::memcpy(&comment_size, data + offset + 20, sizeof(comment_size));
+      // Comments might contain the signature by accident.
+      if (offset + 22 + comment_size == size) {
+        ecdr_offset = offset;
+        return true;
+      }
+    }
+    L_ERROR("cannot find end of central directory record");
+    return false;
+  }
+
+  bool parse_central_directory_first() {
+    size_t ecdr_offset;
+    if (!locate_end_of_central_directory_record(ecdr_offset)) {
+      return false;
+    }
+    stream::ReadStream ecdr_stream(
+      (const uint8_t*)stream.data() + ecdr_offset + 4, 18);
+    uint32_t cur_disc_number = ecdr_stream.extract<uint16_t>();
+    uint32_t cdr_disk_number = ecdr_stream.extract<uint16_t>();
+    uint64_t ncdr_on_this_disk = ecdr_stream.extract<uint16_t>();
+    uint64_t ncdr_total = ecdr_stream.extract<uint16_t>();
+    uint64_t cdr_size_total = ecdr_stream.extract<uint32_t>();
+    cdr_offset = ecdr_stream.extract<uint32_t>();
+    // End of central directory record limit, the zip64 one if present.
+    uint64_t cdr_end_limit = ecdr_offset;
+
+    uint32_t locator_sig = 0;
+    if (ecdr_offset >= 20) {
+      std::memcpy(&locator_sig, (const uint8_t*)stream.data() + ecdr_offset - 20,
+        sizeof(locator_sig));
+    }
+    if (locator_sig == L_ZIP_SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR) {
+      stream::ReadStream locator_stream(
+        (const uint8_t*)stream.data() + ecdr_offset - 16, 16);
+      uint32_t zip64_ecdr_disk_number = locator_stream.extract<uint32_t>();
+      uint64_t zip64_ecdr_offset = locator_stream.extract<uint64_t>();
+      uint32_t ndisk = locator_stream.extract<uint32_t>();
+      if (zip64_ecdr_disk_number != 0 || ndisk > 1) {
+        L_ERROR("multi-disk zip file is not supported");
+        return false;
+      }
+      if (zip64_ecdr_offset > ecdr_offset - 20 ||
+        ecdr_offset - 20 - zip64_ecdr_offset < 56)
+      {
+        L_ERROR("corrupted zip64 end of central directory locator");
+        return false;
+      }
+      stream::ReadStream zip64_ecdr_stream(
+        (const uint8_t*)stream.data() + zip64_ecdr_offset, 56);
+      if (zip64_ecdr_stream.extract<uint32_t>() !=
+        L_ZIP_SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY_RECORD)
+      {
+        L_ERROR("zip64 end of central directory record signature mismatched");
+        return false;
+      }
+      zip64_ecdr_stream.skip(8 + 2 + 2); // record size, versions
+      cur_disc_number = zip64_ecdr_stream.extract<uint32_t>();
+      cdr_disk_number = zip64_ecdr_stream.extract<uint32_t>();
+      ncdr_on_this_disk = zip64_ecdr_stream.extract<uint64_t>();
+      ncdr_total = zip64_ecdr_stream.extract<uint64_t>();
+      cdr_size_total = zip64_ecdr_stream.extract<uint64_t>();
+      cdr_offset = zip64_ecdr_stream.extract<uint64_t>();
+      cdr_end_limit = zip64_ecdr_offset;
+    }
+
+    if (cur_disc_number != 0 || cdr_disk_number != 0 ||
+      ncdr_on_this_disk != ncdr_total)
+    {
+      L_ERROR("multi-disk zip file is not supported");
+      return false;
+    }
+    if (cdr_offset > cdr_end_limit ||
+      cdr_size_total > cdr_end_limit - cdr_offset)
+    {
+      L_ERROR("corrupted end of central directory record");
+      return false;
+    }
+
+    stream::ReadStream cdr_stream(
+      (const uint8_t*)stream.data() + cdr_offset, cdr_size_total);
+    // Every record takes at least 46 bytes.
+    if (ncdr_total > cdr_size_total / 46) {
+      L_ERROR("corrupted end of central directory record");
+      return false;
+    }
+    records.reserve(ncdr_total);
+    for (size_t i = 0; i < ncdr_total; ++i) {
+      if (cdr_stream.size_remain() < 46 ||
+        cdr_stream.extract<uint32_t>() !=
+          L_ZIP_SIGNATURE_CENTRAL_DIRECTORY_FILE_HEADER)
+      {
+        L_ERROR("corrupted central directory file header");
+        return false;
+      }
+      // Skip versions and flags.
+      cdr_stream.skip(3 * sizeof(uint16_t));
+      uint16_t compression_method = cdr_stream.extract<uint16_t>();
+      // Skip last modification time and date.
+      cdr_stream.skip(2 * sizeof(uint16_t));
+      uint32_t crc32 = cdr_stream.extract<uint32_t>();
+      uint64_t compressed_size = cdr_stream.extract<uint32_t>();
+      uint64_t uncompressed_size = cdr_stream.extract<uint32_t>();
+      uint16_t file_name_size = cdr_stream.extract<uint16_t>();
+      uint16_t extra_field_size = cdr_stream.extract<uint16_t>();
+      uint16_t comment_size = cdr_stream.extract<uint16_t>();
+      uint16_t disk_number = cdr_stream.extract<uint16_t>();
+      // Skip internal and external file attributes.
+      cdr_stream.skip(sizeof(uint16_t) + sizeof(uint32_t));
+      uint64_t rel_offset = cdr_stream.extract<uint32_t>();
+      if (disk_number != 0 && disk_number != 0xFFFF) {
+        L_ERROR("multi-disk zip file is not supported");
+        return false;
+      }
+      if (cdr_stream.size_remain() <
+        (size_t)file_name_size + extra_field_size + comment_size)
+      {
+        L_ERROR("corrupted central directory file header");
+        return false;
+      }
+
+      size_t irecord = records.size();
+      ZipFileRecord& record = records.emplace_back();
+      record.file_name.resize(file_name_size);
+      cdr_stream.extract_data(record.file_name.data(), file_name_size);
+      if (!apply_zip64_extra_field((const uint8_t*)cdr_stream.pos(),
+        extra_field_size, uncompressed_size, compressed_size, &rel_offset))
+      {
+        return false;
+      }
+      cdr_stream.skip((size_t)extra_field_size + comment_size);
+      if (!check_compression(compression_method, compressed_size,
+        uncompressed_size, 0))
+      {
+        return false;
+      }
+      record.data = nullptr;
+      record.size = uncompressed_size;
+      record.crc32 = crc32;
+      record.compression_method = (ZipCompressionMethod)compression_method;
+      record.compressed_data = nullptr;
+      record.compressed_size = compressed_size;
+      record.local_header_offset = rel_offset;
+      record.is_validated = false;
+
+      file_name2irecord[record.file_name] = irecord;
+    }
+    return true;
+  }
 };
 
+// Locate the data of a record parsed from the central directory and check its
+// local file header against the central directory.
+bool validate_local_file_header(
+  const uint8_t* data,
+  size_t size,
+  ZipFileRecord& record
+) {
+  size_t offset = record.local_header_offset;
+  if (offset > size || size - offset < 30) {
+    L_ERROR("corrupted local file header");
+    return false;
+  }
+  stream::ReadStream stream(data + offset, size - offset);
+  if (stream.extract<uint32_t>() != L_ZIP_SIGNATURE_LOCAL_FILE_HEADER) {
+    L_ERROR("local file header signature mismatched");
+    return false;
+  }
+  // Skip the minimal version to extract.
+  stream.skip(sizeof(uint16_t));
+  uint16_t flags = stream.extract<uint16_t>();
+  uint16_t compression_method = stream.extract<uint16_t>();
+  // Skip last modification time and date.
+  stream.skip(2 * sizeof(uint16_t));
+  uint32_t crc32 = stream.extract<uint32_t>();
+  uint64_t compressed_size = stream.extract<uint32_t>();
+  uint64_t uncompressed_size = stream.extract<uint32_t>();
+  uint16_t file_name_size = stream.extract<uint16_t>();
+  uint16_t extra_field_size = stream.extract<uint16_t>();
+  if (stream.size_remain() < (size_t)file_name_size + extra_field_size) {
+    L_ERROR("corrupted local file header");
+    return false;
+  }
+  if (!apply_zip64_extra_field(
+    (const uint8_t*)stream.pos() + file_name_size, extra_field_size,
+    uncompressed_size, compressed_size, nullptr))
+  {
+    return false;
+  }
+  if (compression_method != record.compression_method) {
+    L_ERROR("zip file compression in file entry mismatched the cdr");
+    return false;
+  }
+  // Sizes and crc32 are deferred to the data descriptor if bit 3 is set.
+  if ((flags & 0x8) == 0) {
+    if (uncompressed_size != record.size ||
+      compressed_size != record.compressed_size)
+    {
+      L_ERROR("zip file size in file entry mismatched the cdr");
+      return false;
+    }
+    if (crc32 != record.crc32) {
+      L_ERROR("zip file crc32 in file entry mismatched the cdr");
+      return false;
+    }
+  }
+  if (stream.size_remain() <
+    (size_t)file_name_size + extra_field_size + record.compressed_size)
+  {
+    L_ERROR("corrupted local file header");
+    return false;
+  }
+  if (record.file_name != std::string_view(
+    (const char*)stream.pos(), file_name_size))
+  {
+    L_ERROR("zip file name in file entry mismatched the cdr");
+    return false;
+  }
+  stream.skip((size_t)file_name_size + extra_field_size);
+  if (record.compression_method == L_ZIP_COMPRESSION_METHOD_STORE) {
+    record.data = stream.pos();
+  }
+  record.compressed_data = stream.pos();
+  record.is_validated = true;
+  return true;
+}
+
+bool is_zip64_size(uint64_t size) {
+  return size >= ZIP64_SATURATED;
+}
+uint16_t min_version(const ZipFileRecord& record, bool is_zip64) {
+  // Version 4.5 is required to extract zip64 records, and version 2.0 to
+  // extract deflated data.
+  if (is_zip64) { return 45; }
+  return record.compression_method == L_ZIP_COMPRESSION_METHOD_DEFLATE ?
+    20 : 0;
+}
+
+// Sizes and crc32 are left zero if they are deferred to the data descriptor
+// with bit 3 of `flags`.
+void append_local_file_header(
+  stream::WriteStream& stream,
+  const ZipFileRecord& record,
+  uint16_t flags,
+  bool is_zip64
+) {
+  bool has_data_descriptor = (flags & 0x8) != 0;
+  uint32_t crc32 = has_data_descriptor ? 0 : record.crc32;
+  uint64_t compressed_size = has_data_descriptor ? 0 : record.compressed_size;
+  uint64_t uncompressed_size = has_data_descriptor ? 0 : record.size;
+
+  stream.append<uint32_t>(L_ZIP_SIGNATURE_LOCAL_FILE_HEADER);
+  stream.append<uint16_t>(min_version(record, is_zip64)); // min version
+  stream.append<uint16_t>(flags); // flags
+  stream.append<uint16_t>(record.compression_method); // compression
+  stream.append<uint16_t>(0); // last modify time
+  stream.append<uint16_t>(0); // last modify date
+  stream.append<uint32_t>(crc32);
+  if (is_zip64) {
+    // Both sizes must be present in the local zip64 extra field.
+    stream.append<uint32_t>(ZIP64_SATURATED); // compressed size
+    stream.append<uint32_t>(ZIP64_SATURATED); // uncompressed size
+  } else {
+    stream.append<uint32_t>(compressed_size); // compressed size
+    stream.append<uint32_t>(uncompressed_size); // uncompressed size
+  }
+  stream.append<uint16_t>((uint16_t)record.file_name.size());
+  stream.append<uint16_t>(is_zip64 ? 20 : 0); // extra field size
+  stream.append_data(record.file_name.data(), record.file_name.size());
+  if (is_zip64) {
+    stream.append<uint16_t>(L_ZIP_EXTRA_FIELD_ID_ZIP64);
+    stream.append<uint16_t>(16);
+    stream.append<uint64_t>(uncompressed_size);
+    stream.append<uint64_t>(compressed_size);
+  }
+}
+// Sizes are 64-bit if the local file header has a zip64 extra field.
+void append_data_descriptor(
+  stream::WriteStream& stream,
+  const ZipFileRecord& record,
+  bool is_zip64
+) {
+  stream.append<uint32_t>(L_ZIP_SIGNATURE_DATA_DESCRIPTOR);
+  stream.append<uint32_t>(record.crc32);
+  if (is_zip64) {
+    stream.append<uint64_t>(record.compressed_size); // compressed size
+    stream.append<uint64_t>(record.size); // uncompressed size
+  } else {
+    stream.append<uint32_t>(record.compressed_size); // compressed size
+    stream.append<uint32_t>(record.size); // uncompressed size
+  }
+}
+void append_central_directory_file_header(
+  stream::WriteStream& stream,
+  const ZipFileRecord& record,
+  uint64_t rel_offset,
+  uint16_t flags,
+  bool is_local_zip64,
+  bool force_zip64
+) {
+  bool is_uncompressed_size_zip64 = force_zip64 || is_zip64_size(record.size);
+  bool is_compressed_size_zip64 =
+    force_zip64 || is_zip64_size(record.compressed_size);
+  bool is_rel_offset_zip64 = force_zip64 || is_zip64_size(rel_offset);
+  uint16_t extra_field_size = 0;
+  if (is_uncompressed_size_zip64) { extra_field_size += 8; }
+  if (is_compressed_size_zip64) { extra_field_size += 8; }
+  if (is_rel_offset_zip64) { extra_field_size += 8; }
+  bool is_zip64 = extra_field_size != 0;
+
+  stream.append<uint32_t>(L_ZIP_SIGNATURE_CENTRAL_DIRECTORY_FILE_HEADER);
+  stream.append<uint16_t>(is_zip64 || is_local_zip64 ? 45 : 0); // version
+  stream.append<uint16_t>(min_version(record, is_local_zip64)); // min version
+  stream.append<uint16_t>(flags); // flags
+  stream.append<uint16_t>(record.compression_method); // compression
+  stream.append<uint16_t>(0); // last modify time
+  stream.append<uint16_t>(0); // last modify date
+  stream.append<uint32_t>(record.crc32);
+  stream.append<uint32_t>(is_compressed_size_zip64 ?
+    ZIP64_SATURATED : record.compressed_size); // compressed size
+  stream.append<uint32_t>(is_uncompressed_size_zip64 ?
+    ZIP64_SATURATED : record.size); // uncompressed size
+  stream.append<uint16_t>((uint16_t)record.file_name.size());
+  stream.append<uint16_t>(is_zip64 ?
+    4 + extra_field_size : 0); // extra field size
+  stream.append<uint16_t>(0); // comment size
+  stream.append<uint16_t>(0); // disk number
+  stream.append<uint16_t>(0); // internal attrs
+  stream.append<uint32_t>(0); // external attrs
+  stream.append<uint32_t>(is_rel_offset_zip64 ?
+    ZIP64_SATURATED : rel_offset); // offset
+  stream.append_data(record.file_name.data(), record.file_name.size());
+  if (is_zip64) {
+    stream.append<uint16_t>(L_ZIP_EXTRA_FIELD_ID_ZIP64);
+    stream.append<uint16_t>(extra_field_size);
+    if (is_uncompressed_size_zip64) {
+      stream.append<uint64_t>(record.size);
+    }
+    if (is_compressed_size_zip64) {
+      stream.append<uint64_t>(record.compressed_size);
+    }
+    if (is_rel_offset_zip64) {
+      stream.append<uint64_t>(rel_offset);
+    }
+  }
+}
+// The end of central directory record (and the zip64 one, if necessary)
+// follows the central directory immediately, at `ecdr_offset` from the
+// beginning of the archive.
+void append_end_of_central_directory_record(
+  stream::WriteStream& stream,
+  uint64_t ncdr,
+  uint64_t cdr_offset,
+  uint64_t ecdr_offset,
+  bool force_zip64
+) {
+  uint64_t cdr_size = ecdr_offset - cdr_offset;
+  bool is_zip64 = force_zip64 || ncdr >= 0xFFFF ||
+    is_zip64_size(cdr_size) || is_zip64_size(cdr_offset);
+
+  if (is_zip64) {
+    stream.append<uint32_t>(
+      L_ZIP_SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY_RECORD);
+    stream.append<uint64_t>(44); // size of the remaining record
+    stream.append<uint16_t>(45); // version
+    stream.append<uint16_t>(45); // min version
+    stream.append<uint32_t>(0); // current disk number
+    stream.append<uint32_t>(0); // cdr disk number
+    stream.append<uint64_t>(ncdr); // cdr count on this disk
+    stream.append<uint64_t>(ncdr); // total cdr count
+    stream.append<uint64_t>(cdr_size); // cdr size
+    stream.append<uint64_t>(cdr_offset); // cdr offset
+
+    stream.append<uint32_t>(
+      L_ZIP_SIGNATURE_ZIP64_END_OF_CENTRAL_DIRECTORY_LOCATOR);
+    stream.append<uint32_t>(0); // zip64 ecdr disk number
+    stream.append<uint64_t>(ecdr_offset); // zip64 ecdr offset
+    stream.append<uint32_t>(1); // total disk count
+  }
+
+  stream.append<uint32_t>(L_ZIP_SIGNATURE_END_OF_CENTRAL_DIRECTORY_RECORD);
+  stream.append<uint16_t>(0); // current disk number
+  stream.append<uint16_t>(0); // cdr disk number
+  stream.append<uint16_t>(is_zip64 ? 0xFFFF : ncdr); // cdr count on this disk
+  stream.append<uint16_t>(is_zip64 ? 0xFFFF : ncdr); // total cdr count
+  stream.append<uint32_t>(is_zip64 ?
+    ZIP64_SATURATED : cdr_size); // cdr size
+  stream.append<uint32_t>(is_zip64 ?
+    ZIP64_SATURATED : cdr_offset); // cdr offset
+  stream.append<uint16_t>(0); // comment size
+}
+
 struct ZipArchiver {
   stream::WriteStream stream;
   const std::vector<ZipFileRecord>& records;
-  std::vector<uint32_t> rel_offsets;
-  uint32_t cdr_offset;
-  uint32_t ecdr_offset;
+  bool force_zip64;
+  std::vector<uint64_t> rel_offsets;
+  uint64_t cdr_offset;
+  uint64_t ecdr_offset;
+
+  ZipArchiver(const std::vector<ZipFileRecord>& records, bool force_zip64) :
+    records(records), force_zip64(force_zip64), cdr_offset(), ecdr_offset() {}
 
-  ZipArchiver(const std::vector<ZipFileRecord>& records) : records(records) {}
+  bool is_local_zip64(const ZipFileRecord& record) const {
+    return force_zip64 || is_zip64_size(record.size) ||
+      is_zip64_size(record.compressed_size);
+  }
 
   void append_file_records() {
     for (size_t i = 0; i < records.size(); ++i) {
-      rel_offsets.emplace_back((uint32_t)stream.size());
+      rel_offsets.emplace_back(stream.size());
 
       const ZipFileRecord& record = records.at(i);
-      stream.append<uint32_t>(L_ZIP_SIGNATURE_LOCAL_FILE_HEADER);
-      stream.append<uint16_t>(0); // min version
-      stream.append<uint16_t>(0); // flags
-      stream.append<uint16_t>(0); // compression
-      stream.append<uint16_t>(0); // last modify time
-      stream.append<uint16_t>(0); // last modify date
-      stream.append<uint32_t>(record.crc32);
-      stream.append<uint32_t>(record.size); // compressed size
-      stream.append<uint32_t>(record.size); // uncompressed size
-      stream.append<uint16_t>((uint16_t)record.file_name.size());
-      stream.append<uint16_t>(0); // extra field size
-      stream.append_data(record.file_name.data(), record.file_name.size());
-
-      stream.append_data(record.data, record.size);
+      append_local_file_header(stream, record, 0, is_local_zip64(record));
+      stream.append_data(record.compressed_data, record.compressed_size);
     }
   }
   void append_central_directory_records() {
-    uint32_t cdr_offset = (uint32_t)stream.size();
+    cdr_offset = stream.size();
 
     for (size_t i = 0; i < records.size(); ++i) {
       const ZipFileRecord& record = records.at(i);
-      stream.append<uint32_t>(L_ZIP_SIGNATURE_CENTRAL_DIRECTORY_FILE_HEADER);
-      stream.append<uint16_t>(0); // version
-      stream.append<uint16_t>(0); // min version
-      stream.append<uint16_t>(0); // flags
-      stream.append<uint16_t>(0); // compression
-      stream.append<uint16_t>(0); // last modify time
-      stream.append<uint16_t>(0); // last modify date
-      stream.append<uint32_t>(record.crc32);
-      stream.append<uint32_t>(record.size); // compressed size
-      stream.append<uint32_t>(record.size); // uncompressed size
-      stream.append<uint16_t>((uint16_t)record.file_name.size());
-      stream.append<uint16_t>(0); // extra field size
-      stream.append<uint16_t>(0); // comment size
-      stream.append<uint16_t>(0); // disk number
-      stream.append<uint16_t>(0); // internal attrs
-      stream.append<uint32_t>(0); // external attrs
-      stream.append<uint32_t>(rel_offsets.at(i)); // offset
-      stream.append_data(record.file_name.data(), record.file_name.size());
+      append_central_directory_file_header(stream, record, rel_offsets.at(i),
+        0, is_local_zip64(record), force_zip64);
     }
   }
   void append_end_of_central_directory_record() {
-    uint32_t ecdr_offset = (uint32_t)stream.size();
-
-    stream.append<uint32_t>(L_ZIP_SIGNATURE_END_OF_CENTRAL_DIRECTORY_RECORD);
-    stream.append<uint16_t>(0); // current disk number
-    stream.append<uint16_t>(0); // cdr disk number
-    stream.append<uint16_t>(records.size()); // cdr count on this disk
-    stream.append<uint16_t>(records.size()); // total cdr count
-    stream.append<uint32_t>(ecdr_offset - cdr_offset); // cdr size
-    stream.append<uint32_t>(cdr_offset); // cdr offset
-    stream.append<uint16_t>(0); // comment size
+    ecdr_offset = stream.size();
+    zip::append_end_of_central_directory_record(stream, records.size(),
+      cdr_offset, ecdr_offset, force_zip64);
   }
 
   void archive() {
+    // Upper bound of the archive size with zip64 extra fields everywhere.
+    size_t size = 56 + 20 + 22;
+    for (const ZipFileRecord& record : records) {
+      size += 30 + 20 + 46 + 28 + 2 * record.file_name.size() +
+        record.compressed_size;
+    }
+    stream.reserve(size);
+
     append_file_records();
     append_central_directory_records();
     append_end_of_central_directory_record();
   }
 };
 
-ZipArchive ZipArchive::from_bytes(const uint8_t* data, size_t size) {
+ZipArchive ZipArchive::from_bytes(
+  const uint8_t* data,
+  size_t size,
+  const ZipParseConfig& cfg
+) {
   ZipParser parser(data, size);
-  if (!parser.parse()) {
-    L_ERROR("failed to parse zip archive");
-    return {};
+  if (cfg.central_directory_only) {
+    if (!parser.parse_central_directory_first()) {
+      L_ERROR("failed to parse zip archive");
+      return {};
+    }
+  } else {
+    if (!parser.parse()) {
+      L_ERROR("failed to parse zip archive");
+      return {};
+    }
   }
 
   ZipArchive ar {};
   ar.records = std::move(parser.records);
   ar.file_name2irecord = std::move(parser.file_name2irecord);
+  if (cfg.central_directory_only) {
+    ar.archive_data = data;
+    ar.archive_size = size;
+  }
   return ar;
 }
+ZipArchive ZipArchive::from_bytes(const uint8_t* data, size_t size) {
+  return from_bytes(data, size, {});
+}
 ZipArchive ZipArchive::from_bytes(const std::vector<uint8_t>& data) {
-  return from_bytes(data.data(), data.size());
+  return from_bytes(data.data(), data.size(), {});
+}
+ZipArchive ZipArchive::open_mmap(const char* path) {
+  ZipParseConfig cfg {};
+  cfg.central_directory_only = true;
+  return open_mmap(path, cfg);
+}
+ZipArchive ZipArchive::open_mmap(const char* path, const ZipParseConfig& cfg) {
+  // Only the central directory and the entries accessed are touched when the
+  // local file headers are validated lazily.
+  auto mapped_file = std::make_shared<util::MappedFile>(path,
+    cfg.central_directory_only ?
+      util::L_MAPPED_FILE_ACCESS_HINT_RANDOM :
+      util::L_MAPPED_FILE_ACCESS_HINT_SEQUENTIAL);
+  ZipArchive ar = from_bytes(
+    (const uint8_t*)mapped_file->data(), mapped_file->size(), cfg);
+  ar.mapped_file = std::move(mapped_file);
+  return ar;
+}
+
+bool ZipArchive::validate_record(size_t irecord) {
+  ZipFileRecord& record = records.at(irecord);
+  if (record.is_validated) {
+    return true;
+  }
+  if (!validate_local_file_header(archive_data, archive_size, record)) {
+    L_ERROR("failed to validate zip file entry: ", record.file_name);
+    return false;
+  }
+  return true;
+}
+const ZipFileRecord& ZipArchive::get_file(const std::string& file_name) {
+  size_t irecord = file_name2irecord.at(file_name);
+  if (!validate_record(irecord)) {
+    L_THROW("zip file entry is corrupted: ", file_name);
+  }
+  return records[irecord];
+}
+bool ZipArchive::extract(size_t irecord, std::vector<uint8_t>& out) {
+  if (!validate_record(irecord)) {
+    return false;
+  }
+  const ZipFileRecord& record = records[irecord];
+  out.resize(record.size);
+  switch (record.compression_method) {
+  case L_ZIP_COMPRESSION_METHOD_STORE:
+    if (record.size > 0) {
+      std::memcpy(out.data(), record.data, record.size);
+    }
+    break;
+  case L_ZIP_COMPRESSION_METHOD_DEFLATE:
+    if (!deflate::inflate(record.compressed_data, record.compressed_size,
+      out.data(), out.size()))
+    {
+      L_ERROR("failed to inflate zip file entry: ", record.file_name);
+      return false;
+    }
+    break;
+  default:
+    L_ERROR("unsupported zip compression method: ",
+      record.compression_method);
+    return false;
+  }
+  if (util::crc32_parallel(out.data(), out.size()) != record.crc32) {
+    L_ERROR("zip file entry crc32 mismatched: ", record.file_name);
+    return false;
+  }
+  return true;
+}
+const ZipFileRecord& ZipArchive::get_file(const std::string& file_name) const {
+  const ZipFileRecord& record = records.at(file_name2irecord.at(file_name));
+  if (!record.is_validated) {
+    L_THROW("zip file entry is not validated yet: ", file_name);
+  }
+  return record;
 }
 
 
@@ -334,17 +990,224 @@ void ZipArchive::add_file(
   record.file_name = file_name;
   record.data = data;
   record.size = size;
-  record.crc32 = util::crc32(data, size);
+  record.crc32 = util::crc32_parallel(data, size);
+  record.compression_method = L_ZIP_COMPRESSION_METHOD_STORE;
+  record.compressed_data = data;
+  record.compressed_size = size;
+  record.local_header_offset = 0;
+  record.is_validated = true;
 
   file_name2irecord.emplace(std::make_pair(file_name, records.size()));
   records.emplace_back(std::move(record));
 }
 void ZipArchive::to_bytes(std::vector<uint8_t>& out) const {
-  ZipArchiver archiver(records);
+  to_bytes(out, {});
+}
+void ZipArchive::to_bytes(
+  std::vector<uint8_t>& out,
+  const ZipWriteConfig& cfg
+) const {
+  // Records not accessed yet are validated on copies as the archive is const.
+  std::vector<ZipFileRecord> validated_records;
+  for (size_t i = 0; i < records.size(); ++i) {
+    if (records[i].is_validated) {
+      continue;
+    }
+    if (validated_records.empty()) {
+      validated_records = records;
+    }
+    ZipFileRecord& record = validated_records[i];
+    if (!validate_local_file_header(archive_data, archive_size, record)) {
+      L_THROW("zip file entry is corrupted: ", record.file_name);
+    }
+  }
+  const std::vector<ZipFileRecord>& src_records =
+    validated_records.empty() ? records : validated_records;
+
+  if (cfg.level == 0) {
+    ZipArchiver archiver(src_records, cfg.force_zip64);
+    archiver.archive();
+    out = archiver.stream.take();
+    return;
+  }
+
+  // Records are independent so they are compressed in parallel, and then
+  // archived in order.
+  std::vector<ZipFileRecord> compressed_records = src_records;
+  std::vector<std::vector<uint8_t>> compressed_datas(records.size());
+  deflate::DeflateConfig deflate_cfg {};
+  deflate_cfg.level = cfg.level;
+  util::ThreadPool& thread_pool = cfg.thread_pool != nullptr ?
+    *cfg.thread_pool : util::ThreadPool::global();
+  thread_pool.parallel_for(records.size(), [&](size_t i) {
+    ZipFileRecord& record = compressed_records[i];
+    if (record.compression_method != L_ZIP_COMPRESSION_METHOD_STORE ||
+      record.size == 0)
+    {
+      return;
+    }
+    std::vector<uint8_t>& compressed_data = compressed_datas[i];
+    deflate::deflate(record.data, record.size, compressed_data, deflate_cfg);
+    if (compressed_data.size() < record.size) {
+      record.data = nullptr;
+      record.compressed_data = compressed_data.data();
+      record.compressed_size = compressed_data.size();
+      record.compression_method = L_ZIP_COMPRESSION_METHOD_DEFLATE;
+    } else {
+      compressed_data = {};
+    }
+  });
+
+  ZipArchiver archiver(compressed_records, cfg.force_zip64);
   archiver.archive();
   out = archiver.stream.take();
 }
 
+ZipStreamWriter::Sink make_file_sink(const char* path) {
+  std::shared_ptr<stream::FileWriteStream> f =
+    std::make_shared<stream::FileWriteStream>(path);
+  return [f](const void* data, size_t size) {
+    f->append_data(data, size);
+  };
+}
+
+ZipStreamWriter::ZipStreamWriter(Sink&& sink) :
+  ZipStreamWriter(std::move(sink), {}) {}
+ZipStreamWriter::ZipStreamWriter(Sink&& sink, const ZipWriteConfig& cfg) :
+  sink_(std::move(sink)),
+  cfg_(cfg),
+  records_(),
+  has_data_descriptor_(),
+  offset_(0),
+  is_file_open_(false),
+  is_finished_(false) {}
+ZipStreamWriter::ZipStreamWriter(const char* path) :
+  ZipStreamWriter(path, {}) {}
+ZipStreamWriter::ZipStreamWriter(const char* path, const ZipWriteConfig& cfg) :
+  ZipStreamWriter(make_file_sink(path), cfg) {}
+
+void ZipStreamWriter::write(const void* data, size_t size) {
+  if (size == 0) { return; }
+  sink_(data, size);
+  offset_ += size;
+}
+
+void ZipStreamWriter::add_file(
+  const std::string& file_name,
+  const void* data,
+  size_t size
+) {
+  L_ASSERT(!is_finished_, "zip stream writer is already finished");
+  L_ASSERT(!is_file_open_, "cannot add a zip file entry while another is "
+    "being written: ", file_name);
+
+  ZipFileRecord record {};
+  record.file_name = file_name;
+  record.data = nullptr;
+  record.size = size;
+  // Small entries don't start the global pool.
+  record.crc32 = cfg_.thread_pool != nullptr ?
+    util::crc32_parallel(data, size, *cfg_.thread_pool) :
+    util::crc32_parallel(data, size);
+  record.compression_method = L_ZIP_COMPRESSION_METHOD_STORE;
+  record.compressed_size = size;
+  record.local_header_offset = offset_;
+  record.is_validated = true;
+
+  const void* record_data = data;
+  std::vector<uint8_t> compressed_data;
+  if (cfg_.level != 0 && size > 0) {
+    deflate::DeflateConfig deflate_cfg {};
+    deflate_cfg.level = cfg_.level;
+    deflate::deflate(data, size, compressed_data, deflate_cfg);
+    if (compressed_data.size() < size) {
+      record_data = compressed_data.data();
+      record.compressed_size = compressed_data.size();
+      record.compression_method = L_ZIP_COMPRESSION_METHOD_DEFLATE;
+    }
+  }
+
+  bool is_zip64 = cfg_.force_zip64 || is_zip64_size(record.size) ||
+    is_zip64_size(record.compressed_size);
+  stream::WriteStream header {};
+  append_local_file_header(header, record, 0, is_zip64);
+  std::vector<uint8_t> header_data = header.take();
+  write(header_data.data(), header_data.size());
+  write(record_data, record.compressed_size);
+
+  records_.emplace_back(std::move(record));
+  has_data_descriptor_.emplace_back(false);
+}
+
+void ZipStreamWriter::begin_file(const std::string& file_name) {
+  L_ASSERT(!is_finished_, "zip stream writer is already finished");
+  L_ASSERT(!is_file_open_, "cannot add a zip file entry while another is "
+    "being written: ", file_name);
+
+  ZipFileRecord record {};
+  record.file_name = file_name;
+  record.data = nullptr;
+  record.size = 0;
+  record.crc32 = 0;
+  record.compression_method = L_ZIP_COMPRESSION_METHOD_STORE;
+  record.compressed_size = 0;
+  record.local_header_offset = offset_;
+  record.is_validated = true;
+
+  // The final size is unknown so it's always prepared for zip64.
+  stream::WriteStream header {};
+  append_local_file_header(header, record, 0x8, true);
+  std::vector<uint8_t> header_data = header.take();
+  write(header_data.data(), header_data.size());
+
+  records_.emplace_back(std::move(record));
+  has_data_descriptor_.emplace_back(true);
+  is_file_open_ = true;
+}
+void ZipStreamWriter::append_file_data(const void* data, size_t size) {
+  L_ASSERT(is_file_open_, "no zip file entry is being written");
+  ZipFileRecord& record = records_.back();
+  record.crc32 = util::crc32_update(record.crc32, data, size);
+  record.size += size;
+  record.compressed_size += size;
+  write(data, size);
+}
+void ZipStreamWriter::end_file() {
+  L_ASSERT(is_file_open_, "no zip file entry is being written");
+  stream::WriteStream data_descriptor {};
+  append_data_descriptor(data_descriptor, records_.back(), true);
+  std::vector<uint8_t> data_descriptor_data = data_descriptor.take();
+  write(data_descriptor_data.data(), data_descriptor_data.size());
+  is_file_open_ = false;
+}
+
+void ZipStreamWriter::finish() {
+  L_ASSERT(!is_finished_, "zip stream writer is already finished");
+  L_ASSERT(!is_file_open_, "zip file entry is not ended yet: ",
+    records_.back().file_name);
+
+  uint64_t cdr_offset = offset_;
+  stream::WriteStream stream {};
+  for (size_t i = 0; i < records_.size(); ++i) {
+    const ZipFileRecord& record = records_.at(i);
+    bool has_data_descriptor = has_data_descriptor_.at(i);
+    bool is_local_zip64 = has_data_descriptor || cfg_.force_zip64 ||
+      is_zip64_size(record.size) || is_zip64_size(record.compressed_size);
+    append_central_directory_file_header(stream, record,
+      record.local_header_offset, has_data_descriptor ? 0x8 : 0,
+      is_local_zip64, cfg_.force_zip64);
+  }
+  uint64_t ecdr_offset = cdr_offset + stream.size();
+  append_end_of_central_directory_record(stream, records_.size(), cdr_offset,
+    ecdr_offset, cfg_.force_zip64);
+  std::vector<uint8_t> data = stream.take();
+  write(data.data(), data.size());
+
+  // Release the sink, flushing and closing the file written to, if any.
+  sink_ = nullptr;
+  is_finished_ = true;
+}
+
 
 } // namespace zip
 } // namespace liong